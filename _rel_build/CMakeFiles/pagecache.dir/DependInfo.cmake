@@ -0,0 +1,38 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/src/api/UserAPI.cpp" "CMakeFiles/pagecache.dir/src/api/UserAPI.cpp.o" "gcc" "CMakeFiles/pagecache.dir/src/api/UserAPI.cpp.o.d"
+  "/root/repo/src/cache/Epoch.cpp" "CMakeFiles/pagecache.dir/src/cache/Epoch.cpp.o" "gcc" "CMakeFiles/pagecache.dir/src/cache/Epoch.cpp.o.d"
+  "/root/repo/src/cache/Eviction.cpp" "CMakeFiles/pagecache.dir/src/cache/Eviction.cpp.o" "gcc" "CMakeFiles/pagecache.dir/src/cache/Eviction.cpp.o.d"
+  "/root/repo/src/cache/FlatPageMap.cpp" "CMakeFiles/pagecache.dir/src/cache/FlatPageMap.cpp.o" "gcc" "CMakeFiles/pagecache.dir/src/cache/FlatPageMap.cpp.o.d"
+  "/root/repo/src/cache/FrequencySketch.cpp" "CMakeFiles/pagecache.dir/src/cache/FrequencySketch.cpp.o" "gcc" "CMakeFiles/pagecache.dir/src/cache/FrequencySketch.cpp.o.d"
+  "/root/repo/src/cache/Page.cpp" "CMakeFiles/pagecache.dir/src/cache/Page.cpp.o" "gcc" "CMakeFiles/pagecache.dir/src/cache/Page.cpp.o.d"
+  "/root/repo/src/cache/PageCache.cpp" "CMakeFiles/pagecache.dir/src/cache/PageCache.cpp.o" "gcc" "CMakeFiles/pagecache.dir/src/cache/PageCache.cpp.o.d"
+  "/root/repo/src/cache/PageFramePool.cpp" "CMakeFiles/pagecache.dir/src/cache/PageFramePool.cpp.o" "gcc" "CMakeFiles/pagecache.dir/src/cache/PageFramePool.cpp.o.d"
+  "/root/repo/src/fs/File.cpp" "CMakeFiles/pagecache.dir/src/fs/File.cpp.o" "gcc" "CMakeFiles/pagecache.dir/src/fs/File.cpp.o.d"
+  "/root/repo/src/fs/Inode.cpp" "CMakeFiles/pagecache.dir/src/fs/Inode.cpp.o" "gcc" "CMakeFiles/pagecache.dir/src/fs/Inode.cpp.o.d"
+  "/root/repo/src/io/DirtyThrottle.cpp" "CMakeFiles/pagecache.dir/src/io/DirtyThrottle.cpp.o" "gcc" "CMakeFiles/pagecache.dir/src/io/DirtyThrottle.cpp.o.d"
+  "/root/repo/src/io/IOEngine.cpp" "CMakeFiles/pagecache.dir/src/io/IOEngine.cpp.o" "gcc" "CMakeFiles/pagecache.dir/src/io/IOEngine.cpp.o.d"
+  "/root/repo/src/io/ReadPath.cpp" "CMakeFiles/pagecache.dir/src/io/ReadPath.cpp.o" "gcc" "CMakeFiles/pagecache.dir/src/io/ReadPath.cpp.o.d"
+  "/root/repo/src/io/Readahead.cpp" "CMakeFiles/pagecache.dir/src/io/Readahead.cpp.o" "gcc" "CMakeFiles/pagecache.dir/src/io/Readahead.cpp.o.d"
+  "/root/repo/src/io/Writeback.cpp" "CMakeFiles/pagecache.dir/src/io/Writeback.cpp.o" "gcc" "CMakeFiles/pagecache.dir/src/io/Writeback.cpp.o.d"
+  "/root/repo/src/metrics/Counters.cpp" "CMakeFiles/pagecache.dir/src/metrics/Counters.cpp.o" "gcc" "CMakeFiles/pagecache.dir/src/metrics/Counters.cpp.o.d"
+  "/root/repo/src/metrics/LatencyHistogram.cpp" "CMakeFiles/pagecache.dir/src/metrics/LatencyHistogram.cpp.o" "gcc" "CMakeFiles/pagecache.dir/src/metrics/LatencyHistogram.cpp.o.d"
+  "/root/repo/src/scheduler/EventLoop.cpp" "CMakeFiles/pagecache.dir/src/scheduler/EventLoop.cpp.o" "gcc" "CMakeFiles/pagecache.dir/src/scheduler/EventLoop.cpp.o.d"
+  "/root/repo/src/scheduler/IOScheduler.cpp" "CMakeFiles/pagecache.dir/src/scheduler/IOScheduler.cpp.o" "gcc" "CMakeFiles/pagecache.dir/src/scheduler/IOScheduler.cpp.o.d"
+  "/root/repo/src/scheduler/IOThreadPool.cpp" "CMakeFiles/pagecache.dir/src/scheduler/IOThreadPool.cpp.o" "gcc" "CMakeFiles/pagecache.dir/src/scheduler/IOThreadPool.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,49 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/pagecache.dir/src/api/UserAPI.cpp.o"
+  "CMakeFiles/pagecache.dir/src/api/UserAPI.cpp.o.d"
+  "CMakeFiles/pagecache.dir/src/cache/Epoch.cpp.o"
+  "CMakeFiles/pagecache.dir/src/cache/Epoch.cpp.o.d"
+  "CMakeFiles/pagecache.dir/src/cache/Eviction.cpp.o"
+  "CMakeFiles/pagecache.dir/src/cache/Eviction.cpp.o.d"
+  "CMakeFiles/pagecache.dir/src/cache/FlatPageMap.cpp.o"
+  "CMakeFiles/pagecache.dir/src/cache/FlatPageMap.cpp.o.d"
+  "CMakeFiles/pagecache.dir/src/cache/FrequencySketch.cpp.o"
+  "CMakeFiles/pagecache.dir/src/cache/FrequencySketch.cpp.o.d"
+  "CMakeFiles/pagecache.dir/src/cache/Page.cpp.o"
+  "CMakeFiles/pagecache.dir/src/cache/Page.cpp.o.d"
+  "CMakeFiles/pagecache.dir/src/cache/PageCache.cpp.o"
+  "CMakeFiles/pagecache.dir/src/cache/PageCache.cpp.o.d"
+  "CMakeFiles/pagecache.dir/src/cache/PageFramePool.cpp.o"
+  "CMakeFiles/pagecache.dir/src/cache/PageFramePool.cpp.o.d"
+  "CMakeFiles/pagecache.dir/src/fs/File.cpp.o"
+  "CMakeFiles/pagecache.dir/src/fs/File.cpp.o.d"
+  "CMakeFiles/pagecache.dir/src/fs/Inode.cpp.o"
+  "CMakeFiles/pagecache.dir/src/fs/Inode.cpp.o.d"
+  "CMakeFiles/pagecache.dir/src/io/DirtyThrottle.cpp.o"
+  "CMakeFiles/pagecache.dir/src/io/DirtyThrottle.cpp.o.d"
+  "CMakeFiles/pagecache.dir/src/io/IOEngine.cpp.o"
+  "CMakeFiles/pagecache.dir/src/io/IOEngine.cpp.o.d"
+  "CMakeFiles/pagecache.dir/src/io/ReadPath.cpp.o"
+  "CMakeFiles/pagecache.dir/src/io/ReadPath.cpp.o.d"
+  "CMakeFiles/pagecache.dir/src/io/Readahead.cpp.o"
+  "CMakeFiles/pagecache.dir/src/io/Readahead.cpp.o.d"
+  "CMakeFiles/pagecache.dir/src/io/Writeback.cpp.o"
+  "CMakeFiles/pagecache.dir/src/io/Writeback.cpp.o.d"
+  "CMakeFiles/pagecache.dir/src/metrics/Counters.cpp.o"
+  "CMakeFiles/pagecache.dir/src/metrics/Counters.cpp.o.d"
+  "CMakeFiles/pagecache.dir/src/metrics/LatencyHistogram.cpp.o"
+  "CMakeFiles/pagecache.dir/src/metrics/LatencyHistogram.cpp.o.d"
+  "CMakeFiles/pagecache.dir/src/scheduler/EventLoop.cpp.o"
+  "CMakeFiles/pagecache.dir/src/scheduler/EventLoop.cpp.o.d"
+  "CMakeFiles/pagecache.dir/src/scheduler/IOScheduler.cpp.o"
+  "CMakeFiles/pagecache.dir/src/scheduler/IOScheduler.cpp.o.d"
+  "CMakeFiles/pagecache.dir/src/scheduler/IOThreadPool.cpp.o"
+  "CMakeFiles/pagecache.dir/src/scheduler/IOThreadPool.cpp.o.d"
+  "libpagecache.a"
+  "libpagecache.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/pagecache.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
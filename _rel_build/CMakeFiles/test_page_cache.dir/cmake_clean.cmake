@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/test_page_cache.dir/tests/page_cache_tests.cpp.o"
+  "CMakeFiles/test_page_cache.dir/tests/page_cache_tests.cpp.o.d"
+  "test_page_cache"
+  "test_page_cache.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/test_page_cache.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
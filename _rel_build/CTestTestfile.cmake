@@ -0,0 +1,10 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo
+# Build directory: /root/repo/_rel_build
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+add_test(PageCacheTests "/root/repo/_rel_build/test_page_cache")
+set_tests_properties(PageCacheTests PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;23;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(EvictionTests "/root/repo/_rel_build/test_eviction")
+set_tests_properties(EvictionTests PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;27;add_test;/root/repo/CMakeLists.txt;0;")
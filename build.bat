@@ -10,7 +10,7 @@ if not exist build (
 
 echo Compiling PageCache library...
 
-set "CXXFLAGS=-std=c++11 -Wall -Wextra -O3 -pthread -I."
+set "CXXFLAGS=-std=c++20 -Wall -Wextra -O3 -pthread -I."
 set "CXX=g++"
 
 REM Compile cache layer
@@ -26,6 +26,22 @@ echo [cache] Compiling Eviction.cpp...
 %CXX% %CXXFLAGS% -c src\cache\Eviction.cpp -o build\Eviction.o
 if errorlevel 1 goto error
 
+echo [cache] Compiling FlatPageMap.cpp...
+%CXX% %CXXFLAGS% -c src\cache\FlatPageMap.cpp -o build\FlatPageMap.o
+if errorlevel 1 goto error
+
+echo [cache] Compiling PageFramePool.cpp...
+%CXX% %CXXFLAGS% -c src\cache\PageFramePool.cpp -o build\PageFramePool.o
+if errorlevel 1 goto error
+
+echo [cache] Compiling FrequencySketch.cpp...
+%CXX% %CXXFLAGS% -c src\cache\FrequencySketch.cpp -o build\FrequencySketch.o
+if errorlevel 1 goto error
+
+echo [cache] Compiling Epoch.cpp...
+%CXX% %CXXFLAGS% -c src\cache\Epoch.cpp -o build\Epoch.o
+if errorlevel 1 goto error
+
 REM Compile filesystem layer
 echo [fs] Compiling Inode.cpp...
 %CXX% %CXXFLAGS% -c src\fs\Inode.cpp -o build\Inode.o
@@ -48,16 +64,36 @@ echo [io] Compiling Readahead.cpp...
 %CXX% %CXXFLAGS% -c src\io\Readahead.cpp -o build\Readahead.o
 if errorlevel 1 goto error
 
+echo [io] Compiling IOEngine.cpp...
+%CXX% %CXXFLAGS% -c src\io\IOEngine.cpp -o build\IOEngine.o
+if errorlevel 1 goto error
+
+echo [io] Compiling DirtyThrottle.cpp...
+%CXX% %CXXFLAGS% -c src\io\DirtyThrottle.cpp -o build\DirtyThrottle.o
+if errorlevel 1 goto error
+
 REM Compile scheduler
 echo [scheduler] Compiling IOThreadPool.cpp...
 %CXX% %CXXFLAGS% -c src\scheduler\IOThreadPool.cpp -o build\IOThreadPool.o
 if errorlevel 1 goto error
 
+echo [scheduler] Compiling IOScheduler.cpp...
+%CXX% %CXXFLAGS% -c src\scheduler\IOScheduler.cpp -o build\IOScheduler.o
+if errorlevel 1 goto error
+
+echo [scheduler] Compiling EventLoop.cpp...
+%CXX% %CXXFLAGS% -c src\scheduler\EventLoop.cpp -o build\EventLoop.o
+if errorlevel 1 goto error
+
 REM Compile metrics
 echo [metrics] Compiling Counters.cpp...
 %CXX% %CXXFLAGS% -c src\metrics\Counters.cpp -o build\Counters.o
 if errorlevel 1 goto error
 
+echo [metrics] Compiling LatencyHistogram.cpp...
+%CXX% %CXXFLAGS% -c src\metrics\LatencyHistogram.cpp -o build\LatencyHistogram.o
+if errorlevel 1 goto error
+
 REM Compile API
 echo [api] Compiling UserAPI.cpp...
 %CXX% %CXXFLAGS% -c src\api\UserAPI.cpp -o build\UserAPI.o
@@ -65,7 +101,7 @@ if errorlevel 1 goto error
 
 REM Create static library
 echo Creating static library...
-ar rcs build\libpagecache.a build\Page.o build\PageCache.o build\Eviction.o build\Inode.o build\File.o build\ReadPath.o build\Writeback.o build\Readahead.o build\IOThreadPool.o build\Counters.o build\UserAPI.o
+ar rcs build\libpagecache.a build\Page.o build\PageCache.o build\Eviction.o build\FlatPageMap.o build\PageFramePool.o build\FrequencySketch.o build\Epoch.o build\Inode.o build\File.o build\ReadPath.o build\Writeback.o build\Readahead.o build\IOEngine.o build\DirtyThrottle.o build\IOThreadPool.o build\IOScheduler.o build\EventLoop.o build\Counters.o build\LatencyHistogram.o build\UserAPI.o
 if errorlevel 1 goto error
 
 REM Compile tests
@@ -7,12 +7,14 @@ namespace pagecache
 {
 
     PageCacheSystem::PageCacheSystem()
-        : next_ino_(1000)
+        : next_ino_(1000), direct_io_(false), io_scheduler_(false)
     {
         cache_ = std::make_shared<PageCache>(65536);
-        writeback_ = std::make_shared<WritebackEngine>(cache_);
-        readahead_ = std::make_shared<Readahead>(cache_);
-        counters_ = std::make_shared<Counters>();
+        io_engine_ = create_io_engine();
+        io_pool_ = std::make_shared<IOThreadPool>(IO_THREADS);
+        writeback_ = std::make_shared<WritebackEngine>(cache_, io_engine_, IO_THREADS, io_pool_);
+        readahead_ = std::make_shared<Readahead>(cache_, Readahead::DEFAULT_MAX_WINDOW, IO_THREADS, io_pool_);
+        counters_ = cache_->counters();
         writeback_->start();
     }
 
@@ -47,10 +49,22 @@ namespace pagecache
                 flags = O_RDWR | O_CREAT;
             }
 
-            int fd = open(path.c_str(), flags, 0644);
+            int fd = -1;
+#ifdef O_DIRECT
+            if (direct_io_)
+            {
+                fd = open(path.c_str(), flags | O_DIRECT, 0644);
+                inode->set_direct_io(fd >= 0);
+            }
+#endif
+            if (fd < 0)
+            {
+                fd = open(path.c_str(), flags, 0644);
+            }
             if (fd >= 0)
             {
                 inode->set_file_descriptor(fd);
+                writeback_->register_inode(inode);
 
                 struct stat st;
                 if (fstat(fd, &st) == 0)
@@ -61,20 +75,70 @@ namespace pagecache
         }
 
         inode->increment_open_count();
-        return std::make_shared<File>(inode, mode, cache_);
+        return std::make_shared<File>(inode, mode, cache_, io_engine_, writeback_, readahead_);
     }
 
     void PageCacheSystem::close_file(std::shared_ptr<File> file)
     {
         if (file && file->inode())
         {
+            file->cancel_readahead();
             file->inode()->decrement_open_count();
         }
     }
 
-    void PageCacheSystem::sync_all()
+    void PageCacheSystem::set_cache_size(size_t max_pages)
+    {
+        writeback_->stop();
+
+        cache_ = std::make_shared<PageCache>(max_pages);
+        cache_->set_counters(counters_);
+        io_engine_ = create_io_engine();
+        writeback_ = std::make_shared<WritebackEngine>(cache_, io_engine_, IO_THREADS, io_pool_);
+        {
+            std::lock_guard<std::mutex> lock(inode_lock_);
+            for (auto &entry : inode_cache_)
+            {
+                writeback_->register_inode(entry.second);
+            }
+        }
+        writeback_->start();
+        readahead_ = std::make_shared<Readahead>(cache_, readahead_->max_window(), IO_THREADS, io_pool_);
+    }
+
+    void PageCacheSystem::set_readahead_window(size_t pages)
+    {
+        readahead_ = std::make_shared<Readahead>(cache_, pages, IO_THREADS, io_pool_);
+    }
+
+    int PageCacheSystem::sync_all()
+    {
+        return writeback_->fsync(0);
+    }
+
+    void PageCacheSystem::set_io_scheduler(bool enabled)
+    {
+        io_scheduler_ = enabled;
+        std::shared_ptr<IOEngine> engine = io_engine_;
+        if (std::shared_ptr<IOScheduler> scheduler = get_io_scheduler())
+        {
+            engine = scheduler->engine();
+        }
+        io_engine_ = wrap_io_engine(engine);
+    }
+
+    std::shared_ptr<IOEngine> PageCacheSystem::create_io_engine()
     {
-        writeback_->fsync(0);
+        return wrap_io_engine(IOEngine::create(IO_QUEUE_DEPTH, cache_->shared_frame_pool()));
+    }
+
+    std::shared_ptr<IOEngine> PageCacheSystem::wrap_io_engine(std::shared_ptr<IOEngine> engine)
+    {
+        if (io_scheduler_ && engine->queue_depth() > 1)
+        {
+            return std::make_shared<IOScheduler>(std::move(engine));
+        }
+        return engine;
     }
 
     std::shared_ptr<Inode> PageCacheSystem::get_or_create_inode(const std::string &path)
@@ -3,9 +3,11 @@
 #include "../cache/PageCache.h"
 #include "../fs/File.h"
 #include "../fs/Inode.h"
+#include "../io/IOEngine.h"
 #include "../io/Writeback.h"
 #include "../io/Readahead.h"
 #include "../metrics/Counters.h"
+#include "../scheduler/IOScheduler.h"
 #include <memory>
 #include <unordered_map>
 #include <mutex>
@@ -17,6 +19,10 @@ namespace pagecache
     class PageCacheSystem
     {
     public:
+        static constexpr unsigned IO_QUEUE_DEPTH = 128;
+        // Threads of the pool writeback and readahead share.
+        static constexpr size_t IO_THREADS = 4;
+
         static PageCacheSystem &instance();
 
         std::shared_ptr<File> open_file(const std::string &path, FileMode mode);
@@ -24,24 +30,49 @@ namespace pagecache
 
         std::shared_ptr<PageCache> get_cache() { return cache_; }
         std::shared_ptr<Counters> get_counters() { return counters_; }
-
-        void set_cache_size(size_t max_pages)
+        std::shared_ptr<IOEngine> get_io_engine() { return io_engine_; }
+        // The elevator in front of the engine, or null unless it was turned
+        // on and the engine is asynchronous, with something to merge.
+        std::shared_ptr<IOScheduler> get_io_scheduler()
         {
-            cache_ = std::make_shared<PageCache>(max_pages);
+            return std::dynamic_pointer_cast<IOScheduler>(io_engine_);
         }
 
+        // Replaces the cache, after writing back what the old one holds
+        // dirty. Files opened before keep the old cache.
+        void set_cache_size(size_t max_pages);
+
+        // Largest readahead window in pages for files opened from now on;
+        // 0 turns readahead off.
+        void set_readahead_window(size_t pages);
+
         void set_eviction_policy(const std::string &policy)
         {
             cache_->set_eviction_policy(policy);
         }
 
-        void sync_all();
+        // Opens files from now on with O_DIRECT, so their pages are cached
+        // here only and not a second time by the kernel. Files on file
+        // systems that refuse O_DIRECT are opened buffered instead; the
+        // inode records which mode it got.
+        void set_direct_io(bool enabled) { direct_io_ = enabled; }
+        bool direct_io() const { return direct_io_; }
+
+        // Puts the elevator in front of the I/O engine for files opened
+        // from now on. Off by default: a lone demand miss pays for the
+        // scheduler's bookkeeping and gains nothing from merging.
+        void set_io_scheduler(bool enabled);
+
+        // Syncs every open file; returns 0 or the first file's -errno.
+        int sync_all();
 
     private:
         PageCacheSystem();
         ~PageCacheSystem();
 
         std::shared_ptr<PageCache> cache_;
+        std::shared_ptr<IOEngine> io_engine_;
+        std::shared_ptr<IOThreadPool> io_pool_;
         std::shared_ptr<WritebackEngine> writeback_;
         std::shared_ptr<Readahead> readahead_;
         std::shared_ptr<Counters> counters_;
@@ -49,8 +80,12 @@ namespace pagecache
         std::unordered_map<uint64_t, std::shared_ptr<Inode>> inode_cache_;
         std::mutex inode_lock_;
         uint64_t next_ino_;
+        bool direct_io_;
+        bool io_scheduler_;
 
         std::shared_ptr<Inode> get_or_create_inode(const std::string &path);
+        std::shared_ptr<IOEngine> create_io_engine();
+        std::shared_ptr<IOEngine> wrap_io_engine(std::shared_ptr<IOEngine> engine);
     };
 
 }
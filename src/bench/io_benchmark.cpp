@@ -1,16 +1,36 @@
 #include <iostream>
+#include <algorithm>
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <random>
 #include <fstream>
 #include <iomanip>
 #include <cstring>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <unordered_map>
 #include "cache/PageCache.h"
+#include "cache/FlatPageMap.h"
+#include "cache/PageFramePool.h"
 #include "fs/File.h"
+#include "io/IOEngine.h"
+#include "io/Readahead.h"
+#include "io/Writeback.h"
+#include "metrics/Counters.h"
+#include "scheduler/EventLoop.h"
+#include "scheduler/IOScheduler.h"
+#include "scheduler/IOThreadPool.h"
 #include "api/UserAPI.h"
 
 using namespace pagecache;
 using namespace std::chrono;
 
+// Keeps the compiler from dropping reads whose results are otherwise unused.
+volatile uint8_t benchmark_sink;
+
 class Benchmark
 {
 public:
@@ -162,6 +182,597 @@ public:
             sys.get_counters()->hit_ratio()};
     }
 
+    // 1MB reads from a warm file, copied out with read() or served in
+    // place with read_pages(). Either way the consumer sees one byte per
+    // page, standing in for handing the buffer or spans on to a socket.
+    static Result large_read_benchmark(const std::string &filename, bool zero_copy, size_t iterations)
+    {
+        const size_t read_size = 1024 * 1024;
+        const uint64_t span = 64 * read_size;
+
+        auto &sys = PageCacheSystem::instance();
+        auto file = sys.open_file(filename, FileMode::ReadOnly);
+        std::vector<uint8_t> buffer(read_size);
+
+        for (uint64_t offset = 0; offset < span; offset += read_size)
+        {
+            file->read_pages(offset, read_size);
+        }
+
+        uint64_t total_bytes = 0;
+        uint8_t sink = 0;
+        auto start = high_resolution_clock::now();
+
+        for (size_t i = 0; i < iterations; ++i)
+        {
+            uint64_t offset = (i * read_size) % span;
+            if (zero_copy)
+            {
+                for (const PageRef &page : file->read_pages(offset, read_size))
+                {
+                    sink ^= page.data()[0];
+                    total_bytes += page.size();
+                }
+            }
+            else
+            {
+                file->seek(offset);
+                size_t bytes_read = file->read(buffer.data(), read_size);
+                for (size_t b = 0; b < bytes_read; b += Page::PAGE_SIZE)
+                {
+                    sink ^= buffer[b];
+                }
+                total_bytes += bytes_read;
+            }
+        }
+
+        auto end = high_resolution_clock::now();
+        benchmark_sink = sink;
+        sys.close_file(file);
+
+        double seconds = duration_cast<nanoseconds>(end - start).count() / 1e9;
+
+        return {
+            zero_copy ? "1MB read_pages" : "1MB read",
+            (total_bytes / (1024.0 * 1024.0)) / seconds,
+            (seconds * 1e6) / iterations,
+            iterations,
+            1.0};
+    }
+
+    // Reads the whole file front to back in 4K reads on a cold cache,
+    // with readahead windows of up to max_window pages (0 for none).
+    static Result streaming_read_benchmark(const std::string &filename, size_t max_window, bool direct_io)
+    {
+        int fd = direct_io ? open(filename.c_str(), O_RDONLY | O_DIRECT) : -1;
+        if (fd < 0)
+        {
+            fd = open(filename.c_str(), O_RDONLY);
+            direct_io = false;
+        }
+        auto inode = std::make_shared<Inode>(1, filename);
+        inode->set_file_descriptor(fd);
+        inode->set_direct_io(direct_io);
+        inode->set_size(lseek(fd, 0, SEEK_END));
+
+        auto cache = std::make_shared<PageCache>(65536);
+        auto io = IOEngine::create(PageCacheSystem::IO_QUEUE_DEPTH, cache->shared_frame_pool());
+        File file(inode, FileMode::ReadOnly, cache, io, nullptr,
+                  max_window ? std::make_shared<Readahead>(cache, max_window) : nullptr);
+
+        uint8_t buffer[4096];
+        uint8_t sink = 0;
+        uint64_t total_bytes = 0;
+        size_t reads = 0;
+        auto start = high_resolution_clock::now();
+        for (size_t n; (n = file.read(buffer, sizeof(buffer))) > 0; ++reads)
+        {
+            sink ^= buffer[0];
+            total_bytes += n;
+        }
+        auto end = high_resolution_clock::now();
+        benchmark_sink = sink;
+        close(fd);
+
+        double seconds = duration_cast<nanoseconds>(end - start).count() / 1e9;
+        return {
+            max_window ? "Stream RA " + std::to_string(max_window) : std::string("Stream no RA"),
+            (total_bytes / (1024.0 * 1024.0)) / seconds,
+            (seconds * 1e6) / reads,
+            reads,
+            0.0};
+    }
+
+    // 4K reads of a cold file every stride pages, or backwards from the
+    // end for a negative stride, with and without readahead. A read hits
+    // when its page is already resident or on its way in.
+    static Result pattern_read_benchmark(const std::string &filename, int64_t stride, bool readahead,
+                                         bool direct_io, size_t reads)
+    {
+        int fd = direct_io ? open(filename.c_str(), O_RDONLY | O_DIRECT) : -1;
+        if (fd < 0)
+        {
+            fd = open(filename.c_str(), O_RDONLY);
+            direct_io = false;
+        }
+        auto inode = std::make_shared<Inode>(1, filename);
+        inode->set_file_descriptor(fd);
+        inode->set_direct_io(direct_io);
+        inode->set_size(lseek(fd, 0, SEEK_END));
+        int64_t file_pages = inode->size() / Page::PAGE_SIZE;
+
+        auto cache = std::make_shared<PageCache>(65536);
+        auto io = IOEngine::create(PageCacheSystem::IO_QUEUE_DEPTH, cache->shared_frame_pool());
+        File file(inode, FileMode::ReadOnly, cache, io, nullptr,
+                  readahead ? std::make_shared<Readahead>(cache) : nullptr);
+
+        uint8_t buffer[4096];
+        uint8_t sink = 0;
+        size_t hits = 0;
+        int64_t page = stride > 0 ? 0 : file_pages - 1;
+        reads = std::min<size_t>(reads, file_pages / std::abs(stride));
+        auto start = high_resolution_clock::now();
+        for (size_t i = 0; i < reads; ++i, page += stride)
+        {
+            hits += cache->contains(1, page);
+            file.seek(page * Page::PAGE_SIZE);
+            file.read(buffer, sizeof(buffer));
+            sink ^= buffer[0];
+        }
+        auto end = high_resolution_clock::now();
+        benchmark_sink = sink;
+        close(fd);
+
+        double seconds = duration_cast<nanoseconds>(end - start).count() / 1e9;
+        std::string name = (stride < 0 ? std::string("Reverse") : "Stride " + std::to_string(stride)) +
+                           (readahead ? " RA" : " no RA");
+        return {
+            name,
+            (reads * sizeof(buffer) / (1024.0 * 1024.0)) / seconds,
+            (seconds * 1e6) / reads,
+            reads,
+            (double)hits / reads};
+    }
+
+    // Cold sequential 4K reads with readahead while a writer keeps
+    // writeback for eight other files busy on the same two-thread I/O
+    // pool, with the pool's priority classes on or off. The result's
+    // latency is the 99th percentile read.
+    static Result priority_read_benchmark(const std::string &filename, bool prioritized, bool direct_io,
+                                          size_t reads)
+    {
+        auto open_file = [direct_io](const std::string &path, int flags, bool &direct)
+        {
+            int fd = direct_io ? open(path.c_str(), flags | O_DIRECT, 0644) : -1;
+            direct = fd >= 0;
+            return fd >= 0 ? fd : open(path.c_str(), flags, 0644);
+        };
+
+        bool direct;
+        int fd = open_file(filename, O_RDONLY, direct);
+        auto inode = std::make_shared<Inode>(1, filename);
+        inode->set_file_descriptor(fd);
+        inode->set_direct_io(direct);
+        inode->set_size(lseek(fd, 0, SEEK_END));
+
+        auto cache = std::make_shared<PageCache>(65536);
+        auto io = IOEngine::create(PageCacheSystem::IO_QUEUE_DEPTH, cache->shared_frame_pool());
+        auto pool = std::make_shared<IOThreadPool>(2);
+        pool->set_priorities(prioritized);
+        auto writeback = std::make_shared<WritebackEngine>(cache, io, 2, pool);
+        auto readahead = std::make_shared<Readahead>(cache, Readahead::DEFAULT_MAX_WINDOW, 2, pool);
+
+        const size_t num_targets = 8;
+        const uint64_t target_size = 32 * 1024 * 1024;
+        std::vector<std::unique_ptr<File>> targets;
+        for (size_t i = 0; i < num_targets; ++i)
+        {
+            std::string path = "/tmp/pagecache_bulk_" + std::to_string(i) + ".dat";
+            auto target = std::make_shared<Inode>(100 + i, path);
+            target->set_file_descriptor(open_file(path, O_RDWR | O_CREAT | O_TRUNC, direct));
+            target->set_direct_io(direct);
+            writeback->register_inode(target);
+            targets.emplace_back(new File(target, FileMode::ReadWrite, cache, io, writeback));
+        }
+        writeback->start();
+
+        std::atomic<bool> stop(false);
+        std::atomic<uint64_t> written(0);
+        std::thread writer([&]()
+                           {
+            std::vector<uint8_t> chunk(256 * 1024, 'w');
+            for (uint64_t offset = 0; !stop.load(); offset = (offset + chunk.size()) % target_size)
+            {
+                for (auto &target : targets)
+                {
+                    target->seek(offset);
+                    written += target->write(chunk.data(), chunk.size());
+                }
+            } });
+        std::this_thread::sleep_for(milliseconds(200));
+
+        File file(inode, FileMode::ReadOnly, cache, io, nullptr, readahead);
+        uint8_t buffer[4096];
+        uint8_t sink = 0;
+        std::vector<double> latencies;
+        latencies.reserve(reads);
+        auto start = high_resolution_clock::now();
+        for (size_t i = 0; i < reads; ++i)
+        {
+            auto before = high_resolution_clock::now();
+            if (file.read(buffer, sizeof(buffer)) == 0)
+            {
+                break;
+            }
+            latencies.push_back(duration_cast<nanoseconds>(high_resolution_clock::now() - before).count() / 1e3);
+            sink ^= buffer[0];
+        }
+        auto end = high_resolution_clock::now();
+        benchmark_sink = sink;
+
+        stop = true;
+        writer.join();
+        writeback->stop();
+        for (auto &target : targets)
+        {
+            close(target->inode()->file_descriptor());
+            unlink(target->inode()->path().c_str());
+        }
+        close(fd);
+
+        std::sort(latencies.begin(), latencies.end());
+        double seconds = duration_cast<nanoseconds>(end - start).count() / 1e9;
+        double p50 = latencies[latencies.size() / 2];
+        double p99 = latencies[latencies.size() * 99 / 100];
+        std::cout << (prioritized ? "  prioritized" : "  FIFO") << ": p50 " << std::fixed << std::setprecision(1)
+                  << p50 << " us, p99 " << p99 << " us, max " << latencies.back() << " us, writer "
+                  << (written / (1024.0 * 1024.0)) / seconds << " MB/s" << std::endl;
+        return {
+            prioritized ? "Read p99 prio" : "Read p99 FIFO",
+            (latencies.size() * sizeof(buffer) / (1024.0 * 1024.0)) / seconds,
+            p99,
+            latencies.size(),
+            0.0};
+    }
+
+    // Cold 4K reads by threads taking turns through the file, thread t
+    // reading pages t, t + threads, ... so that concurrent misses land
+    // next to each other, straight to the engine or through the elevator.
+    static Result interleaved_read_benchmark(const std::string &filename, size_t threads, bool scheduled,
+                                             bool direct_io, size_t pages)
+    {
+        int fd = direct_io ? open(filename.c_str(), O_RDONLY | O_DIRECT) : -1;
+        if (fd < 0)
+        {
+            fd = open(filename.c_str(), O_RDONLY);
+            direct_io = false;
+        }
+        auto inode = std::make_shared<Inode>(1, filename);
+        inode->set_file_descriptor(fd);
+        inode->set_direct_io(direct_io);
+        inode->set_size(lseek(fd, 0, SEEK_END));
+        pages = std::min<size_t>(pages, inode->size() / Page::PAGE_SIZE);
+
+        auto cache = std::make_shared<PageCache>(65536);
+        std::shared_ptr<IOEngine> io = IOEngine::create(PageCacheSystem::IO_QUEUE_DEPTH, cache->shared_frame_pool());
+        std::shared_ptr<IOScheduler> scheduler;
+        if (scheduled)
+        {
+            scheduler = std::make_shared<IOScheduler>(io);
+            io = scheduler;
+        }
+
+        std::vector<std::thread> readers;
+        auto start = high_resolution_clock::now();
+        for (size_t t = 0; t < threads; ++t)
+        {
+            readers.emplace_back([&, t]()
+                                 {
+                File file(inode, FileMode::ReadOnly, cache, io);
+                uint8_t buffer[4096];
+                uint8_t sink = 0;
+                for (size_t page = t; page < pages; page += threads)
+                {
+                    file.seek(page * Page::PAGE_SIZE);
+                    file.read(buffer, sizeof(buffer));
+                    sink ^= buffer[0];
+                }
+                benchmark_sink = sink; });
+        }
+        for (auto &reader : readers)
+        {
+            reader.join();
+        }
+        auto end = high_resolution_clock::now();
+        close(fd);
+
+        double seconds = duration_cast<nanoseconds>(end - start).count() / 1e9;
+        double merge_ratio = 0.0;
+        if (scheduler)
+        {
+            IOScheduler::Stats stats = scheduler->stats();
+            merge_ratio = stats.merge_ratio();
+            std::cout << "  " << stats.requests << " requests, " << stats.dispatched << " dispatched, "
+                      << std::fixed << std::setprecision(1) << stats.average_request_bytes() / 1024.0
+                      << " KB average" << std::endl;
+        }
+        return {
+            std::to_string(threads) + (scheduled ? " thr elevator" : " thr direct"),
+            (pages * Page::PAGE_SIZE / (1024.0 * 1024.0)) / seconds,
+            (seconds * 1e6) / pages * threads,
+            pages,
+            merge_ratio};
+    }
+
+    // Cold random 4K reads from a single thread: in_flight coroutines on
+    // one event loop, each awaiting its share of the reads in turn.
+    static Result coroutine_read_benchmark(const std::string &filename, size_t in_flight, bool direct_io,
+                                           size_t reads)
+    {
+        int fd = direct_io ? open(filename.c_str(), O_RDONLY | O_DIRECT) : -1;
+        if (fd < 0)
+        {
+            fd = open(filename.c_str(), O_RDONLY);
+            direct_io = false;
+        }
+        auto inode = std::make_shared<Inode>(1, filename);
+        inode->set_file_descriptor(fd);
+        inode->set_direct_io(direct_io);
+        inode->set_size(lseek(fd, 0, SEEK_END));
+
+        std::vector<uint64_t> pages(inode->size() / Page::PAGE_SIZE);
+        for (size_t i = 0; i < pages.size(); ++i)
+        {
+            pages[i] = i;
+        }
+        std::shuffle(pages.begin(), pages.end(), std::mt19937(42));
+        pages.resize(std::min(reads, pages.size()));
+
+        auto cache = std::make_shared<PageCache>(65536);
+        File file(inode, FileMode::ReadOnly, cache,
+                  IOEngine::create(PageCacheSystem::IO_QUEUE_DEPTH, cache->shared_frame_pool()));
+
+        EventLoop loop;
+        for (size_t first = 0; first < in_flight; ++first)
+        {
+            loop.spawn(read_share(file, pages, first, in_flight));
+        }
+        auto start = high_resolution_clock::now();
+        loop.run();
+        auto end = high_resolution_clock::now();
+        close(fd);
+
+        double seconds = duration_cast<nanoseconds>(end - start).count() / 1e9;
+        return {
+            std::to_string(in_flight) + " in flight",
+            (pages.size() * Page::PAGE_SIZE / (1024.0 * 1024.0)) / seconds,
+            (seconds * 1e6) / pages.size() * std::min(in_flight, pages.size()),
+            pages.size(),
+            0.0};
+    }
+
+    static Async<void> read_share(File &file, const std::vector<uint64_t> &pages, size_t first, size_t step)
+    {
+        uint8_t buffer[4096];
+        uint8_t sink = 0;
+        for (size_t i = first; i < pages.size(); i += step)
+        {
+            co_await file.read_async(pages[i] * Page::PAGE_SIZE, buffer, sizeof(buffer));
+            sink ^= buffer[0];
+        }
+        benchmark_sink = sink;
+    }
+
+    // Random 4K reads straight through an I/O engine, keeping queue_depth
+    // of them in flight, into frames of a pool registered with the engine.
+    static Result io_engine_benchmark(const std::string &filename, bool use_uring, unsigned queue_depth,
+                                      size_t ops)
+    {
+        int fd = open(filename.c_str(), O_RDONLY);
+        off_t file_pages = lseek(fd, 0, SEEK_END) / Page::PAGE_SIZE;
+
+        auto pool = std::make_shared<PageFramePool>(queue_depth);
+        std::shared_ptr<IOEngine> engine = use_uring ? IOEngine::create(queue_depth, pool)
+                                                     : std::make_shared<SyncIOEngine>();
+        std::vector<uint8_t *> frames;
+        for (unsigned i = 0; i < queue_depth; ++i)
+        {
+            frames.push_back(pool->allocate());
+        }
+
+        std::mutex lock;
+        std::condition_variable cv;
+        std::vector<uint8_t *> idle = frames;
+        size_t completed = 0;
+
+        std::mt19937_64 rng(queue_depth);
+        std::uniform_int_distribution<off_t> dist(0, file_pages - 1);
+
+        auto start = high_resolution_clock::now();
+        for (size_t issued = 0; issued < ops;)
+        {
+            std::vector<uint8_t *> batch;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                cv.wait(guard, [&]
+                        { return !idle.empty(); });
+                batch.swap(idle);
+            }
+
+            for (uint8_t *frame : batch)
+            {
+                if (issued == ops)
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    idle.push_back(frame);
+                    continue;
+                }
+                struct iovec iov = {frame, Page::PAGE_SIZE};
+                engine->queue_read(fd, dist(rng) * Page::PAGE_SIZE, &iov, 1, [&, frame](ssize_t)
+                                   {
+                    std::lock_guard<std::mutex> guard(lock);
+                    idle.push_back(frame);
+                    completed++;
+                    cv.notify_one(); });
+                issued++;
+            }
+            engine->submit();
+        }
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            cv.wait(guard, [&]
+                    { return completed == ops; });
+        }
+        auto end = high_resolution_clock::now();
+
+        std::string name = std::string(engine->name()) + " QD" + std::to_string(queue_depth) +
+                           (engine->registered_buffers() ? " fixed" : "");
+        engine.reset();
+        for (uint8_t *frame : frames)
+        {
+            pool->release(frame);
+        }
+        close(fd);
+
+        double seconds = duration_cast<nanoseconds>(end - start).count() / 1e9;
+        return {
+            name,
+            (ops * Page::PAGE_SIZE / (1024.0 * 1024.0)) / seconds,
+            (seconds * 1e6) / ops,
+            ops,
+            0.0};
+    }
+
+    static Result concurrent_hit_benchmark(size_t num_shards, size_t num_threads, size_t ops_per_thread)
+    {
+        const size_t working_set = 16384;
+        PageCache cache(65536, num_shards);
+
+        auto loader = [](uint8_t *data)
+        {
+            std::memset(data, 'h', Page::PAGE_SIZE);
+            return true;
+        };
+
+        for (size_t i = 0; i < working_set; ++i)
+        {
+            cache.get_or_load(1, i, loader);
+        }
+
+        std::vector<std::thread> threads;
+        auto start = high_resolution_clock::now();
+
+        for (size_t t = 0; t < num_threads; ++t)
+        {
+            threads.emplace_back([&cache, &loader, t, ops_per_thread, working_set]()
+                                 {
+                std::mt19937_64 rng(t + 1);
+                std::uniform_int_distribution<uint64_t> dist(0, working_set - 1);
+                for (size_t i = 0; i < ops_per_thread; ++i)
+                {
+                    cache.get_or_load(1, dist(rng), loader);
+                } });
+        }
+
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+
+        auto end = high_resolution_clock::now();
+        double seconds = duration_cast<nanoseconds>(end - start).count() / 1e9;
+        uint64_t total_ops = num_threads * ops_per_thread;
+
+        double throughput = (total_ops * Page::PAGE_SIZE / (1024.0 * 1024.0)) / seconds;
+        double latency = (seconds * 1e6) / ops_per_thread;
+
+        return {
+            "Hit " + std::to_string(num_threads) + "T/" + std::to_string(cache.num_shards()) + "S",
+            throughput,
+            latency,
+            total_ops,
+            1.0};
+    }
+
+    static Result hit_latency_benchmark(size_t max_pages, size_t ops)
+    {
+        PageCache cache(max_pages);
+
+        auto loader = [](uint8_t *)
+        { return true; };
+
+        for (size_t i = 0; i < max_pages; ++i)
+        {
+            cache.get_or_load(1, i, loader);
+        }
+
+        std::mt19937_64 rng(42);
+        std::uniform_int_distribution<uint64_t> dist(0, max_pages - 1);
+
+        auto start = high_resolution_clock::now();
+        for (size_t i = 0; i < ops; ++i)
+        {
+            cache.get_or_load(1, dist(rng), loader);
+        }
+        auto end = high_resolution_clock::now();
+
+        double seconds = duration_cast<nanoseconds>(end - start).count() / 1e9;
+
+        return {
+            "Hit " + std::to_string(max_pages / 1024) + "K pages",
+            (ops * Page::PAGE_SIZE / (1024.0 * 1024.0)) / seconds,
+            (seconds * 1e6) / ops,
+            ops,
+            1.0};
+    }
+
+    static void index_lookup_benchmark(size_t num_keys, size_t lookups)
+    {
+        const uint64_t num_files = 16;
+        auto pool = std::make_shared<PageFramePool>(num_keys);
+
+        FlatPageMap flat(num_keys);
+        std::unordered_map<uint64_t, std::unordered_map<uint64_t, std::shared_ptr<Page>>> nested;
+        for (uint64_t i = 0; i < num_keys; ++i)
+        {
+            auto page = std::make_shared<Page>(i % num_files, i / num_files, pool);
+            flat.insert_or_assign(page);
+            nested[i % num_files][i / num_files] = page;
+        }
+
+        std::vector<uint64_t> probes(lookups);
+        std::mt19937_64 rng(7);
+        std::uniform_int_distribution<uint64_t> dist(0, num_keys - 1);
+        for (auto &probe : probes)
+        {
+            probe = dist(rng);
+        }
+
+        // A cache hit always goes on to use the page, so both sides read it.
+        uint64_t flat_sum = 0;
+        uint64_t nested_sum = 0;
+        auto start = high_resolution_clock::now();
+        for (uint64_t key : probes)
+        {
+            flat_sum += flat.find({key % num_files, key / num_files})->index();
+        }
+        auto mid = high_resolution_clock::now();
+        for (uint64_t key : probes)
+        {
+            auto file_it = nested.find(key % num_files);
+            nested_sum += file_it->second.find(key / num_files)->second->index();
+        }
+        auto end = high_resolution_clock::now();
+
+        double flat_ns = duration_cast<nanoseconds>(mid - start).count() / (double)lookups;
+        double nested_ns = duration_cast<nanoseconds>(end - mid).count() / (double)lookups;
+
+        std::cout << std::left << std::setw(25) << ("Index " + std::to_string(num_keys / 1024) + "K keys")
+                  << "flat " << std::fixed << std::setprecision(1) << flat_ns << " ns/op, "
+                  << "nested maps " << nested_ns << " ns/op"
+                  << (flat_sum == nested_sum ? "" : " (lookup mismatch)") << std::endl;
+    }
+
     static void print_result(const Result &r)
     {
         std::cout << std::left << std::setw(25) << r.name
@@ -171,6 +782,27 @@ public:
                   << std::endl;
     }
 
+    static void print_latencies(const Counters::Snapshot &counters)
+    {
+        std::cout << std::left << std::setw(25) << "Latency (us)" << std::setw(12) << "Count" << std::setw(12)
+                  << "p50" << std::setw(12) << "p99" << std::setw(12) << "p99.9" << std::setw(12) << "Max"
+                  << std::endl;
+        std::pair<const char *, const LatencyHistogram::Snapshot *> rows[] = {
+            {"read hit", &counters.read_hit_latency},
+            {"miss", &counters.miss_latency},
+            {"eviction", &counters.eviction_latency},
+            {"writeback extent", &counters.writeback_latency},
+            {"fsync", &counters.fsync_latency}};
+        for (const auto &row : rows)
+        {
+            const LatencyHistogram::Snapshot &h = *row.second;
+            std::cout << std::left << std::setw(25) << row.first << std::setw(12) << h.count() << std::fixed
+                      << std::setprecision(2) << std::setw(12) << h.percentile(50) / 1000.0 << std::setw(12)
+                      << h.percentile(99) / 1000.0 << std::setw(12) << h.percentile(99.9) / 1000.0
+                      << std::setw(12) << h.max() / 1000.0 << std::endl;
+        }
+    }
+
     static void print_csv_header()
     {
         std::cout << "Benchmark,Throughput (MB/s),Latency (us),Operations,Hit Ratio (%)" << std::endl;
@@ -190,9 +822,14 @@ int main(int argc, char **argv)
 {
     std::string test_file = "/tmp/pagecache_test.dat";
     size_t file_size_mb = 256;
+    // --direct reads the test file with O_DIRECT, so file benchmarks see
+    // real device reads instead of the kernel's copy of the file.
+    bool direct_io = argc > 1 && std::string(argv[1]) == "--direct";
 
     std::cout << "PageCache Benchmark Suite" << std::endl;
     std::cout << "==========================" << std::endl;
+    PageCacheSystem::instance().set_direct_io(direct_io);
+    std::cout << "Backing I/O: " << (direct_io ? "O_DIRECT" : "buffered") << std::endl;
 
     std::cout << "\nSetting up test file (" << file_size_mb << " MB)..." << std::endl;
     Benchmark::setup_test_file(test_file, file_size_mb);
@@ -215,11 +852,132 @@ int main(int argc, char **argv)
     auto mixed_result = Benchmark::mixed_workload_benchmark(test_file, 800);
     Benchmark::print_result(mixed_result);
 
+    std::cout << "\nLatency percentiles of the runs above:\n"
+              << std::endl;
+    Benchmark::print_latencies(PageCacheSystem::instance().get_counters()->snapshot());
+
+    std::cout << "\nLarge reads (copy vs zero-copy):\n"
+              << std::endl;
+    auto copy_result = Benchmark::large_read_benchmark(test_file, false, 2000);
+    Benchmark::print_result(copy_result);
+    auto zero_copy_result = Benchmark::large_read_benchmark(test_file, true, 2000);
+    Benchmark::print_result(zero_copy_result);
+
+    std::cout << "\nCold sequential 4K reads (readahead window):\n"
+              << std::endl;
+    std::vector<Benchmark::Result> stream_results;
+    for (size_t window : {size_t(0), size_t(32), size_t(128), size_t(256)})
+    {
+        stream_results.push_back(Benchmark::streaming_read_benchmark(test_file, window, direct_io));
+        Benchmark::print_result(stream_results.back());
+    }
+
+    std::cout << "\nStrided and reverse 4K reads:\n"
+              << std::endl;
+    for (int64_t stride : {int64_t(8), int64_t(64), int64_t(-1)})
+    {
+        for (bool readahead : {false, true})
+        {
+            stream_results.push_back(Benchmark::pattern_read_benchmark(test_file, stride, readahead, direct_io, 8192));
+            Benchmark::print_result(stream_results.back());
+        }
+    }
+
+    std::cout << "\nSequential 4K reads under a bulk writer (I/O priorities off vs on):\n"
+              << std::endl;
+    for (bool prioritized : {false, true})
+    {
+        stream_results.push_back(Benchmark::priority_read_benchmark(test_file, prioritized, direct_io, 32768));
+        Benchmark::print_result(stream_results.back());
+    }
+
+    std::cout << "\nInterleaved cold 4K reads by thread count (merge ratio in the hit column):\n"
+              << std::endl;
+    for (size_t threads : {size_t(1), size_t(4), size_t(16)})
+    {
+        for (bool scheduled : {false, true})
+        {
+            stream_results.push_back(
+                Benchmark::interleaved_read_benchmark(test_file, threads, scheduled, direct_io, 16384));
+            Benchmark::print_result(stream_results.back());
+        }
+    }
+
+    std::cout << "\nCoroutine cold 4K reads on one thread by reads in flight:\n"
+              << std::endl;
+    for (size_t in_flight : {size_t(1), size_t(16), size_t(256), size_t(4096)})
+    {
+        stream_results.push_back(Benchmark::coroutine_read_benchmark(test_file, in_flight, direct_io, 16384));
+        Benchmark::print_result(stream_results.back());
+    }
+
+    std::cout << "\nI/O engine random 4K reads (sync vs io_uring by queue depth):\n"
+              << std::endl;
+    std::vector<Benchmark::Result> io_results;
+    io_results.push_back(Benchmark::io_engine_benchmark(test_file, false, 1, 100000));
+    Benchmark::print_result(io_results.back());
+    for (unsigned depth = 1; depth <= 128; depth *= 2)
+    {
+        io_results.push_back(Benchmark::io_engine_benchmark(test_file, true, depth, 100000));
+        Benchmark::print_result(io_results.back());
+    }
+
+    std::cout << "\nConcurrent cache hits (single shard vs sharded):\n"
+              << std::endl;
+    std::vector<Benchmark::Result> hit_results;
+    size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t threads = 1; threads <= max_threads * 2; threads *= 2)
+    {
+        for (size_t shards : {size_t(1), size_t(0)})
+        {
+            hit_results.push_back(Benchmark::concurrent_hit_benchmark(shards, threads, 200000));
+            Benchmark::print_result(hit_results.back());
+        }
+    }
+
+    std::cout << "\nHit latency vs cache size:\n"
+              << std::endl;
+    // The loader never writes its frame, so pool frames stay unfaulted and
+    // only per-page metadata (well under 512 bytes a page) becomes resident.
+    uint64_t phys_bytes = (uint64_t)sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGE_SIZE);
+    for (size_t max_pages = 4096; max_pages <= (size_t(4) << 20); max_pages *= 4)
+    {
+        if (max_pages * 512 > phys_bytes / 2)
+        {
+            std::cout << "Hit " << (max_pages / 1024) << "K pages: skipped, needs "
+                      << (max_pages * 512 >> 20) << " MB of page metadata" << std::endl;
+            continue;
+        }
+        hit_results.push_back(Benchmark::hit_latency_benchmark(max_pages, 1000000));
+        Benchmark::print_result(hit_results.back());
+    }
+
+    std::cout << "\nPage index lookups:\n"
+              << std::endl;
+    for (size_t num_keys : {size_t(4096), size_t(65536), size_t(262144)})
+    {
+        Benchmark::index_lookup_benchmark(num_keys, 2000000);
+    }
+
     std::cout << "\nCSV Output:" << std::endl;
     Benchmark::print_csv_header();
     Benchmark::print_csv_result(seq_result);
     Benchmark::print_csv_result(rand_result);
     Benchmark::print_csv_result(mixed_result);
+    Benchmark::print_csv_result(copy_result);
+    Benchmark::print_csv_result(zero_copy_result);
+    for (const auto &r : stream_results)
+    {
+        Benchmark::print_csv_result(r);
+    }
+    for (const auto &r : io_results)
+    {
+        Benchmark::print_csv_result(r);
+    }
+    for (const auto &r : hit_results)
+    {
+        Benchmark::print_csv_result(r);
+    }
 
     return 0;
 }
@@ -0,0 +1,220 @@
+#include "Epoch.h"
+#include <thread>
+
+namespace pagecache
+{
+
+    namespace
+    {
+        // A thread keeps the slot it claimed in a domain until it exits or
+        // starts using a different domain.
+        struct ThreadState
+        {
+            EpochDomain *domain = nullptr;
+            void *slot = nullptr;
+            size_t depth = 0;
+            void (*release)(void *) = nullptr;
+
+            ~ThreadState()
+            {
+                if (release)
+                {
+                    release(slot);
+                }
+            }
+        };
+
+        thread_local ThreadState thread_state;
+    }
+
+    EpochDomain &EpochDomain::global()
+    {
+        static EpochDomain *domain = new EpochDomain;
+        return *domain;
+    }
+
+    EpochDomain::EpochDomain()
+        : slots_(new Slot[MAX_THREADS]),
+          global_epoch_(1),
+          stripes_(new RetireStripe[RETIRE_STRIPES])
+    {
+    }
+
+    EpochDomain::~EpochDomain()
+    {
+        for (size_t s = 0; s < RETIRE_STRIPES; ++s)
+        {
+            for (const Retired &r : stripes_[s].retired)
+            {
+                r.deleter(r.ptr);
+            }
+        }
+        delete[] slots_;
+    }
+
+    // Threads take stripes in turn as they first retire.
+    size_t EpochDomain::stripe_index()
+    {
+        static std::atomic<size_t> next_stripe(0);
+        thread_local size_t stripe = next_stripe.fetch_add(1, std::memory_order_relaxed) % RETIRE_STRIPES;
+        return stripe;
+    }
+
+    EpochDomain::Guard::Guard(EpochDomain &domain)
+        : slot_(nullptr)
+    {
+        ThreadState &state = thread_state;
+        if (state.domain != &domain)
+        {
+            if (state.depth != 0)
+            {
+                // Nested guards from another domain keep their slot.
+                return;
+            }
+            if (state.release)
+            {
+                state.release(state.slot);
+            }
+            state.domain = &domain;
+            state.slot = domain.claim_slot();
+            state.release = [](void *slot)
+            {
+                static_cast<Slot *>(slot)->claimed.store(false, std::memory_order_release);
+            };
+            if (!state.slot)
+            {
+                state.domain = nullptr;
+                state.release = nullptr;
+                return;
+            }
+        }
+
+        slot_ = static_cast<Slot *>(state.slot);
+        if (state.depth++ == 0)
+        {
+            slot_->epoch.store(domain.global_epoch_.load(std::memory_order_relaxed),
+                               std::memory_order_relaxed);
+            // Publish the pinned epoch before any load of shared pointers.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    EpochDomain::Guard::~Guard()
+    {
+        if (slot_ && --thread_state.depth == 0)
+        {
+            slot_->epoch.store(0, std::memory_order_release);
+        }
+    }
+
+    void EpochDomain::retire(void *ptr, void (*deleter)(void *))
+    {
+        RetireStripe &stripe = stripes_[stripe_index()];
+        {
+            std::lock_guard<std::mutex> lock(stripe.lock);
+            stripe.retired.push_back({ptr, deleter, global_epoch_.load(std::memory_order_relaxed)});
+            if (++stripe.retires_since_collect < COLLECT_INTERVAL)
+            {
+                return;
+            }
+        }
+        collect(stripe);
+    }
+
+    void EpochDomain::synchronize()
+    {
+        // Everything retired so far carries an epoch no later than the
+        // current one, so it is all free to go two epochs on.
+        const uint64_t target = global_epoch_.load(std::memory_order_acquire) + 2;
+        while (global_epoch_.load(std::memory_order_acquire) < target)
+        {
+            if (!try_advance())
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        for (size_t s = 0; s < RETIRE_STRIPES; ++s)
+        {
+            collect(stripes_[s]);
+        }
+    }
+
+    size_t EpochDomain::pending() const
+    {
+        size_t total = 0;
+        for (size_t s = 0; s < RETIRE_STRIPES; ++s)
+        {
+            std::lock_guard<std::mutex> lock(stripes_[s].lock);
+            total += stripes_[s].retired.size();
+        }
+        return total;
+    }
+
+    EpochDomain::Slot *EpochDomain::claim_slot()
+    {
+        for (size_t i = 0; i < MAX_THREADS; ++i)
+        {
+            bool expected = false;
+            if (!slots_[i].claimed.load(std::memory_order_relaxed) &&
+                slots_[i].claimed.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            {
+                return &slots_[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // Stripes collect independently, so the epoch only moves forward by
+    // compare-and-swap: a caller that saw an older epoch must not store it
+    // back over a newer one.
+    bool EpochDomain::try_advance()
+    {
+        uint64_t epoch = global_epoch_.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        for (size_t i = 0; i < MAX_THREADS; ++i)
+        {
+            uint64_t pinned = slots_[i].epoch.load(std::memory_order_acquire);
+            if (pinned != 0 && pinned != epoch)
+            {
+                return false;
+            }
+        }
+
+        return global_epoch_.compare_exchange_strong(epoch, epoch + 1, std::memory_order_acq_rel,
+                                                     std::memory_order_relaxed);
+    }
+
+    void EpochDomain::collect(RetireStripe &stripe)
+    {
+        try_advance();
+        uint64_t epoch = global_epoch_.load(std::memory_order_acquire);
+
+        std::vector<Retired> ready;
+        {
+            std::lock_guard<std::mutex> lock(stripe.lock);
+            stripe.retires_since_collect = 0;
+
+            size_t kept = 0;
+            for (const Retired &r : stripe.retired)
+            {
+                if (r.epoch + 2 <= epoch)
+                {
+                    ready.push_back(r);
+                }
+                else
+                {
+                    stripe.retired[kept++] = r;
+                }
+            }
+            stripe.retired.resize(kept);
+        }
+
+        for (const Retired &r : ready)
+        {
+            r.deleter(r.ptr);
+        }
+    }
+
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace pagecache
+{
+
+    // Epoch-based reclamation for the lock-free lookup paths. Readers wrap
+    // their accesses in a Guard, which pins the current global epoch in a
+    // per-thread slot. Writers hand unlinked objects to retire(); an object
+    // retired in epoch e is destroyed once the global epoch has reached
+    // e + 2, which can only happen after every thread that might still hold
+    // a pointer to it has left its guard. Retired objects queue on one of
+    // RETIRE_STRIPES lists, picked per thread, so concurrent evictions do
+    // not all contend on one lock.
+    class EpochDomain
+    {
+        struct Slot;
+
+    public:
+        static constexpr size_t MAX_THREADS = 256;
+        // Retirements on a stripe between attempts to advance the epoch and
+        // free that stripe.
+        static constexpr size_t COLLECT_INTERVAL = 64;
+        static constexpr size_t RETIRE_STRIPES = 16;
+
+        // Process-wide domain shared by all caches. It is never destroyed,
+        // so caches with static storage can still retire into it at exit.
+        static EpochDomain &global();
+
+        EpochDomain();
+        ~EpochDomain();
+
+        EpochDomain(const EpochDomain &) = delete;
+        EpochDomain &operator=(const EpochDomain &) = delete;
+
+        // Guards nest. A guard is inactive when every thread slot is taken;
+        // callers must then fall back to their locked path.
+        class Guard
+        {
+        public:
+            explicit Guard(EpochDomain &domain = EpochDomain::global());
+            ~Guard();
+
+            Guard(const Guard &) = delete;
+            Guard &operator=(const Guard &) = delete;
+
+            explicit operator bool() const { return slot_ != nullptr; }
+
+        private:
+            Slot *slot_;
+        };
+
+        void retire(void *ptr, void (*deleter)(void *));
+
+        template <typename T>
+        void retire(T *ptr)
+        {
+            retire(ptr, [](void *p)
+                   { delete static_cast<T *>(p); });
+        }
+
+        // Waits until everything retired before the call has been destroyed.
+        // Later retirements, from this or any other thread, are not waited
+        // for, so the wait is bounded by the guards open at the call. Must
+        // not be called from inside a guard.
+        void synchronize();
+
+        uint64_t epoch() const { return global_epoch_.load(std::memory_order_relaxed); }
+        size_t pending() const;
+
+    private:
+        struct alignas(64) Slot
+        {
+            // Epoch pinned by the owning thread, or 0 outside any guard.
+            std::atomic<uint64_t> epoch{0};
+            std::atomic<bool> claimed{false};
+        };
+
+        struct Retired
+        {
+            void *ptr;
+            void (*deleter)(void *);
+            uint64_t epoch;
+        };
+
+        struct alignas(64) RetireStripe
+        {
+            std::mutex lock;
+            std::vector<Retired> retired;
+            size_t retires_since_collect = 0;
+        };
+
+        Slot *slots_;
+        std::atomic<uint64_t> global_epoch_;
+        std::unique_ptr<RetireStripe[]> stripes_;
+
+        static size_t stripe_index();
+        Slot *claim_slot();
+        bool try_advance();
+        void collect(RetireStripe &stripe);
+    };
+
+}
@@ -1,5 +1,6 @@
 #include "Eviction.h"
 #include <algorithm>
+#include <iterator>
 #include <limits>
 
 namespace pagecache
@@ -34,21 +35,414 @@ namespace pagecache
         if (candidates.empty())
             return nullptr;
 
-        size_t start_idx = clock_hand_ % candidates.size();
-        size_t idx = start_idx;
-
-        do
+        // Two revolutions: the first may only clear reference bits.
+        for (size_t step = 0; step < 2 * candidates.size(); ++step)
         {
+            size_t idx = clock_hand_++ % candidates.size();
             const auto &page = candidates[idx];
-            if (page->refcount() == 0 && !page->is_locked())
+            if (page->refcount() == 0 && !page->is_locked() && !page->clear_referenced())
             {
-                clock_hand_ = (idx + 1) % candidates.size();
                 return page;
             }
-            idx = (idx + 1) % candidates.size();
-        } while (idx != start_idx);
+        }
+
+        return nullptr;
+    }
+
+    Page *ReplacementPolicy::first_evictable(const LruList &list)
+    {
+        for (Page *page = list.front(); page; page = LruList::next(page))
+        {
+            if (evictable(page))
+            {
+                return page;
+            }
+        }
+        return nullptr;
+    }
+
+    Page *ReplacementPolicy::second_chance(LruList &list, LruList &promote_to, uint8_t tag)
+    {
+        Page *page = list.front();
+        for (size_t n = list.size(); page && n > 0; --n)
+        {
+            Page *next = LruList::next(page);
+            if (evictable(page))
+            {
+                if (!page->clear_referenced())
+                {
+                    return page;
+                }
+                list.remove(page);
+                promote_to.push_back(page);
+                set_list_tag(page, tag);
+            }
+            page = next;
+        }
+        return first_evictable(list);
+    }
+
+    void ClockPolicy::on_insert(Page *page)
+    {
+        uint32_t slot;
+        if (!free_slots_.empty())
+        {
+            slot = free_slots_.back();
+            free_slots_.pop_back();
+            ring_[slot] = page;
+        }
+        else
+        {
+            slot = (uint32_t)ring_.size();
+            ring_.push_back(page);
+        }
+
+        set_slot(page, slot);
+        page->clear_referenced();
+        size_++;
+    }
+
+    void ClockPolicy::unlink(Page *page)
+    {
+        uint32_t slot = slot_of(page);
+        ring_[slot] = nullptr;
+        free_slots_.push_back(slot);
+        size_--;
+    }
+
+    Page *ClockPolicy::select_victim()
+    {
+        if (ring_.empty())
+        {
+            return nullptr;
+        }
+
+        // Two revolutions: the first may only clear reference bits.
+        for (size_t step = 0; step < 2 * ring_.size(); ++step)
+        {
+            if (hand_ >= ring_.size())
+            {
+                hand_ = 0;
+            }
+            Page *page = ring_[hand_++];
+
+            if (!page || !evictable(page))
+            {
+                continue;
+            }
+            if (page->clear_referenced())
+            {
+                continue;
+            }
+            return page;
+        }
 
         return nullptr;
     }
 
+    void ArcPolicy::GhostList::push_back(const PageKey &key)
+    {
+        order_.push_back(key);
+        where_[key] = std::prev(order_.end());
+    }
+
+    bool ArcPolicy::GhostList::erase(const PageKey &key)
+    {
+        auto it = where_.find(key);
+        if (it == where_.end())
+        {
+            return false;
+        }
+        order_.erase(it->second);
+        where_.erase(it);
+        return true;
+    }
+
+    void ArcPolicy::GhostList::pop_front()
+    {
+        where_.erase(order_.front());
+        order_.pop_front();
+    }
+
+    ArcPolicy::ArcPolicy(size_t capacity)
+        : capacity_(capacity), p_(0), miss_in_b2_(false)
+    {
+    }
+
+    void ArcPolicy::on_miss(const PageKey &key)
+    {
+        miss_in_b2_ = false;
+
+        if (b1_.contains(key))
+        {
+            size_t delta = std::max<size_t>(1, b2_.size() / b1_.size());
+            p_ = std::min(capacity_, p_ + delta);
+        }
+        else if (b2_.contains(key))
+        {
+            size_t delta = std::max<size_t>(1, b1_.size() / b2_.size());
+            p_ = p_ > delta ? p_ - delta : 0;
+            miss_in_b2_ = true;
+        }
+    }
+
+    void ArcPolicy::on_insert(Page *page)
+    {
+        const PageKey key{page->file_id(), page->index()};
+
+        if (b1_.erase(key) || b2_.erase(key))
+        {
+            t2_.push_back(page);
+            set_list_tag(page, IN_T2);
+        }
+        else
+        {
+            t1_.push_back(page);
+            set_list_tag(page, IN_T1);
+        }
+
+        trim_ghosts();
+    }
+
+    void ArcPolicy::on_access(Page *page)
+    {
+        if (list_tag(page) == IN_T1)
+        {
+            t1_.remove(page);
+            t2_.push_back(page);
+            set_list_tag(page, IN_T2);
+        }
+        else
+        {
+            t2_.move_to_back(page);
+        }
+    }
+
+    void ArcPolicy::on_evict(Page *page)
+    {
+        const PageKey key{page->file_id(), page->index()};
+        bool from_t1 = list_tag(page) == IN_T1;
+
+        unlink(page);
+        if (from_t1)
+        {
+            b1_.push_back(key);
+        }
+        else
+        {
+            b2_.push_back(key);
+        }
+
+        trim_ghosts();
+    }
+
+    void ArcPolicy::on_remove(Page *page)
+    {
+        unlink(page);
+    }
+
+    Page *ArcPolicy::select_victim()
+    {
+        // Lock-free hits only leave a reference bit, folded in here as in
+        // CAR (Bansal & Modha, FAST '04): referenced T1 pages graduate to T2
+        // and referenced T2 pages go round again.
+        //
+        // REPLACE(x, p) picks the list first: T1 while it is above its
+        // target, or at the target when the pending miss was remembered in
+        // B2. Only that list is swept, so the other keeps its bits; the
+        // other list is the fallback when nothing in the first can go.
+        bool prefer_t1 = !t1_.empty() &&
+                         (t1_.size() > p_ || (miss_in_b2_ && t1_.size() == p_));
+
+        Page *victim;
+        if (prefer_t1)
+        {
+            victim = second_chance(t1_, t2_, IN_T2);
+            if (!victim)
+            {
+                victim = second_chance(t2_, t2_, IN_T2);
+            }
+        }
+        else
+        {
+            victim = second_chance(t2_, t2_, IN_T2);
+            if (!victim)
+            {
+                victim = second_chance(t1_, t2_, IN_T2);
+            }
+        }
+        return victim;
+    }
+
+    void ArcPolicy::unlink(Page *page)
+    {
+        if (list_tag(page) == IN_T1)
+        {
+            t1_.remove(page);
+        }
+        else
+        {
+            t2_.remove(page);
+        }
+        set_list_tag(page, 0);
+    }
+
+    void ArcPolicy::trim_ghosts()
+    {
+        while (t1_.size() + b1_.size() > capacity_ && !b1_.empty())
+        {
+            b1_.pop_front();
+        }
+
+        while (t1_.size() + t2_.size() + b1_.size() + b2_.size() > 2 * capacity_)
+        {
+            if (!b2_.empty())
+            {
+                b2_.pop_front();
+            }
+            else if (!b1_.empty())
+            {
+                b1_.pop_front();
+            }
+            else
+            {
+                break;
+            }
+        }
+    }
+
+    TinyLfuPolicy::TinyLfuPolicy(EvictionPolicy main_policy, size_t capacity)
+        : window_capacity_(std::max<size_t>(1, capacity / 100)),
+          main_capacity_(capacity > window_capacity_ ? capacity - window_capacity_ : 1),
+          main_(make_replacement_policy(main_policy, main_capacity_)),
+          sketch_(capacity),
+          admitted_(0),
+          rejected_(0)
+    {
+    }
+
+    void TinyLfuPolicy::on_miss(const PageKey &key)
+    {
+        sketch_.record(key);
+    }
+
+    void TinyLfuPolicy::on_insert(Page *page)
+    {
+        window_.push_back(page);
+        set_list_tag(page, IN_WINDOW);
+    }
+
+    void TinyLfuPolicy::on_access(Page *page)
+    {
+        sketch_.record(key_of(page));
+
+        if (list_tag(page) == IN_WINDOW)
+        {
+            window_.move_to_back(page);
+        }
+        else
+        {
+            main_->on_access(page);
+        }
+    }
+
+    void TinyLfuPolicy::on_hit(Page *page)
+    {
+        sketch_.record(key_of(page));
+        page->mark_referenced();
+    }
+
+    void TinyLfuPolicy::on_evict(Page *page)
+    {
+        if (list_tag(page) == IN_WINDOW)
+        {
+            window_.remove(page);
+            set_list_tag(page, 0);
+        }
+        else
+        {
+            main_->on_evict(page);
+        }
+    }
+
+    void TinyLfuPolicy::on_remove(Page *page)
+    {
+        if (list_tag(page) == IN_WINDOW)
+        {
+            window_.remove(page);
+            set_list_tag(page, 0);
+        }
+        else
+        {
+            main_->on_remove(page);
+        }
+    }
+
+    Page *TinyLfuPolicy::select_victim()
+    {
+        for (;;)
+        {
+            Page *candidate = window_.size() >= window_capacity_
+                                  ? second_chance(window_, window_, IN_WINDOW)
+                                  : nullptr;
+            if (!candidate)
+            {
+                Page *victim = main_->select_victim();
+                return victim ? victim : first_evictable(window_);
+            }
+
+            if (main_->size() < main_capacity_)
+            {
+                admit(candidate);
+                continue;
+            }
+
+            Page *victim = main_->select_victim();
+            if (!victim)
+            {
+                return candidate;
+            }
+
+            if (sketch_.frequency(key_of(candidate)) > sketch_.frequency(key_of(victim)))
+            {
+                // The victim stays linked until the caller evicts it.
+                admitted_++;
+                admit(candidate);
+                return victim;
+            }
+
+            rejected_++;
+            return candidate;
+        }
+    }
+
+    void TinyLfuPolicy::admit(Page *page)
+    {
+        window_.remove(page);
+        set_list_tag(page, 0);
+        main_->on_miss(key_of(page));
+        main_->on_insert(page);
+    }
+
+    std::unique_ptr<ReplacementPolicy> make_replacement_policy(EvictionPolicy policy,
+                                                               size_t capacity,
+                                                               bool admission_filter)
+    {
+        if (admission_filter)
+        {
+            return std::make_unique<TinyLfuPolicy>(policy, capacity);
+        }
+
+        switch (policy)
+        {
+        case EvictionPolicy::CLOCK:
+            return std::make_unique<ClockPolicy>();
+        case EvictionPolicy::ARC:
+            return std::make_unique<ArcPolicy>(capacity);
+        case EvictionPolicy::LRU:
+        default:
+            return std::make_unique<LruPolicy>();
+        }
+    }
+
 }
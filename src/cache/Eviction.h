@@ -1,8 +1,13 @@
 #pragma once
 
 #include "Page.h"
+#include "LruList.h"
+#include "FlatPageMap.h"
+#include "FrequencySketch.h"
 #include <cstdint>
+#include <list>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 namespace pagecache
@@ -11,7 +16,8 @@ namespace pagecache
     enum class EvictionPolicy
     {
         LRU,
-        CLOCK
+        CLOCK,
+        ARC
     };
 
     class EvictionStrategy
@@ -40,4 +46,195 @@ namespace pagecache
         size_t clock_hand_;
     };
 
+    // Replacement state for one cache shard, driven by PageCache under the
+    // shard lock (apart from on_hit). Policies thread resident pages through
+    // the intrusive hooks in Page, so every callback is O(1) apart from
+    // skipping pinned, dirty or recently hit pages while looking for a
+    // victim. Dirty pages wait for writeback.
+    class ReplacementPolicy
+    {
+    public:
+        virtual ~ReplacementPolicy() = default;
+
+        // A lookup for key missed; called before making room for it.
+        virtual void on_miss(const PageKey &) {}
+        virtual void on_insert(Page *page) = 0;
+        // A lookup under the shard lock found the page.
+        virtual void on_access(Page *page) = 0;
+        // A lock-free lookup found the page. This runs concurrently with
+        // every other callback, so it may only touch atomic state; the
+        // default leaves the page's reference bit for select_victim.
+        virtual void on_hit(Page *page) { page->mark_referenced(); }
+        // The page was chosen by select_victim and is leaving the cache.
+        virtual void on_evict(Page *page) = 0;
+        // The page is leaving the cache for any other reason.
+        virtual void on_remove(Page *page) = 0;
+        // Returns an unpinned, unlocked, clean resident page, still linked.
+        virtual Page *select_victim() = 0;
+        virtual size_t size() const = 0;
+
+    protected:
+        static bool evictable(const Page *page)
+        {
+            return page->refcount() == 0 && !page->is_locked() && page->state() == PageState::Clean;
+        }
+
+        static Page *first_evictable(const LruList &list);
+
+        // Walks list from the front, moving referenced pages (bit cleared)
+        // to the back of promote_to with the given tag, and returns the
+        // first evictable page that had not been referenced.
+        static Page *second_chance(LruList &list, LruList &promote_to, uint8_t tag);
+
+        static uint8_t list_tag(const Page *page) { return page->policy_list_; }
+        static void set_list_tag(Page *page, uint8_t tag) { page->policy_list_ = tag; }
+
+        static uint32_t slot_of(const Page *page) { return page->policy_slot_; }
+        static void set_slot(Page *page, uint32_t slot) { page->policy_slot_ = slot; }
+    };
+
+    class LruPolicy : public ReplacementPolicy
+    {
+    public:
+        void on_insert(Page *page) override { lru_.push_back(page); }
+        void on_access(Page *page) override { lru_.move_to_back(page); }
+        void on_evict(Page *page) override { lru_.remove(page); }
+        void on_remove(Page *page) override { lru_.remove(page); }
+        Page *select_victim() override { return second_chance(lru_, lru_, 0); }
+        size_t size() const override { return lru_.size(); }
+
+    private:
+        LruList lru_;
+    };
+
+    // CLOCK over a circular array of resident pages. A hit only sets the
+    // page's reference bit; the persistent hand clears set bits as it sweeps
+    // and stops at the first unreferenced, evictable page. Slots freed by
+    // evictions are reused for new pages, which lands them just behind the
+    // hand, a full revolution away from the next sweep.
+    class ClockPolicy : public ReplacementPolicy
+    {
+    public:
+        ClockPolicy() : hand_(0), size_(0) {}
+
+        void on_insert(Page *page) override;
+        void on_access(Page *page) override { page->mark_referenced(); }
+        void on_evict(Page *page) override { unlink(page); }
+        void on_remove(Page *page) override { unlink(page); }
+        Page *select_victim() override;
+        size_t size() const override { return size_; }
+
+    private:
+        std::vector<Page *> ring_;
+        std::vector<uint32_t> free_slots_;
+        size_t hand_;
+        size_t size_;
+
+        void unlink(Page *page);
+    };
+
+    // Adaptive Replacement Cache (Megiddo & Modha, FAST '03). T1 holds pages
+    // seen once recently, T2 pages seen at least twice; B1/B2 remember the
+    // keys recently evicted from each. A miss that lands in a ghost list
+    // shifts the target size p of T1 towards the list that would have hit,
+    // so one-shot scans churn through T1 without flushing the T2 working set.
+    class ArcPolicy : public ReplacementPolicy
+    {
+    public:
+        explicit ArcPolicy(size_t capacity);
+
+        void on_miss(const PageKey &key) override;
+        void on_insert(Page *page) override;
+        void on_access(Page *page) override;
+        void on_evict(Page *page) override;
+        void on_remove(Page *page) override;
+        Page *select_victim() override;
+        size_t size() const override { return t1_.size() + t2_.size(); }
+
+        size_t target_t1() const { return p_; }
+        size_t t1_size() const { return t1_.size(); }
+        size_t t2_size() const { return t2_.size(); }
+        size_t b1_size() const { return b1_.size(); }
+        size_t b2_size() const { return b2_.size(); }
+
+    private:
+        class GhostList
+        {
+        public:
+            size_t size() const { return order_.size(); }
+            bool empty() const { return order_.empty(); }
+            bool contains(const PageKey &key) const { return where_.count(key) != 0; }
+            void push_back(const PageKey &key);
+            bool erase(const PageKey &key);
+            void pop_front();
+
+        private:
+            std::list<PageKey> order_;
+            std::unordered_map<PageKey, std::list<PageKey>::iterator, PageKeyHash> where_;
+        };
+
+        enum : uint8_t
+        {
+            IN_T1 = 1,
+            IN_T2 = 2
+        };
+
+        size_t capacity_;
+        size_t p_;
+        bool miss_in_b2_;
+        LruList t1_;
+        LruList t2_;
+        GhostList b1_;
+        GhostList b2_;
+
+        void unlink(Page *page);
+        void trim_ghosts();
+    };
+
+    // W-TinyLFU (Einziger, Friedman & Manes, 2017) in front of another
+    // policy. New pages enter a small LRU window; once it is full, the page
+    // leaving the window is only admitted to the main policy if the sketch
+    // has seen it more often than the main policy's own victim, otherwise
+    // the window page is the one evicted. Long tails of pages read once
+    // therefore churn through the window instead of the main working set.
+    class TinyLfuPolicy : public ReplacementPolicy
+    {
+    public:
+        TinyLfuPolicy(EvictionPolicy main_policy, size_t capacity);
+
+        void on_miss(const PageKey &key) override;
+        void on_insert(Page *page) override;
+        void on_access(Page *page) override;
+        void on_hit(Page *page) override;
+        void on_evict(Page *page) override;
+        void on_remove(Page *page) override;
+        Page *select_victim() override;
+        size_t size() const override { return window_.size() + main_->size(); }
+
+        size_t window_capacity() const { return window_capacity_; }
+        size_t window_size() const { return window_.size(); }
+        size_t admitted() const { return admitted_; }
+        size_t rejected() const { return rejected_; }
+
+    private:
+        // Outside the tag values the main policies use.
+        static constexpr uint8_t IN_WINDOW = 0x80;
+
+        size_t window_capacity_;
+        size_t main_capacity_;
+        LruList window_;
+        std::unique_ptr<ReplacementPolicy> main_;
+        FrequencySketch sketch_;
+        size_t admitted_;
+        size_t rejected_;
+
+        static PageKey key_of(const Page *page) { return {page->file_id(), page->index()}; }
+        void admit(Page *page);
+    };
+
+    // admission_filter wraps the chosen policy in TinyLfuPolicy.
+    std::unique_ptr<ReplacementPolicy> make_replacement_policy(EvictionPolicy policy,
+                                                               size_t capacity,
+                                                               bool admission_filter = false);
+
 }
@@ -0,0 +1,397 @@
+#include "FlatPageMap.h"
+#include "Epoch.h"
+#include <cstring>
+#include <new>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace pagecache
+{
+
+    namespace
+    {
+        constexpr int8_t CTRL_EMPTY = -128;
+        constexpr int8_t CTRL_DELETED = -2;
+        constexpr int8_t CTRL_UNUSED = -1;
+        constexpr uint32_t SLOT_MASK = (1u << FlatPageMap::CHUNK_SLOTS) - 1;
+
+        class Group
+        {
+        public:
+#if defined(__SSE2__)
+            explicit Group(const int8_t *ctrl)
+                : ctrl_(_mm_load_si128(reinterpret_cast<const __m128i *>(ctrl)))
+            {
+            }
+
+            uint32_t match(int8_t h2) const
+            {
+                return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl_, _mm_set1_epi8(h2))) & SLOT_MASK;
+            }
+
+            uint32_t match_empty() const
+            {
+                return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl_, _mm_set1_epi8(CTRL_EMPTY))) & SLOT_MASK;
+            }
+
+            uint32_t match_empty_or_deleted() const
+            {
+                return _mm_movemask_epi8(ctrl_) & SLOT_MASK;
+            }
+
+        private:
+            __m128i ctrl_;
+#else
+            explicit Group(const int8_t *ctrl)
+            {
+                std::memcpy(ctrl_, ctrl, sizeof(ctrl_));
+            }
+
+            uint32_t match(int8_t h2) const
+            {
+                uint32_t mask = 0;
+                for (size_t i = 0; i < FlatPageMap::CHUNK_SLOTS; ++i)
+                {
+                    mask |= (uint32_t)(ctrl_[i] == h2) << i;
+                }
+                return mask;
+            }
+
+            uint32_t match_empty() const
+            {
+                return match(CTRL_EMPTY);
+            }
+
+            uint32_t match_empty_or_deleted() const
+            {
+                uint32_t mask = 0;
+                for (size_t i = 0; i < FlatPageMap::CHUNK_SLOTS; ++i)
+                {
+                    mask |= (uint32_t)(ctrl_[i] < 0) << i;
+                }
+                return mask;
+            }
+
+        private:
+            int8_t ctrl_[16];
+#endif
+        };
+
+        inline int8_t h2_of(uint64_t hash) { return (int8_t)(hash & 0x7f); }
+        inline size_t h1_of(uint64_t hash) { return (size_t)(hash >> 7); }
+
+        inline PageKey key_of(const Page &page) { return {page.file_id(), page.index()}; }
+
+        inline unsigned lowest_bit(uint32_t mask) { return (unsigned)__builtin_ctz(mask); }
+
+        // Slot pointers and control bytes of a published table are written
+        // while lock-free readers may load them.
+        inline Page *load_page(Page *const *slot) { return __atomic_load_n(slot, __ATOMIC_ACQUIRE); }
+        inline void store_page(Page **slot, Page *page) { __atomic_store_n(slot, page, __ATOMIC_RELEASE); }
+        inline void store_ctrl(int8_t *ctrl, int8_t value) { __atomic_store_n(ctrl, value, __ATOMIC_RELEASE); }
+
+        // Readers copy the sixteen control bytes as two relaxed atomic words
+        // and match against the copy.
+        typedef uint64_t __attribute__((may_alias)) CtrlWord;
+
+        inline Group load_group(const int8_t *ctrl)
+        {
+            const CtrlWord *words = reinterpret_cast<const CtrlWord *>(ctrl);
+            alignas(16) CtrlWord copy[2] = {__atomic_load_n(&words[0], __ATOMIC_RELAXED),
+                                            __atomic_load_n(&words[1], __ATOMIC_RELAXED)};
+            return Group(reinterpret_cast<const int8_t *>(copy));
+        }
+
+        inline size_t max_load(size_t num_chunks)
+        {
+            size_t slots = num_chunks * FlatPageMap::CHUNK_SLOTS;
+            return slots - slots / 8;
+        }
+
+        size_t chunks_for(size_t expected_size)
+        {
+            size_t chunks = 1;
+            while (max_load(chunks) < expected_size)
+            {
+                chunks <<= 1;
+            }
+            return chunks;
+        }
+    }
+
+    FlatPageMap::FlatPageMap(size_t expected_size)
+        : chunks_(nullptr), owners_(nullptr), table_(nullptr), num_chunks_(0), size_(0), growth_left_(0)
+    {
+        if (expected_size > 0)
+        {
+            allocate(chunks_for(expected_size));
+            publish();
+        }
+    }
+
+    FlatPageMap::~FlatPageMap()
+    {
+        release(false);
+    }
+
+    Page *FlatPageMap::find(const PageKey &key) const
+    {
+        size_t slot = find_slot(key, hash_page_key(key));
+        if (slot == SIZE_MAX)
+        {
+            return nullptr;
+        }
+        return chunks_[slot / CHUNK_SLOTS].pages[slot % CHUNK_SLOTS];
+    }
+
+    Page *FlatPageMap::find_concurrent(const PageKey &key) const
+    {
+        const Table *table = table_.load(std::memory_order_acquire);
+        if (!table)
+        {
+            return nullptr;
+        }
+
+        uint64_t hash = hash_page_key(key);
+        size_t chunk_mask = table->num_chunks - 1;
+        size_t c = h1_of(hash) & chunk_mask;
+        int8_t h2 = h2_of(hash);
+
+        for (size_t probe = 1;; ++probe)
+        {
+            const Chunk &chunk = table->chunks[c];
+            Group g = load_group(chunk.ctrl);
+
+            for (uint32_t mask = g.match(h2); mask; mask &= mask - 1)
+            {
+                Page *page = load_page(&chunk.pages[lowest_bit(mask)]);
+                if (page && key_of(*page) == key)
+                {
+                    return page;
+                }
+            }
+
+            if (g.match_empty() || probe > chunk_mask)
+            {
+                return nullptr;
+            }
+            c = (c + probe) & chunk_mask;
+        }
+    }
+
+    bool FlatPageMap::insert_or_assign(std::shared_ptr<Page> page)
+    {
+        const PageKey key = key_of(*page);
+        uint64_t hash = hash_page_key(key);
+
+        size_t slot = find_slot(key, hash);
+        if (slot != SIZE_MAX)
+        {
+            store_page(&chunks_[slot / CHUNK_SLOTS].pages[slot % CHUNK_SLOTS], page.get());
+            owners_[slot] = std::move(page);
+            return false;
+        }
+
+        if (num_chunks_ == 0)
+        {
+            allocate(1);
+            publish();
+        }
+
+        slot = find_insert_slot(hash);
+        Chunk *chunk = &chunks_[slot / CHUNK_SLOTS];
+        if (growth_left_ == 0 && chunk->ctrl[slot % CHUNK_SLOTS] == CTRL_EMPTY)
+        {
+            rehash(size_ * 2 >= max_load(num_chunks_) ? num_chunks_ * 2 : num_chunks_);
+            slot = find_insert_slot(hash);
+            chunk = &chunks_[slot / CHUNK_SLOTS];
+        }
+
+        size_t i = slot % CHUNK_SLOTS;
+        if (chunk->ctrl[i] == CTRL_EMPTY)
+        {
+            growth_left_--;
+        }
+        store_page(&chunk->pages[i], page.get());
+        store_ctrl(&chunk->ctrl[i], h2_of(hash));
+        owners_[slot] = std::move(page);
+        size_++;
+        return true;
+    }
+
+    std::shared_ptr<Page> FlatPageMap::erase(const PageKey &key)
+    {
+        size_t slot = find_slot(key, hash_page_key(key));
+        if (slot == SIZE_MAX)
+        {
+            return nullptr;
+        }
+
+        Chunk *chunk = &chunks_[slot / CHUNK_SLOTS];
+        size_t i = slot % CHUNK_SLOTS;
+        store_page(&chunk->pages[i], nullptr);
+        size_--;
+
+        // A probe only moves past a chunk that was completely full when the key
+        // was placed, and chunks never regain empty bytes outside a rehash, so
+        // an empty byte here means no probe ever ran through this chunk and the
+        // slot can go straight back to empty.
+        if (Group(chunk->ctrl).match_empty())
+        {
+            store_ctrl(&chunk->ctrl[i], CTRL_EMPTY);
+            growth_left_++;
+        }
+        else
+        {
+            store_ctrl(&chunk->ctrl[i], CTRL_DELETED);
+        }
+        return std::move(owners_[slot]);
+    }
+
+    void FlatPageMap::reserve(size_t expected_size)
+    {
+        size_t chunks = chunks_for(expected_size);
+        if (chunks > num_chunks_)
+        {
+            rehash(chunks);
+        }
+    }
+
+    void FlatPageMap::clear()
+    {
+        release(true);
+    }
+
+    size_t FlatPageMap::find_slot(const PageKey &key, uint64_t hash) const
+    {
+        if (num_chunks_ == 0)
+        {
+            return SIZE_MAX;
+        }
+
+        size_t chunk_mask = num_chunks_ - 1;
+        size_t c = h1_of(hash) & chunk_mask;
+        int8_t h2 = h2_of(hash);
+
+        for (size_t probe = 1;; ++probe)
+        {
+            const Chunk &chunk = chunks_[c];
+            Group g(chunk.ctrl);
+
+            for (uint32_t mask = g.match(h2); mask; mask &= mask - 1)
+            {
+                unsigned i = lowest_bit(mask);
+                if (key_of(*chunk.pages[i]) == key)
+                {
+                    return c * CHUNK_SLOTS + i;
+                }
+            }
+
+            if (g.match_empty() || probe > chunk_mask)
+            {
+                return SIZE_MAX;
+            }
+            c = (c + probe) & chunk_mask;
+        }
+    }
+
+    size_t FlatPageMap::find_insert_slot(uint64_t hash) const
+    {
+        size_t chunk_mask = num_chunks_ - 1;
+        size_t c = h1_of(hash) & chunk_mask;
+
+        for (size_t probe = 1;; ++probe)
+        {
+            uint32_t mask = Group(chunks_[c].ctrl).match_empty_or_deleted();
+            if (mask)
+            {
+                return c * CHUNK_SLOTS + lowest_bit(mask);
+            }
+            c = (c + probe) & chunk_mask;
+        }
+    }
+
+    void FlatPageMap::rehash(size_t new_chunks)
+    {
+        Chunk *old_chunks = chunks_;
+        std::shared_ptr<Page> *old_owners = owners_;
+        Table *old_table = table_.load(std::memory_order_relaxed);
+        size_t old_num_chunks = num_chunks_;
+
+        chunks_ = nullptr;
+        owners_ = nullptr;
+        allocate(new_chunks);
+
+        for (size_t c = 0; c < old_num_chunks; ++c)
+        {
+            for (size_t i = 0; i < CHUNK_SLOTS; ++i)
+            {
+                if (old_chunks[c].ctrl[i] < 0)
+                {
+                    continue;
+                }
+
+                Page *page = old_chunks[c].pages[i];
+                uint64_t hash = hash_page_key(key_of(*page));
+                size_t slot = find_insert_slot(hash);
+                Chunk &chunk = chunks_[slot / CHUNK_SLOTS];
+                chunk.ctrl[slot % CHUNK_SLOTS] = h2_of(hash);
+                chunk.pages[slot % CHUNK_SLOTS] = page;
+                owners_[slot] = std::move(old_owners[c * CHUNK_SLOTS + i]);
+                size_++;
+                growth_left_--;
+            }
+        }
+
+        delete[] old_owners;
+        publish();
+        if (old_table)
+        {
+            EpochDomain::global().retire(old_table);
+        }
+    }
+
+    void FlatPageMap::allocate(size_t num_chunks)
+    {
+        chunks_ = new Chunk[num_chunks];
+        for (size_t c = 0; c < num_chunks; ++c)
+        {
+            std::memset(chunks_[c].ctrl, (uint8_t)CTRL_EMPTY, CHUNK_SLOTS);
+            std::memset(chunks_[c].ctrl + CHUNK_SLOTS, (uint8_t)CTRL_UNUSED, 16 - CHUNK_SLOTS);
+            std::memset(chunks_[c].pages, 0, sizeof(chunks_[c].pages));
+        }
+        owners_ = new std::shared_ptr<Page>[num_chunks * CHUNK_SLOTS];
+        num_chunks_ = num_chunks;
+        size_ = 0;
+        growth_left_ = max_load(num_chunks);
+    }
+
+    // The published table owns the chunk array from here on.
+    void FlatPageMap::publish()
+    {
+        table_.store(new Table{chunks_, num_chunks_}, std::memory_order_release);
+    }
+
+    void FlatPageMap::release(bool retire)
+    {
+        delete[] owners_;
+        Table *table = table_.exchange(nullptr, std::memory_order_acq_rel);
+        if (retire && table)
+        {
+            EpochDomain::global().retire(table);
+        }
+        else
+        {
+            delete table;
+        }
+        chunks_ = nullptr;
+        owners_ = nullptr;
+        num_chunks_ = 0;
+        size_ = 0;
+        growth_left_ = 0;
+    }
+
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "Page.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace pagecache
+{
+
+    struct PageKey
+    {
+        uint64_t file_id;
+        uint64_t page_index;
+
+        bool operator==(const PageKey &other) const
+        {
+            return file_id == other.file_id && page_index == other.page_index;
+        }
+    };
+
+    inline uint64_t hash_page_key(const PageKey &key)
+    {
+        __uint128_t product = (__uint128_t)(key.page_index ^ 0xa0761d6478bd642fULL) *
+                              (key.file_id ^ 0xe7037ed1a0b428dbULL);
+        return (uint64_t)product ^ (uint64_t)(product >> 64);
+    }
+
+    struct PageKeyHash
+    {
+        size_t operator()(const PageKey &key) const { return hash_page_key(key); }
+    };
+
+    // Open-addressing hash table of cached pages keyed by their own
+    // (file_id, page_index), in the Swiss/F14 style: slots are grouped into
+    // 128-byte chunks of 14, each chunk starting with one control byte per slot
+    // (7 bits of hash, or empty/deleted) that is matched sixteen bytes at a
+    // time with SSE2 where available. Chunks hold raw page pointers and keys
+    // are compared through the page, so a hit reads one chunk and the page it
+    // was going to use anyway. The owning references live in a parallel array
+    // that only insert and erase touch.
+    class FlatPageMap
+    {
+    public:
+        static constexpr size_t CHUNK_SLOTS = 14;
+
+        explicit FlatPageMap(size_t expected_size = 0);
+        ~FlatPageMap();
+
+        FlatPageMap(const FlatPageMap &) = delete;
+        FlatPageMap &operator=(const FlatPageMap &) = delete;
+
+        Page *find(const PageKey &key) const;
+
+        // Lookup that may run concurrently with the (externally serialised)
+        // writers, from inside an EpochDomain guard: replaced tables are
+        // retired to the global domain rather than freed. It can miss a key
+        // that is being inserted, and can return a page that was erased a
+        // moment ago; callers confirm under their lock when that matters.
+        Page *find_concurrent(const PageKey &key) const;
+
+        // Indexes the page under its file_id()/index(). Returns true when the
+        // key was newly inserted, false when an existing page was replaced.
+        bool insert_or_assign(std::shared_ptr<Page> page);
+
+        // Returns the owning reference of the removed page, or null.
+        std::shared_ptr<Page> erase(const PageKey &key);
+
+        void reserve(size_t expected_size);
+        void clear();
+
+        size_t size() const { return size_; }
+        size_t capacity() const { return num_chunks_ * CHUNK_SLOTS; }
+        bool empty() const { return size_ == 0; }
+
+        template <typename Fn>
+        void for_each(Fn fn) const
+        {
+            for (size_t c = 0; c < num_chunks_; ++c)
+            {
+                for (size_t i = 0; i < CHUNK_SLOTS; ++i)
+                {
+                    if (chunks_[c].ctrl[i] >= 0)
+                    {
+                        fn(chunks_[c].pages[i]);
+                    }
+                }
+            }
+        }
+
+    private:
+        struct alignas(64) Chunk
+        {
+            int8_t ctrl[16];
+            Page *pages[CHUNK_SLOTS];
+        };
+
+        // What concurrent readers see: a chunk array together with its size,
+        // published as one pointer so a resize can never be observed torn.
+        struct Table
+        {
+            Chunk *chunks;
+            size_t num_chunks;
+
+            ~Table() { delete[] chunks; }
+        };
+
+        Chunk *chunks_;
+        std::shared_ptr<Page> *owners_;
+        std::atomic<Table *> table_;
+        size_t num_chunks_;
+        size_t size_;
+        size_t growth_left_;
+
+        size_t find_slot(const PageKey &key, uint64_t hash) const;
+        size_t find_insert_slot(uint64_t hash) const;
+        void rehash(size_t new_chunks);
+        void allocate(size_t num_chunks);
+        void publish();
+        void release(bool retire);
+    };
+
+}
@@ -0,0 +1,166 @@
+#include "FrequencySketch.h"
+#include <algorithm>
+
+namespace pagecache
+{
+
+    namespace
+    {
+        constexpr size_t COUNTERS_PER_WORD = 16;
+        constexpr uint64_t HALVE_MASK = 0x7777777777777777ULL;
+
+        size_t round_up_pow2(size_t n)
+        {
+            size_t p = 1;
+            while (p < n)
+            {
+                p <<= 1;
+            }
+            return p;
+        }
+
+        // Second, independent hash for double hashing. The cache shards by
+        // the top bits of hash_page_key, so within one shard only the low
+        // bits of the primary hash vary.
+        inline uint64_t rehash(uint64_t hash)
+        {
+            hash ^= hash >> 33;
+            hash *= 0xff51afd7ed558ccdULL;
+            hash ^= hash >> 33;
+            return hash | 1;
+        }
+    }
+
+    FrequencySketch::FrequencySketch(size_t capacity)
+        : additions_(0), door_additions_(0)
+    {
+        size_t counters = round_up_pow2(std::max<size_t>(capacity * 2, 64));
+        size_t door_bits = round_up_pow2(std::max<size_t>(capacity * 16, 64));
+
+        counter_mask_ = counters - 1;
+        door_mask_ = door_bits - 1;
+        sample_size_ = std::max<size_t>(capacity, 1) * 10;
+        door_limit_ = std::max<size_t>(capacity, 1) * 4;
+
+        counters_.reset(new std::atomic<uint64_t>[counters / COUNTERS_PER_WORD]());
+        doorkeeper_.reset(new std::atomic<uint64_t>[door_bits / 64]());
+    }
+
+    void FrequencySketch::record(const PageKey &key)
+    {
+        uint64_t hash = hash_page_key(key);
+
+        if (!door_contains(hash))
+        {
+            // Exactly one thread sees the count reach the limit and clears.
+            if (door_additions_.fetch_add(1, std::memory_order_relaxed) == door_limit_)
+            {
+                clear_doorkeeper();
+                door_additions_.fetch_sub(door_limit_, std::memory_order_relaxed);
+            }
+            for (size_t i = 0; i < DOOR_HASHES; ++i)
+            {
+                size_t bit = door_bit(hash, i);
+                doorkeeper_[bit / 64].fetch_or(uint64_t(1) << (bit % 64), std::memory_order_relaxed);
+            }
+        }
+        else
+        {
+            // Conservative update: only the counters at the current minimum
+            // are raised, which keeps collisions from inflating estimates.
+            size_t slots[HASHES];
+            uint32_t min_count = MAX_COUNT;
+            for (size_t i = 0; i < HASHES; ++i)
+            {
+                slots[i] = counter_slot(hash, i);
+                min_count = std::min(min_count, counter(slots[i]));
+            }
+
+            if (min_count < MAX_COUNT)
+            {
+                for (size_t i = 0; i < HASHES; ++i)
+                {
+                    std::atomic<uint64_t> &word = counters_[slots[i] / COUNTERS_PER_WORD];
+                    unsigned shift = (slots[i] % COUNTERS_PER_WORD) * 4;
+                    uint64_t value = word.load(std::memory_order_relaxed);
+                    while (((value >> shift) & 0xf) == min_count &&
+                           !word.compare_exchange_weak(value, value + (uint64_t(1) << shift),
+                                                       std::memory_order_relaxed))
+                    {
+                    }
+                }
+            }
+        }
+
+        if (additions_.fetch_add(1, std::memory_order_relaxed) + 1 == sample_size_)
+        {
+            age();
+        }
+    }
+
+    uint32_t FrequencySketch::frequency(const PageKey &key) const
+    {
+        uint64_t hash = hash_page_key(key);
+
+        uint32_t min_count = MAX_COUNT;
+        for (size_t i = 0; i < HASHES; ++i)
+        {
+            min_count = std::min(min_count, counter(counter_slot(hash, i)));
+        }
+        return min_count + (door_contains(hash) ? 1 : 0);
+    }
+
+    uint32_t FrequencySketch::counter(size_t slot) const
+    {
+        uint64_t word = counters_[slot / COUNTERS_PER_WORD].load(std::memory_order_relaxed);
+        return (uint32_t)(word >> ((slot % COUNTERS_PER_WORD) * 4)) & 0xf;
+    }
+
+    size_t FrequencySketch::counter_slot(uint64_t hash, size_t i) const
+    {
+        return (size_t)(hash + i * rehash(hash)) & counter_mask_;
+    }
+
+    size_t FrequencySketch::door_bit(uint64_t hash, size_t i) const
+    {
+        uint64_t h2 = rehash(hash);
+        return (size_t)((h2 >> 16) + i * hash) & door_mask_;
+    }
+
+    bool FrequencySketch::door_contains(uint64_t hash) const
+    {
+        for (size_t i = 0; i < DOOR_HASHES; ++i)
+        {
+            size_t bit = door_bit(hash, i);
+            if (!(doorkeeper_[bit / 64].load(std::memory_order_relaxed) & (uint64_t(1) << (bit % 64))))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void FrequencySketch::age()
+    {
+        size_t words = (counter_mask_ + 1) / COUNTERS_PER_WORD;
+        for (size_t w = 0; w < words; ++w)
+        {
+            uint64_t value = counters_[w].load(std::memory_order_relaxed);
+            while (!counters_[w].compare_exchange_weak(value, (value >> 1) & HALVE_MASK,
+                                                       std::memory_order_relaxed))
+            {
+            }
+        }
+        additions_.fetch_sub(sample_size_ / 2, std::memory_order_relaxed);
+    }
+
+    void FrequencySketch::clear_doorkeeper()
+    {
+        size_t words = (door_mask_ + 1) / 64;
+        for (size_t w = 0; w < words; ++w)
+        {
+            doorkeeper_[w].store(0, std::memory_order_relaxed);
+        }
+    }
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "FlatPageMap.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace pagecache
+{
+
+    // Approximate access frequency for TinyLFU admission (Einziger et al.,
+    // "TinyLFU: A Highly Efficient Cache Admission Policy"). A count-min
+    // sketch of 4-bit counters, sixteen to a word, sits behind a doorkeeper
+    // bloom filter that absorbs the first access of every key, so one-hit
+    // wonders never reach the counters. After a sample of 10x capacity
+    // accesses every counter is halved, which lets the estimate follow a
+    // shifting working set; the doorkeeper is cleared whenever it has taken
+    // 4x capacity new keys, before its false-positive rate climbs. Two
+    // counters and sixteen doorkeeper bits per cached page come to three
+    // bytes of metadata per 4KB page. record() is lock-free so cache hits
+    // can count without the shard lock; concurrent updates may lose the odd
+    // increment, which an estimate can afford.
+    class FrequencySketch
+    {
+    public:
+        static constexpr uint32_t MAX_COUNT = 15;
+
+        explicit FrequencySketch(size_t capacity);
+
+        FrequencySketch(const FrequencySketch &) = delete;
+        FrequencySketch &operator=(const FrequencySketch &) = delete;
+
+        void record(const PageKey &key);
+        uint32_t frequency(const PageKey &key) const;
+
+        size_t sample_size() const { return sample_size_; }
+        size_t additions() const { return additions_.load(std::memory_order_relaxed); }
+
+    private:
+        static constexpr size_t HASHES = 4;
+        static constexpr size_t DOOR_HASHES = 2;
+
+        size_t counter_mask_;
+        size_t door_mask_;
+        size_t sample_size_;
+        size_t door_limit_;
+        std::atomic<size_t> additions_;
+        std::atomic<size_t> door_additions_;
+        std::unique_ptr<std::atomic<uint64_t>[]> counters_;
+        std::unique_ptr<std::atomic<uint64_t>[]> doorkeeper_;
+
+        uint32_t counter(size_t slot) const;
+        size_t counter_slot(uint64_t hash, size_t i) const;
+        size_t door_bit(uint64_t hash, size_t i) const;
+        bool door_contains(uint64_t hash) const;
+        void age();
+        void clear_doorkeeper();
+    };
+
+}
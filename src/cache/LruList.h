@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Page.h"
+#include <cstddef>
+
+namespace pagecache
+{
+
+    // Intrusive doubly-linked list threaded through Page::lru_prev_/lru_next_.
+    // Front is the least recently used page, back the most recent. A page can
+    // be linked into at most one list at a time; the list does not own it.
+    class LruList
+    {
+    public:
+        LruList() : head_(nullptr), tail_(nullptr), size_(0) {}
+
+        LruList(const LruList &) = delete;
+        LruList &operator=(const LruList &) = delete;
+
+        Page *front() const { return head_; }
+        Page *back() const { return tail_; }
+        static Page *next(const Page *page) { return page->lru_next_; }
+        static Page *prev(const Page *page) { return page->lru_prev_; }
+
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+
+        void push_back(Page *page)
+        {
+            page->lru_prev_ = tail_;
+            page->lru_next_ = nullptr;
+            if (tail_)
+            {
+                tail_->lru_next_ = page;
+            }
+            else
+            {
+                head_ = page;
+            }
+            tail_ = page;
+            size_++;
+        }
+
+        void remove(Page *page)
+        {
+            if (page->lru_prev_)
+            {
+                page->lru_prev_->lru_next_ = page->lru_next_;
+            }
+            else
+            {
+                head_ = page->lru_next_;
+            }
+
+            if (page->lru_next_)
+            {
+                page->lru_next_->lru_prev_ = page->lru_prev_;
+            }
+            else
+            {
+                tail_ = page->lru_prev_;
+            }
+
+            page->lru_prev_ = nullptr;
+            page->lru_next_ = nullptr;
+            size_--;
+        }
+
+        void move_to_back(Page *page)
+        {
+            if (page == tail_)
+            {
+                return;
+            }
+            remove(page);
+            push_back(page);
+        }
+
+    private:
+        Page *head_;
+        Page *tail_;
+        size_t size_;
+    };
+
+}
@@ -1,20 +1,135 @@
 #include "Page.h"
+#include "PageFramePool.h"
+#include <condition_variable>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
 
 namespace pagecache
 {
 
+    namespace
+    {
+        // Pages under I/O are rare and short-lived, so rather than carrying a
+        // condition variable each, waiters sleep on a small table of queues
+        // hashed by page address, as the kernel does for page locks.
+        // Waiters that must not block leave a callback instead.
+        struct alignas(64) WaitQueue
+        {
+            std::mutex lock;
+            std::condition_variable cond;
+            std::vector<std::pair<const Page *, std::function<void()>>> callbacks;
+        };
+
+        constexpr size_t WAIT_QUEUES = 64;
+
+        WaitQueue &wait_queue_for(const Page *page)
+        {
+            static WaitQueue queues[WAIT_QUEUES];
+            return queues[std::hash<const Page *>()(page) / alignof(Page) % WAIT_QUEUES];
+        }
+    }
+
     Page::Page(uint64_t page_index)
-        : index_(page_index),
-          data_(new uint8_t[PAGE_SIZE]),
+        : Page(0, page_index)
+    {
+    }
+
+    Page::Page(uint64_t file_id, uint64_t page_index, std::shared_ptr<PageFramePool> pool)
+        : file_id_(file_id),
+          index_(page_index),
+          data_(pool ? pool->allocate() : nullptr),
+          pool_(data_ ? std::move(pool) : nullptr),
           state_(PageState::Clean),
           refcount_(0),
           last_accessed_(next_timestamp()),
-          locked_(false)
+          locked_(false),
+          io_state_(IO_DONE),
+          referenced_(false),
+          lru_prev_(nullptr),
+          lru_next_(nullptr),
+          policy_list_(0),
+          policy_slot_(0),
+          file_stats_(nullptr)
     {
+        if (!data_)
+        {
+            data_ = static_cast<uint8_t *>(std::aligned_alloc(PAGE_SIZE, PAGE_SIZE));
+            if (!data_)
+            {
+                throw std::bad_alloc();
+            }
+        }
     }
 
     Page::~Page()
     {
+        if (pool_)
+        {
+            pool_->release(data_);
+        }
+        else
+        {
+            std::free(data_);
+        }
+    }
+
+    void Page::end_io(bool success)
+    {
+        WaitQueue &queue = wait_queue_for(this);
+        std::vector<std::function<void()>> wakes;
+        {
+            // Taking the queue lock orders the store against a waiter that
+            // has checked the state but not yet gone to sleep.
+            std::lock_guard<std::mutex> lock(queue.lock);
+            io_state_.store(success ? IO_DONE : IO_ERROR, std::memory_order_release);
+            auto it = queue.callbacks.begin();
+            while (it != queue.callbacks.end())
+            {
+                if (it->first == this)
+                {
+                    wakes.push_back(std::move(it->second));
+                    *it = std::move(queue.callbacks.back());
+                    queue.callbacks.pop_back();
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+        queue.cond.notify_all();
+        for (auto &wake : wakes)
+        {
+            wake();
+        }
+    }
+
+    bool Page::wait_io() const
+    {
+        if (under_io())
+        {
+            WaitQueue &queue = wait_queue_for(this);
+            std::unique_lock<std::mutex> lock(queue.lock);
+            queue.cond.wait(lock, [this]
+                            { return !under_io(); });
+        }
+        return !io_error();
+    }
+
+    bool Page::wait_io_async(std::function<void()> wake) const
+    {
+        WaitQueue &queue = wait_queue_for(this);
+        std::lock_guard<std::mutex> lock(queue.lock);
+        if (!under_io())
+        {
+            return false;
+        }
+        queue.callbacks.emplace_back(this, std::move(wake));
+        return true;
     }
 
 }
@@ -3,6 +3,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <atomic>
+#include <functional>
 #include <memory>
 
 namespace pagecache {
@@ -10,30 +11,76 @@ namespace pagecache {
 enum class PageState {
     Clean,
     Dirty,
-    Locked
+    Locked,
+    // Being written back; a write in the meantime turns it Dirty again.
+    Writeback
 };
 
-class Page {
+class LruList;
+class PageCache;
+struct FilePageStats;
+class PageFramePool;
+class ReplacementPolicy;
+
+class Page : public std::enable_shared_from_this<Page> {
 public:
     static constexpr size_t PAGE_SIZE = 4096;
 
     Page(uint64_t page_index);
+    Page(uint64_t file_id, uint64_t page_index,
+         std::shared_ptr<PageFramePool> pool = nullptr);
     ~Page();
 
+    Page(const Page&) = delete;
+    Page& operator=(const Page&) = delete;
+
+    uint64_t file_id() const { return file_id_; }
     uint64_t index() const { return index_; }
-    uint8_t* data() { return data_.get(); }
-    const uint8_t* data() const { return data_.get(); }
+    uint8_t* data() { return data_; }
+    const uint8_t* data() const { return data_; }
+    bool pooled() const { return pool_ != nullptr; }
     
-    PageState state() const { return state_; }
-    void set_state(PageState s) { state_ = s; }
+    PageState state() const { return state_.load(std::memory_order_relaxed); }
+    // Cached pages change state through PageCache::mark_dirty/mark_clean,
+    // which keep the cache's dirty counters in step.
+    void set_state(PageState s) { state_.store(s, std::memory_order_relaxed); }
     
-    uint32_t refcount() const { return refcount_.load(std::memory_order_acquire); }
+    // The top bit of the reference count marks a page that eviction has
+    // claimed. try_pin() fails once it is set, so a pin taken without the
+    // shard lock either lands before the claim or not at all.
+    static constexpr uint32_t EVICTING = 1u << 31;
+
+    uint32_t refcount() const { return refcount_.load(std::memory_order_acquire) & ~EVICTING; }
+    bool evicting() const { return refcount_.load(std::memory_order_acquire) & EVICTING; }
     void increment_refcount() { refcount_.fetch_add(1, std::memory_order_acq_rel); }
     void decrement_refcount() { refcount_.fetch_sub(1, std::memory_order_acq_rel); }
+
+    bool try_pin() {
+        uint32_t count = refcount_.load(std::memory_order_relaxed);
+        while (!(count & EVICTING)) {
+            if (refcount_.compare_exchange_weak(count, count + 1, std::memory_order_acquire,
+                                                std::memory_order_relaxed))
+                return true;
+        }
+        return false;
+    }
+    void unpin() { decrement_refcount(); }
     
     uint64_t last_accessed() const { return last_accessed_; }
     void touch() { last_accessed_ = next_timestamp(); }
     
+    // Set on every hit without any lock; cleared by the replacement policy
+    // when it next considers the page for eviction.
+    void mark_referenced() {
+        if (!referenced_.load(std::memory_order_relaxed))
+            referenced_.store(true, std::memory_order_relaxed);
+    }
+    bool referenced() const { return referenced_.load(std::memory_order_relaxed); }
+    // Returns whether the bit was set.
+    bool clear_referenced() {
+        return referenced() && referenced_.exchange(false, std::memory_order_relaxed);
+    }
+
     static uint64_t next_timestamp() { 
         static std::atomic<uint64_t> ts(0);
         return ts.fetch_add(1, std::memory_order_relaxed);
@@ -43,13 +90,49 @@ public:
     void unlock() { locked_ = false; }
     bool is_locked() const { return locked_; }
 
+    // A page indexed before its contents have been read in is under I/O
+    // until the loader calls end_io(). Other threads that find it sleep in
+    // wait_io() instead of issuing a read of their own.
+    bool under_io() const { return io_state_.load(std::memory_order_acquire) == IO_READING; }
+    bool io_error() const { return io_state_.load(std::memory_order_acquire) == IO_ERROR; }
+    void begin_io() { io_state_.store(IO_READING, std::memory_order_relaxed); }
+    void end_io(bool success);
+    // Returns false when the read failed.
+    bool wait_io() const;
+    // Arranges for wake to run on the thread that ends the page's I/O and
+    // returns true, or returns false at once if the page is not under I/O.
+    bool wait_io_async(std::function<void()> wake) const;
+
 private:
+    // Claims an unpinned page for eviction; only the shard owner calls these.
+    bool try_begin_evict() {
+        uint32_t expected = 0;
+        return refcount_.compare_exchange_strong(expected, EVICTING, std::memory_order_acq_rel);
+    }
+    void mark_evicting() { refcount_.fetch_or(EVICTING, std::memory_order_acq_rel); }
+    void clear_evicting() { refcount_.fetch_and(~EVICTING, std::memory_order_acq_rel); }
+
+    enum : uint8_t { IO_DONE, IO_READING, IO_ERROR };
+
+    friend class LruList;
+    friend class PageCache;
+    friend class ReplacementPolicy;
+
+    uint64_t file_id_;
     uint64_t index_;
-    std::unique_ptr<uint8_t[]> data_;
-    PageState state_;
+    uint8_t* data_;
+    std::shared_ptr<PageFramePool> pool_;
+    std::atomic<PageState> state_;
     std::atomic<uint32_t> refcount_;
     uint64_t last_accessed_;
-    bool locked_;
+    std::atomic<bool> locked_;
+    std::atomic<uint8_t> io_state_;
+    std::atomic<bool> referenced_;
+    Page* lru_prev_;
+    Page* lru_next_;
+    uint8_t policy_list_;
+    uint32_t policy_slot_;
+    FilePageStats* file_stats_;
 };
 
 }
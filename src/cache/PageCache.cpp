@@ -1,246 +1,818 @@
 #include "PageCache.h"
 #include <algorithm>
+#include <future>
+#include <thread>
 
 namespace pagecache
 {
 
-    PageCache::PageCache(size_t max_pages)
-        : max_pages_(max_pages), eviction_policy_("lru")
+    namespace
     {
+        // Pages under writeback still hold data the file does not have yet.
+        inline bool counts_as_dirty(PageState state)
+        {
+            return state == PageState::Dirty || state == PageState::Writeback;
+        }
+
+        size_t round_up_pow2(size_t n)
+        {
+            size_t p = 1;
+            while (p < n)
+            {
+                p <<= 1;
+            }
+            return p;
+        }
+
+        size_t pick_shard_count(size_t max_pages, size_t requested)
+        {
+            size_t shards = requested;
+            if (shards == 0)
+            {
+                shards = std::max<size_t>(1, std::thread::hardware_concurrency()) * 4;
+            }
+            shards = round_up_pow2(shards);
+
+            size_t limit = std::max<size_t>(1, max_pages / PageCache::MIN_PAGES_PER_SHARD);
+            while (shards > 1 && shards > limit)
+            {
+                shards >>= 1;
+            }
+            return shards;
+        }
+
+        size_t log2_of(size_t pow2)
+        {
+            size_t bits = 0;
+            while ((size_t(1) << bits) < pow2)
+            {
+                bits++;
+            }
+            return bits;
+        }
+    }
+
+    PageCache::PageCache(size_t max_pages, size_t num_shards)
+        : max_pages_(max_pages),
+          num_shards_(pick_shard_count(max_pages, num_shards)),
+          shard_shift_(64 - log2_of(num_shards_)),
+          shards_(new Shard[num_shards_]),
+          frame_pool_(std::make_shared<PageFramePool>(max_pages + RETIRED_FRAME_SLACK)),
+          counters_(std::make_shared<Counters>()),
+          eviction_policy_(EvictionPolicy::LRU),
+          admission_filter_(false),
+          reclaim_cursor_(0),
+          resident_pages_(0),
+          dirty_pages_(0)
+    {
+        size_t base = max_pages_ / num_shards_;
+        size_t extra = max_pages_ % num_shards_;
+        for (size_t i = 0; i < num_shards_; ++i)
+        {
+            shards_[i].capacity = std::max<size_t>(1, base + (i < extra ? 1 : 0));
+            shards_[i].index.reserve(shards_[i].capacity);
+            install_policy(shards_[i], EvictionPolicy::LRU, false);
+        }
     }
 
     PageCache::~PageCache()
     {
+        // Pages can outlive the cache; drop their pointers into file_stats_.
+        for (size_t i = 0; i < num_shards_; ++i)
+        {
+            shards_[i].index.for_each([](Page *page)
+                                      { page->file_stats_ = nullptr; });
+        }
+
+        // Evicted pages and old policies wait in the epoch domain; release
+        // them now so their frames go back before the pool does.
+        EpochDomain::global().synchronize();
     }
 
     std::shared_ptr<Page> PageCache::get_or_load(uint64_t file_id, uint64_t page_index,
                                                  std::function<bool(uint8_t *)> loader)
     {
-        pthread_mutex_lock(&cache_lock_);
+        Shard &shard = shard_for(file_id, page_index);
+        const PageKey key{file_id, page_index};
 
-        if (pages_by_file_[file_id].find(page_index) != pages_by_file_[file_id].end())
+        if (auto page = find_lock_free(shard, key, true))
         {
-            auto &entry = pages_by_file_[file_id][page_index];
-            entry.page->touch();
-            update_lru(file_id, page_index);
-            return entry.page;
+            return page->wait_io() ? page : nullptr;
         }
 
-        while (total_pages() >= max_pages_)
+        std::unique_lock<std::mutex> lock(shard.lock);
+        if (Page *page = shard.index.find(key))
         {
-            evict_one();
+            shard.policy->on_access(page);
+            auto found = page->shared_from_this();
+            lock.unlock();
+            return found->wait_io() ? found : nullptr;
         }
 
-        auto new_page = std::make_shared<Page>(page_index);
-        new_page->lock();
-
+        auto new_page = begin_load(shard, key);
         lock.unlock();
+
         bool success = loader(new_page->data());
-        lock.lock();
+        end_load(shard, new_page, success);
+        new_page->unpin();
 
-        if (!success)
-        {
-            return nullptr;
-        }
+        return success ? new_page : nullptr;
+    }
 
-        new_page->unlock();
-        new_page->set_state(PageState::Clean);
-        new_page->touch();
+    std::shared_ptr<Page> PageCache::get_page(uint64_t file_id, uint64_t page_index)
+    {
+        Shard &shard = shard_for(file_id, page_index);
+        const PageKey key{file_id, page_index};
 
-        pages_by_file_[file_id][page_index] = {new_page, file_id};
-        lru_queue_.push_back({file_id, page_index});
+        std::shared_ptr<Page> page = find_lock_free(shard, key, false);
+        if (!page)
+        {
+            std::lock_guard<std::mutex> lock(shard.lock);
+            if (Page *found = shard.index.find(key))
+            {
+                page = found->shared_from_this();
+            }
+        }
+        return page && page->wait_io() ? page : nullptr;
+    }
 
-        return new_page;
+    PageRef PageCache::pin_or_load(uint64_t file_id, uint64_t page_index,
+                                   std::function<bool(uint8_t *)> loader)
+    {
+        for (;;)
+        {
+            auto page = get_or_load(file_id, page_index, loader);
+            if (!page)
+            {
+                return PageRef();
+            }
+            if (page->try_pin())
+            {
+                return PageRef(std::move(page));
+            }
+            // Claimed by eviction between the lookup and the pin.
+        }
     }
 
-    std::shared_ptr<Page> PageCache::get_page(uint64_t file_id, uint64_t page_index)
+    std::vector<PageRef> PageCache::get_or_load_range(uint64_t file_id, uint64_t first_page, size_t count,
+                                                      const RangeLoader &loader)
     {
-        std::lock_guard<std::mutex> lock(cache_lock_);
+        return get_or_load_range(file_id, first_page, count, BatchLoader([&loader](std::vector<LoadRun> &runs)
+                                                                          {
+            for (LoadRun &run : runs)
+            {
+                run.complete(loader(run.first_page, run.frames.data(), run.frames.size()));
+            } }));
+    }
 
-        if (pages_by_file_.find(file_id) == pages_by_file_.end())
+    std::vector<PageRef> PageCache::get_or_load_range(uint64_t file_id, uint64_t first_page, size_t count,
+                                                      const BatchLoader &loader)
+    {
+        std::vector<std::shared_ptr<Page>> pages;
+        // Pages indexed by this call, which it must load; they come back
+        // from begin_load() already pinned.
+        std::vector<bool> owned;
+        start_range_load(file_id, first_page, count, loader, true, pages, owned);
+
+        std::vector<PageRef> refs;
+        refs.reserve(count);
+        for (size_t i = 0; i < count; ++i)
         {
-            return nullptr;
+            if (owned[i])
+            {
+                if (!pages[i]->wait_io())
+                {
+                    break;
+                }
+                refs.emplace_back(std::move(pages[i]));
+                continue;
+            }
+
+            if (pages[i]->wait_io() && pages[i]->try_pin())
+            {
+                refs.emplace_back(std::move(pages[i]));
+                continue;
+            }
+
+            // Failed or evicted by someone else since the lookup: fall back
+            // to loading just this page.
+            uint64_t page_index = first_page + i;
+            auto load_one = [&loader, page_index](uint8_t *data)
+            {
+                std::promise<bool> loaded;
+                std::vector<LoadRun> runs(1);
+                runs[0].first_page = page_index;
+                runs[0].frames.push_back(data);
+                runs[0].complete = [&loaded](size_t n)
+                { loaded.set_value(n == 1); };
+                loader(runs);
+                return loaded.get_future().get();
+            };
+            PageRef ref = pin_or_load(file_id, page_index, load_one);
+            if (!ref)
+            {
+                break;
+            }
+            refs.push_back(std::move(ref));
         }
 
-        auto &file_cache = pages_by_file_[file_id];
-        if (file_cache.find(page_index) == file_cache.end())
+        // Drop the load pins of pages past a failure.
+        for (size_t i = refs.size(); i < count; ++i)
         {
-            return nullptr;
+            if (owned[i] && pages[i])
+            {
+                pages[i]->unpin();
+            }
         }
 
-        return file_cache[page_index].page;
+        return refs;
     }
 
-    void PageCache::insert_page(uint64_t file_id, uint64_t page_index, std::shared_ptr<Page> page)
+    size_t PageCache::prefetch_range(uint64_t file_id, uint64_t first_page, size_t count,
+                                     const BatchLoader &loader)
     {
-        std::lock_guard<std::mutex> lock(cache_lock_);
-
-        pages_by_file_[file_id][page_index] = {page, file_id};
-        lru_queue_.push_back({file_id, page_index});
+        std::vector<std::shared_ptr<Page>> pages;
+        std::vector<bool> owned;
+        start_range_load(file_id, first_page, count, loader, false, pages, owned);
+        return std::count(owned.begin(), owned.end(), true);
     }
 
-    size_t PageCache::total_pages() const
+    std::shared_ptr<Page> PageCache::load_range_async(uint64_t file_id, uint64_t first_page, size_t count,
+                                                      const BatchLoader &loader)
     {
-        std::lock_guard<std::mutex> lock(cache_lock_);
-        size_t count = 0;
-        for (const auto &file_entry : pages_by_file_)
+        std::vector<std::shared_ptr<Page>> pages;
+        std::vector<bool> owned;
+        start_range_load(file_id, first_page, count, loader, false, pages, owned);
+        for (std::shared_ptr<Page> &page : pages)
         {
-            count += file_entry.second.size();
+            if (page && page->under_io())
+            {
+                return std::move(page);
+            }
         }
-        return count;
+        return nullptr;
     }
 
-    size_t PageCache::dirty_pages() const
+    bool PageCache::contains(uint64_t file_id, uint64_t page_index)
     {
-        std::lock_guard<std::mutex> lock(cache_lock_);
-        size_t count = 0;
-        for (const auto &file_entry : pages_by_file_)
+        return find_lock_free(shard_for(file_id, page_index), {file_id, page_index}, false) != nullptr;
+    }
+
+    bool PageCache::loading(uint64_t file_id, uint64_t page_index)
+    {
+        std::shared_ptr<Page> page = find_lock_free(shard_for(file_id, page_index), {file_id, page_index}, false);
+        return page && page->under_io();
+    }
+
+    // Looks up pages [first_page, first_page + count) into pages, indexing
+    // a pinned placeholder for each miss (marked in owned), and hands the
+    // runs of placeholders to loader. Without keep_pins a run's completion
+    // drops its placeholders' pins, for callers that do not wait.
+    void PageCache::start_range_load(uint64_t file_id, uint64_t first_page, size_t count,
+                                     const BatchLoader &loader, bool keep_pins,
+                                     std::vector<std::shared_ptr<Page>> &pages, std::vector<bool> &owned)
+    {
+        pages.assign(count, nullptr);
+        owned.assign(count, false);
+        std::vector<size_t> misses;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const PageKey key{file_id, first_page + i};
+            pages[i] = find_lock_free(shard_for(key.file_id, key.page_index), key, keep_pins);
+            if (!pages[i])
+            {
+                misses.push_back(i);
+            }
+        }
+
+        // Group the misses by shard so each shard lock is taken once.
+        std::sort(misses.begin(), misses.end(), [&](size_t a, size_t b)
+                  {
+            Shard *sa = &shard_for(file_id, first_page + a);
+            Shard *sb = &shard_for(file_id, first_page + b);
+            return sa != sb ? sa < sb : a < b; });
+
+        for (size_t m = 0; m < misses.size();)
         {
-            for (const auto &page_entry : file_entry.second)
+            Shard &shard = shard_for(file_id, first_page + misses[m]);
+            std::lock_guard<std::mutex> lock(shard.lock);
+            for (; m < misses.size() && &shard_for(file_id, first_page + misses[m]) == &shard; ++m)
             {
-                if (page_entry.second.page->state() == PageState::Dirty)
+                size_t i = misses[m];
+                const PageKey key{file_id, first_page + i};
+                if (Page *page = shard.index.find(key))
+                {
+                    if (keep_pins)
+                    {
+                        shard.policy->on_access(page);
+                    }
+                    pages[i] = page->shared_from_this();
+                }
+                else
                 {
-                    count++;
+                    pages[i] = begin_load(shard, key);
+                    owned[i] = true;
                 }
             }
         }
-        return count;
+
+        std::vector<LoadRun> runs;
+        for (size_t i = 0; i < count;)
+        {
+            if (!owned[i])
+            {
+                ++i;
+                continue;
+            }
+
+            LoadRun run;
+            run.first_page = first_page + i;
+            std::vector<std::shared_ptr<Page>> run_pages;
+            for (; i < count && owned[i]; ++i)
+            {
+                run.frames.push_back(pages[i]->data());
+                run_pages.push_back(pages[i]);
+            }
+            run.complete = [this, run_pages, keep_pins](size_t loaded)
+            {
+                for (size_t j = 0; j < run_pages.size(); ++j)
+                {
+                    const Page *page = run_pages[j].get();
+                    end_load(shard_for(page->file_id(), page->index()), run_pages[j], j < loaded);
+                    if (!keep_pins)
+                    {
+                        run_pages[j]->unpin();
+                    }
+                }
+            };
+            runs.push_back(std::move(run));
+        }
+        if (!runs.empty())
+        {
+            loader(runs);
+        }
+    }
+
+    size_t PageCache::max_range_pages() const
+    {
+        // Leave most of the cache unpinned whatever the request size.
+        return std::max<size_t>(1, std::min(MAX_RANGE_PAGES, max_pages_ / 4));
+    }
+
+    void PageCache::insert_page(uint64_t file_id, uint64_t page_index, std::shared_ptr<Page> page)
+    {
+        Shard &shard = shard_for(file_id, page_index);
+        std::lock_guard<std::mutex> lock(shard.lock);
+
+        const PageKey key{file_id, page_index};
+        if (Page *existing = shard.index.find(key))
+        {
+            existing->mark_evicting();
+            shard.policy->on_remove(existing);
+            account_remove(existing);
+            retire(shard.index.erase(key));
+        }
+
+        page->clear_evicting();
+        page->file_id_ = file_id;
+        page->index_ = page_index;
+        shard.index.insert_or_assign(page);
+        shard.policy->on_insert(page.get());
+        account_insert(page.get());
+    }
+
+    bool PageCache::mark_dirty(const std::shared_ptr<Page> &page)
+    {
+        return set_page_state(page.get(), PageState::Dirty);
+    }
+
+    bool PageCache::mark_clean(const std::shared_ptr<Page> &page)
+    {
+        return set_page_state(page.get(), PageState::Clean);
     }
 
     size_t PageCache::clean_pages() const
     {
-        return total_pages() - dirty_pages();
+        size_t resident = total_pages();
+        size_t dirty = dirty_pages();
+        return resident > dirty ? resident - dirty : 0;
     }
 
-    void PageCache::set_eviction_policy(const std::string &policy)
+    size_t PageCache::file_resident_pages(uint64_t file_id) const
     {
-        std::lock_guard<std::mutex> lock(cache_lock_);
-        eviction_policy_ = policy;
+        const FilePageStats *stats = find_stats(file_id);
+        return stats ? stats->resident_pages.load(std::memory_order_relaxed) : 0;
     }
 
-    bool PageCache::evict_one()
+    size_t PageCache::file_dirty_pages(uint64_t file_id) const
     {
-        std::shared_ptr<Page> victim = nullptr;
+        const FilePageStats *stats = find_stats(file_id);
+        return stats ? stats->dirty_pages.load(std::memory_order_relaxed) : 0;
+    }
 
-        if (eviction_policy_ == "clock")
+    void PageCache::set_eviction_policy(const std::string &policy)
+    {
+        EvictionPolicy selected = EvictionPolicy::LRU;
+        if (policy == "clock")
         {
-            victim = evict_clock();
+            selected = EvictionPolicy::CLOCK;
         }
-        else
+        else if (policy == "arc")
         {
-            victim = evict_lru();
+            selected = EvictionPolicy::ARC;
         }
 
-        return victim != nullptr;
+        if (eviction_policy_.exchange(selected) == selected)
+        {
+            return;
+        }
+        reinstall_policies();
     }
 
-    void PageCache::evict_to_target(size_t target_pages)
+    void PageCache::set_admission_filter(bool enabled)
     {
-        std::lock_guard<std::mutex> lock(cache_lock_);
-
-        while (total_pages() > target_pages)
+        if (admission_filter_.exchange(enabled) == enabled)
         {
-            evict_one();
+            return;
         }
+        reinstall_policies();
     }
 
-    std::shared_ptr<Page> PageCache::evict_lru()
+    bool PageCache::evict_one()
     {
-        for (auto it = lru_queue_.begin(); it != lru_queue_.end(); ++it)
+        size_t start = reclaim_cursor_.fetch_add(1, std::memory_order_relaxed);
+
+        for (size_t i = 0; i < num_shards_; ++i)
         {
-            uint64_t file_id = it->first;
-            uint64_t page_index = it->second;
+            Shard &shard = shards_[(start + i) & (num_shards_ - 1)];
+            std::lock_guard<std::mutex> lock(shard.lock);
+            if (evict_from(shard))
+            {
+                return true;
+            }
+        }
 
-            auto &file_cache = pages_by_file_[file_id];
-            auto page_it = file_cache.find(page_index);
+        return false;
+    }
 
-            if (page_it == file_cache.end())
+    void PageCache::evict_to_target(size_t target_pages)
+    {
+        while (total_pages() > target_pages)
+        {
+            if (!evict_one())
             {
-                lru_queue_.erase(it);
-                continue;
+                break;
             }
+        }
+    }
+
+    PageCache::Shard &PageCache::shard_for(uint64_t file_id, uint64_t page_index) const
+    {
+        if (num_shards_ == 1)
+        {
+            return shards_[0];
+        }
+        return shards_[hash_page_key({file_id, page_index}) >> shard_shift_];
+    }
+
+    size_t PageCache::shard_pages(const Shard &shard) const
+    {
+        return shard.policy->size();
+    }
 
-            auto page = page_it->second.page;
+    bool PageCache::evict_from(Shard &shard)
+    {
+        LatencyHistogram::Clock::time_point start = LatencyHistogram::Clock::now();
+        Page *victim = shard.policy->select_victim();
+        while (victim && !victim->try_begin_evict())
+        {
+            // Pinned by a lock-free reader after it was picked.
+            victim = shard.policy->select_victim();
+        }
+        if (!victim)
+        {
+            return false;
+        }
+
+        shard.policy->on_evict(victim);
+        account_remove(victim);
+        retire(shard.index.erase({victim->file_id(), victim->index()}));
+        counters_->increment_evictions();
+        counters_->eviction_latency().record_since(start);
+        return true;
+    }
 
-            if (page->refcount() > 0 || page->is_locked())
+    // Indexes a pinned, locked placeholder for key, evicting to make room.
+    // The caller fills it with the shard lock dropped and then calls
+    // end_load(); until then other lookups of the key wait on the page.
+    std::shared_ptr<Page> PageCache::begin_load(Shard &shard, const PageKey &key)
+    {
+        shard.policy->on_miss(key);
+        while (shard_pages(shard) >= shard.capacity)
+        {
+            if (!evict_from(shard))
             {
-                continue;
+                break;
             }
+        }
+
+        auto page = std::make_shared<Page>(key.file_id, key.page_index, frame_pool_);
+        page->lock();
+        page->begin_io();
+        page->increment_refcount();
+        page->touch();
 
-            if (page->state() == PageState::Dirty)
+        shard.index.insert_or_assign(page);
+        shard.policy->on_insert(page.get());
+        account_insert(page.get());
+        return page;
+    }
+
+    // Completes a begin_load(), unindexing the page if the load failed. The
+    // load pin is left for the caller to drop or hand on.
+    void PageCache::end_load(Shard &shard, const std::shared_ptr<Page> &page, bool success)
+    {
+        if (!success)
+        {
+            std::lock_guard<std::mutex> lock(shard.lock);
+            const PageKey key{page->file_id(), page->index()};
+            if (shard.index.find(key) == page.get())
             {
-                page->set_state(PageState::Clean);
+                page->mark_evicting();
+                shard.policy->on_remove(page.get());
+                account_remove(page.get());
+                retire(shard.index.erase(key));
             }
+        }
 
-            file_cache.erase(page_it);
-            lru_queue_.erase(it);
-            return page;
+        page->unlock();
+        page->end_io(success);
+    }
+
+    std::shared_ptr<Page> PageCache::find_lock_free(Shard &shard, const PageKey &key, bool record_hit)
+    {
+        EpochDomain::Guard guard;
+        if (!guard)
+        {
+            return nullptr;
         }
 
-        return nullptr;
+        Page *page = shard.index.find_concurrent(key);
+        if (!page || page->evicting())
+        {
+            return nullptr;
+        }
+
+        if (record_hit)
+        {
+            shard.hit_policy.load(std::memory_order_acquire)->on_hit(page);
+        }
+        // The index's reference is retired rather than dropped on eviction,
+        // so the page is still owned while this guard is held.
+        return page->shared_from_this();
     }
 
-    std::shared_ptr<Page> PageCache::evict_clock()
+    void PageCache::retire(std::shared_ptr<Page> page)
     {
-        for (auto it = lru_queue_.begin(); it != lru_queue_.end(); ++it)
+        if (page)
         {
-            uint64_t file_id = it->first;
-            uint64_t page_index = it->second;
+            EpochDomain::global().retire(new std::shared_ptr<Page>(std::move(page)));
+        }
+    }
 
-            auto &file_cache = pages_by_file_[file_id];
-            auto page_it = file_cache.find(page_index);
+    bool PageCache::set_page_state(Page *page, PageState state)
+    {
+        Shard &shard = shard_for(page->file_id(), page->index());
+        std::lock_guard<std::mutex> lock(shard.lock);
 
-            if (page_it == file_cache.end())
+        if (page->state() == state)
+        {
+            return false;
+        }
+        change_state_locked(page, state);
+        return true;
+    }
+
+    // Called with the page's shard lock held.
+    void PageCache::change_state_locked(Page *page, PageState state)
+    {
+        bool was_dirty = counts_as_dirty(page->state());
+        page->set_state(state);
+
+        // Only resident pages are counted.
+        FilePageStats *stats = page->file_stats_;
+        if (!stats || was_dirty == counts_as_dirty(state))
+        {
+            return;
+        }
+
+        account_dirty(stats, page, !was_dirty);
+    }
+
+    std::vector<std::shared_ptr<Page>> PageCache::collect_dirty(size_t max_pages)
+    {
+        std::vector<std::shared_ptr<Page>> pages;
+        if (dirty_pages() == 0)
+        {
+            return pages;
+        }
+
+        std::shared_lock<std::shared_mutex> lock(file_stats_lock_);
+        for (auto &entry : file_stats_)
+        {
+            if (pages.size() >= max_pages)
             {
-                lru_queue_.erase(it);
-                continue;
+                break;
+            }
+            if (entry.second->dirty_pages.load(std::memory_order_relaxed) > 0)
+            {
+                collect_dirty_from(*entry.second, 0, UINT64_MAX, max_pages, pages);
             }
+        }
+        return pages;
+    }
+
+    std::vector<std::shared_ptr<Page>> PageCache::collect_dirty(uint64_t file_id, uint64_t first_page,
+                                                                uint64_t last_page, size_t max_pages)
+    {
+        std::vector<std::shared_ptr<Page>> pages;
+        FilePageStats *stats = find_stats(file_id);
+        if (stats && stats->dirty_pages.load(std::memory_order_relaxed) > 0)
+        {
+            collect_dirty_from(*stats, first_page, last_page, max_pages, pages);
+        }
+        return pages;
+    }
+
+    std::vector<std::shared_ptr<Page>> PageCache::collect_to_sync(uint64_t file_id, uint64_t first_page,
+                                                                  uint64_t last_page)
+    {
+        std::vector<std::shared_ptr<Page>> pages;
+        FilePageStats *stats = find_stats(file_id);
+        if (stats && stats->dirty_pages.load(std::memory_order_relaxed) > 0)
+        {
+            collect_dirty_from(*stats, first_page, last_page, SIZE_MAX, pages, true);
+        }
+        return pages;
+    }
+
+    size_t PageCache::dirty_pages_in_range(uint64_t file_id, uint64_t first_page, uint64_t last_page) const
+    {
+        FilePageStats *stats = find_stats(file_id);
+        if (!stats || stats->dirty_pages.load(std::memory_order_relaxed) == 0)
+        {
+            return 0;
+        }
 
-            auto page = page_it->second.page;
+        std::lock_guard<std::mutex> lock(stats->dirty_lock);
+        if (first_page == 0 && last_page == UINT64_MAX)
+        {
+            return stats->dirty.size();
+        }
+        return std::distance(stats->dirty.lower_bound(first_page), stats->dirty.upper_bound(last_page));
+    }
 
-            if (page->refcount() > 0 || page->is_locked())
+    // A page is only in the set while it is resident, and account_remove()
+    // takes it out before the index lets go of it, so every page found
+    // under the set's lock is still owned. Writeback pages are taken too
+    // when writeback is set.
+    void PageCache::collect_dirty_from(FilePageStats &stats, uint64_t first_page, uint64_t last_page,
+                                       size_t max_pages, std::vector<std::shared_ptr<Page>> &pages,
+                                       bool writeback)
+    {
+        std::lock_guard<std::mutex> lock(stats.dirty_lock);
+        for (auto it = stats.dirty.lower_bound(first_page);
+             it != stats.dirty.end() && it->first <= last_page && pages.size() < max_pages; ++it)
+        {
+            if (writeback || it->second->state() == PageState::Dirty)
             {
-                continue;
+                pages.push_back(it->second->shared_from_this());
             }
+        }
+    }
+
+    bool PageCache::begin_writeback(const std::shared_ptr<Page> &page)
+    {
+        Shard &shard = shard_for(page->file_id(), page->index());
+        std::lock_guard<std::mutex> lock(shard.lock);
 
-            bool accessed = page->last_accessed() > (Page::next_timestamp() - 1000);
+        if (page->state() != PageState::Dirty || !page->try_pin())
+        {
+            return false;
+        }
+        change_state_locked(page.get(), PageState::Writeback);
+        return true;
+    }
 
-            if (accessed)
+    void PageCache::end_writeback(const std::shared_ptr<Page> &page, bool success)
+    {
+        {
+            Shard &shard = shard_for(page->file_id(), page->index());
+            std::lock_guard<std::mutex> lock(shard.lock);
+            if (page->state() == PageState::Writeback)
             {
-                page->touch();
-                continue;
+                change_state_locked(page.get(), success ? PageState::Clean : PageState::Dirty);
             }
+        }
+        page->unpin();
+    }
 
-            if (page->state() == PageState::Dirty)
+    FilePageStats *PageCache::stats_for(uint64_t file_id)
+    {
+        {
+            std::shared_lock<std::shared_mutex> lock(file_stats_lock_);
+            auto it = file_stats_.find(file_id);
+            if (it != file_stats_.end())
             {
-                page->set_state(PageState::Clean);
+                return it->second.get();
             }
+        }
 
-            file_cache.erase(page_it);
-            lru_queue_.erase(it);
-            return page;
+        std::unique_lock<std::shared_mutex> lock(file_stats_lock_);
+        auto &stats = file_stats_[file_id];
+        if (!stats)
+        {
+            stats = std::make_unique<FilePageStats>();
         }
+        return stats.get();
+    }
 
-        return nullptr;
+    FilePageStats *PageCache::find_stats(uint64_t file_id) const
+    {
+        std::shared_lock<std::shared_mutex> lock(file_stats_lock_);
+        auto it = file_stats_.find(file_id);
+        return it != file_stats_.end() ? it->second.get() : nullptr;
+    }
+
+    // Callers hold the page's shard lock.
+    void PageCache::account_insert(Page *page)
+    {
+        FilePageStats *stats = stats_for(page->file_id());
+        page->file_stats_ = stats;
+
+        resident_pages_.fetch_add(1, std::memory_order_relaxed);
+        stats->resident_pages.fetch_add(1, std::memory_order_relaxed);
+        if (counts_as_dirty(page->state()))
+        {
+            account_dirty(stats, page, true);
+        }
     }
 
-    uint64_t PageCache::make_key(uint64_t file_id, uint64_t page_index) const
+    void PageCache::account_remove(Page *page)
     {
-        return (file_id << 32) | page_index;
+        FilePageStats *stats = page->file_stats_;
+        page->file_stats_ = nullptr;
+
+        resident_pages_.fetch_sub(1, std::memory_order_relaxed);
+        stats->resident_pages.fetch_sub(1, std::memory_order_relaxed);
+        if (counts_as_dirty(page->state()))
+        {
+            account_dirty(stats, page, false);
+        }
+    }
+
+    // Callers hold the page's shard lock.
+    void PageCache::account_dirty(FilePageStats *stats, Page *page, bool dirty)
+    {
+        std::lock_guard<std::mutex> lock(stats->dirty_lock);
+        if (dirty)
+        {
+            stats->dirty.emplace(page->index(), page);
+            dirty_pages_.fetch_add(1, std::memory_order_relaxed);
+            stats->dirty_pages.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            stats->dirty.erase(page->index());
+            dirty_pages_.fetch_sub(1, std::memory_order_relaxed);
+            stats->dirty_pages.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    void PageCache::install_policy(Shard &shard, EvictionPolicy policy, bool admission_filter)
+    {
+        auto replacement = make_replacement_policy(policy, shard.capacity, admission_filter);
+        shard.index.for_each([&replacement](Page *page)
+                             { replacement->on_insert(page); });
+        shard.hit_policy.store(replacement.get(), std::memory_order_release);
+
+        if (shard.policy)
+        {
+            EpochDomain::global().retire(shard.policy.release());
+        }
+        shard.policy = std::move(replacement);
     }
 
-    void PageCache::update_lru(uint64_t file_id, uint64_t page_index)
+    void PageCache::reinstall_policies()
     {
-        auto it = std::find_if(lru_queue_.begin(), lru_queue_.end(),
-                               [file_id, page_index](const auto &p)
-                               {
-                                   return p.first == file_id && p.second == page_index;
-                               });
-        if (it != lru_queue_.end())
+        EvictionPolicy policy = eviction_policy();
+        bool filter = admission_filter();
+        for (size_t i = 0; i < num_shards_; ++i)
         {
-            lru_queue_.erase(it);
+            std::lock_guard<std::mutex> lock(shards_[i].lock);
+            install_policy(shards_[i], policy, filter);
         }
-        lru_queue_.push_back({file_id, page_index});
     }
 
 }
@@ -1,52 +1,218 @@
 #pragma once
 
 #include "Page.h"
-#include <unordered_map>
+#include "PageRef.h"
+#include "Eviction.h"
+#include "FlatPageMap.h"
+#include "PageFramePool.h"
+#include "Epoch.h"
+#include "../metrics/Counters.h"
 #include <memory>
-#include <pthread.h>
-#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include <functional>
+#include <map>
 
 namespace pagecache
 {
 
+    // Pages of one file currently held by the cache, updated as pages are
+    // inserted, evicted and marked dirty or clean. dirty holds the file's
+    // Dirty and Writeback pages by index, so writing back one file, or one
+    // range of it, never looks at the rest of the cache.
+    struct FilePageStats
+    {
+        std::atomic<size_t> resident_pages{0};
+        std::atomic<size_t> dirty_pages{0};
+        std::mutex dirty_lock;
+        std::map<uint64_t, Page *> dirty;
+    };
+
     class PageCache
     {
     public:
-        explicit PageCache(size_t max_pages = 65536);
+        static constexpr size_t MIN_PAGES_PER_SHARD = 64;
+        // Upper bound on a get_or_load_range() request (1MB of pages).
+        static constexpr size_t MAX_RANGE_PAGES = 256;
+        // Extra frames for evicted pages still waiting out an epoch grace
+        // period; a few collection intervals' worth covers steady churn.
+        static constexpr size_t RETIRED_FRAME_SLACK = 4 * EpochDomain::COLLECT_INTERVAL;
+
+        // num_shards == 0 picks a shard count from the hardware concurrency.
+        // The count is rounded up to a power of two and capped so that every
+        // shard keeps at least MIN_PAGES_PER_SHARD pages of capacity.
+        explicit PageCache(size_t max_pages = 65536, size_t num_shards = 0);
         ~PageCache();
 
+        // Hits on resident pages take no locks: the index is probed inside an
+        // epoch guard and the policy only sees an atomic on_hit. Misses and
+        // eviction serialise on the page's shard. Only the first miss on a
+        // page runs its loader; concurrent misses wait for that read and get
+        // its result, or null if it failed.
         std::shared_ptr<Page> get_or_load(uint64_t file_id, uint64_t page_index,
                                           std::function<bool(uint8_t *)> loader);
         std::shared_ptr<Page> get_page(uint64_t file_id, uint64_t page_index);
+
+        // get_or_load() that also pins the page, so it cannot be evicted
+        // until the returned reference is dropped. Empty if the load failed.
+        PageRef pin_or_load(uint64_t file_id, uint64_t page_index,
+                            std::function<bool(uint8_t *)> loader);
+
+        // Fills frames[0..count) with pages first_page.. of a file and
+        // returns how many leading pages it loaded; the rest count as failed.
+        using RangeLoader = std::function<size_t(uint64_t first_page, uint8_t *const *frames, size_t count)>;
+
+        // A contiguous run of missing pages handed to a BatchLoader. Calling
+        // complete() with the number of leading pages filled marks them up
+        // to date, fails the rest and wakes their waiters; it may be called
+        // from any thread, once the I/O behind the run has finished.
+        struct LoadRun
+        {
+            uint64_t first_page;
+            std::vector<uint8_t *> frames;
+            std::function<void(size_t loaded)> complete;
+        };
+        // Receives every run of a request at once, so it can issue them as
+        // one batch of asynchronous I/O.
+        using BatchLoader = std::function<void(std::vector<LoadRun> &runs)>;
+
+        // Pins pages [first_page, first_page + count) in one pass: hits are
+        // taken lock-free, every shard holding misses is locked once to index
+        // them all, and each contiguous run of misses goes to the loader as a
+        // single call. The result stops short at the first page that could
+        // not be loaded. Callers keep count within max_range_pages().
+        std::vector<PageRef> get_or_load_range(uint64_t file_id, uint64_t first_page, size_t count,
+                                               const RangeLoader &loader);
+        std::vector<PageRef> get_or_load_range(uint64_t file_id, uint64_t first_page, size_t count,
+                                               const BatchLoader &loader);
+        size_t max_range_pages() const;
+
+        // Starts loading the pages of [first_page, first_page + count) that
+        // are not cached and returns how many that was. Nothing is pinned
+        // or waited for: the loader may complete the runs later, and
+        // readers reaching a page before then wait for it as for any other
+        // in-flight load. Hits are not counted as accesses.
+        size_t prefetch_range(uint64_t file_id, uint64_t first_page, size_t count, const BatchLoader &loader);
+        // prefetch_range() for callers that must not block: returns a page
+        // of the range that is still being read in, by this call or an
+        // earlier one, to wait on with Page::wait_io_async(), or null once
+        // the whole range is resident.
+        std::shared_ptr<Page> load_range_async(uint64_t file_id, uint64_t first_page, size_t count,
+                                               const BatchLoader &loader);
+        // Whether the page is resident or being loaded.
+        bool contains(uint64_t file_id, uint64_t page_index);
+        // Whether the page is indexed but still being read in.
+        bool loading(uint64_t file_id, uint64_t page_index);
+
         void insert_page(uint64_t file_id, uint64_t page_index, std::shared_ptr<Page> page);
 
         bool evict_one();
         void evict_to_target(size_t target_pages);
 
-        size_t total_pages() const;
-        size_t dirty_pages() const;
+        // Page state changes of cached pages go through the cache so the
+        // counters below stay exact. Both return whether the state changed.
+        bool mark_dirty(const std::shared_ptr<Page> &page);
+        bool mark_clean(const std::shared_ptr<Page> &page);
+
+        // Writeback support. collect_dirty() snapshots up to max_pages Dirty
+        // pages, of all files or of pages [first_page, last_page] of one,
+        // in index order per file. begin_writeback() moves a Dirty page to
+        // Writeback and pins it for the write; end_writeback() makes it
+        // Clean, or Dirty again if the write failed, and unpins it. A page
+        // written to in between stays Dirty. Writeback pages still count as
+        // dirty.
+        std::vector<std::shared_ptr<Page>> collect_dirty(size_t max_pages);
+        std::vector<std::shared_ptr<Page>> collect_dirty(uint64_t file_id, uint64_t first_page,
+                                                         uint64_t last_page, size_t max_pages);
+        // Every Dirty or Writeback page of the file within [first_page,
+        // last_page]: what a sync starting now has to get to disk.
+        std::vector<std::shared_ptr<Page>> collect_to_sync(uint64_t file_id, uint64_t first_page,
+                                                           uint64_t last_page);
+        // Dirty or Writeback pages of the file within [first_page, last_page].
+        size_t dirty_pages_in_range(uint64_t file_id, uint64_t first_page, uint64_t last_page) const;
+        bool begin_writeback(const std::shared_ptr<Page> &page);
+        void end_writeback(const std::shared_ptr<Page> &page, bool success);
+
+        size_t total_pages() const { return resident_pages_.load(std::memory_order_relaxed); }
+        size_t dirty_pages() const { return dirty_pages_.load(std::memory_order_relaxed); }
         size_t clean_pages() const;
+        size_t file_resident_pages(uint64_t file_id) const;
+        size_t file_dirty_pages(uint64_t file_id) const;
+
+        size_t max_pages() const { return max_pages_; }
+        size_t num_shards() const { return num_shards_; }
+        const PageFramePool &frame_pool() const { return *frame_pool_; }
+        std::shared_ptr<PageFramePool> shared_frame_pool() const { return frame_pool_; }
+
+        // Where the cache, and the files and writeback using it, record
+        // evictions and latencies. Each cache starts with its own; replace
+        // it before the cache is in use.
+        std::shared_ptr<Counters> counters() const { return counters_; }
+        void set_counters(std::shared_ptr<Counters> counters) { counters_ = std::move(counters); }
 
+        // Accepts "lru", "clock" or "arc"; anything else selects LRU.
+        // Resident pages are carried over into the new policy's state.
         void set_eviction_policy(const std::string &policy);
+        EvictionPolicy eviction_policy() const { return eviction_policy_.load(std::memory_order_relaxed); }
+
+        // Puts a W-TinyLFU admission filter in front of the eviction policy,
+        // so a newly loaded page only displaces a resident one when it has
+        // been requested more often. Off by default.
+        void set_admission_filter(bool enabled);
+        bool admission_filter() const { return admission_filter_.load(std::memory_order_relaxed); }
 
     private:
-        struct CacheEntry
+        struct alignas(64) Shard
         {
-            std::shared_ptr<Page> page;
-            uint64_t file_id;
+            std::mutex lock;
+            FlatPageMap index;
+            std::unique_ptr<ReplacementPolicy> policy;
+            // policy, for lock-free readers; replaced policies are retired
+            // through the epoch domain.
+            std::atomic<ReplacementPolicy *> hit_policy{nullptr};
+            size_t capacity = 0;
         };
 
         size_t max_pages_;
-        std::unordered_map<uint64_t, std::unordered_map<uint64_t, CacheEntry>> pages_by_file_;
-        std::deque<std::pair<uint64_t, uint64_t>> lru_queue_;
-        mutable pthread_mutex_t cache_lock_;
-        std::string eviction_policy_;
-        std::shared_ptr<Page> evict_lru();
-        std::shared_ptr<Page> evict_clock();
-        uint64_t make_key(uint64_t file_id, uint64_t page_index) const;
-        void update_lru(uint64_t file_id, uint64_t page_index);
+        size_t num_shards_;
+        size_t shard_shift_;
+        std::unique_ptr<Shard[]> shards_;
+        std::shared_ptr<PageFramePool> frame_pool_;
+        std::shared_ptr<Counters> counters_;
+        std::atomic<EvictionPolicy> eviction_policy_;
+        std::atomic<bool> admission_filter_;
+        std::atomic<size_t> reclaim_cursor_;
+        alignas(64) std::atomic<size_t> resident_pages_;
+        alignas(64) std::atomic<size_t> dirty_pages_;
+        mutable std::shared_mutex file_stats_lock_;
+        std::unordered_map<uint64_t, std::unique_ptr<FilePageStats>> file_stats_;
+
+        Shard &shard_for(uint64_t file_id, uint64_t page_index) const;
+        size_t shard_pages(const Shard &shard) const;
+        std::shared_ptr<Page> find_lock_free(Shard &shard, const PageKey &key, bool record_hit);
+        void start_range_load(uint64_t file_id, uint64_t first_page, size_t count, const BatchLoader &loader,
+                              bool keep_pins, std::vector<std::shared_ptr<Page>> &pages,
+                              std::vector<bool> &owned);
+        bool evict_from(Shard &shard);
+        std::shared_ptr<Page> begin_load(Shard &shard, const PageKey &key);
+        void end_load(Shard &shard, const std::shared_ptr<Page> &page, bool success);
+        static void retire(std::shared_ptr<Page> page);
+        bool set_page_state(Page *page, PageState state);
+        void change_state_locked(Page *page, PageState state);
+        static void collect_dirty_from(FilePageStats &stats, uint64_t first_page, uint64_t last_page,
+                                       size_t max_pages, std::vector<std::shared_ptr<Page>> &pages,
+                                       bool writeback = false);
+        FilePageStats *stats_for(uint64_t file_id);
+        FilePageStats *find_stats(uint64_t file_id) const;
+        void account_insert(Page *page);
+        void account_remove(Page *page);
+        void account_dirty(FilePageStats *stats, Page *page, bool dirty);
+        void install_policy(Shard &shard, EvictionPolicy policy, bool admission_filter);
+        void reinstall_policies();
     };
 
 }
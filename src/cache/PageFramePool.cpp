@@ -0,0 +1,117 @@
+#include "PageFramePool.h"
+#include "Page.h"
+#include <algorithm>
+#include <new>
+#include <sys/mman.h>
+
+namespace pagecache
+{
+
+    namespace
+    {
+        // Freelist head packs a 32-bit ABA tag above a 32-bit frame number
+        // biased by one, so zero means empty.
+        inline uint64_t pack_head(uint64_t tag, uint32_t slot) { return (tag << 32) | slot; }
+        inline uint32_t head_slot(uint64_t head) { return (uint32_t)head; }
+        inline uint64_t head_tag(uint64_t head) { return head >> 32; }
+
+        size_t round_up(size_t n, size_t align)
+        {
+            return (n + align - 1) / align * align;
+        }
+    }
+
+    PageFramePool::PageFramePool(size_t num_frames, bool try_hugepages)
+        : base_(nullptr),
+          region_size_(0),
+          num_frames_(num_frames),
+          hugetlb_(false),
+          next_free_(new std::atomic<uint32_t>[num_frames]),
+          free_head_(0),
+          bump_(0),
+          in_use_(0)
+    {
+        region_size_ = round_up(std::max<size_t>(num_frames, 1) * Page::PAGE_SIZE, HUGE_PAGE_SIZE);
+        void *region = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+        // No MAP_NORESERVE here: hugetlb mappings must fail up front rather
+        // than SIGBUS on first touch when the reserved pool runs short.
+        if (try_hugepages)
+        {
+            region = mmap(nullptr, region_size_, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            hugetlb_ = region != MAP_FAILED;
+        }
+#endif
+
+        if (region == MAP_FAILED)
+        {
+            region = mmap(nullptr, region_size_, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (region == MAP_FAILED)
+            {
+                throw std::bad_alloc();
+            }
+#ifdef MADV_HUGEPAGE
+            if (try_hugepages)
+            {
+                madvise(region, region_size_, MADV_HUGEPAGE);
+            }
+#endif
+        }
+
+        base_ = static_cast<uint8_t *>(region);
+    }
+
+    PageFramePool::~PageFramePool()
+    {
+        if (base_)
+        {
+            munmap(base_, region_size_);
+        }
+    }
+
+    uint8_t *PageFramePool::allocate()
+    {
+        uint64_t head = free_head_.load(std::memory_order_acquire);
+        while (head_slot(head) != 0)
+        {
+            uint32_t frame = head_slot(head) - 1;
+            uint32_t next = next_free_[frame].load(std::memory_order_relaxed);
+            if (free_head_.compare_exchange_weak(head, pack_head(head_tag(head) + 1, next),
+                                                 std::memory_order_acq_rel,
+                                                 std::memory_order_acquire))
+            {
+                in_use_.fetch_add(1, std::memory_order_relaxed);
+                return base_ + (size_t)frame * Page::PAGE_SIZE;
+            }
+        }
+
+        size_t frame = bump_.load(std::memory_order_relaxed);
+        while (frame < num_frames_)
+        {
+            if (bump_.compare_exchange_weak(frame, frame + 1, std::memory_order_relaxed))
+            {
+                in_use_.fetch_add(1, std::memory_order_relaxed);
+                return base_ + frame * Page::PAGE_SIZE;
+            }
+        }
+
+        return nullptr;
+    }
+
+    void PageFramePool::release(uint8_t *frame)
+    {
+        uint32_t slot = (uint32_t)((frame - base_) / Page::PAGE_SIZE);
+        uint64_t head = free_head_.load(std::memory_order_relaxed);
+        do
+        {
+            next_free_[slot].store(head_slot(head), std::memory_order_relaxed);
+        } while (!free_head_.compare_exchange_weak(head, pack_head(head_tag(head) + 1, slot + 1),
+                                                   std::memory_order_release,
+                                                   std::memory_order_relaxed));
+        in_use_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace pagecache
+{
+
+    // Preallocated arena of PAGE_SIZE frames carved out of a single anonymous
+    // mapping sized for the whole cache budget. The mapping is backed by 2MB
+    // hugetlb pages when the system has them reserved, otherwise by normal
+    // pages with a transparent-hugepage hint. Frames are page aligned, handed
+    // out lazily from a bump pointer and recycled through a lock-free
+    // tagged freelist, so steady-state churn never reaches malloc.
+    class PageFramePool
+    {
+    public:
+        static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+        explicit PageFramePool(size_t num_frames, bool try_hugepages = true);
+        ~PageFramePool();
+
+        PageFramePool(const PageFramePool &) = delete;
+        PageFramePool &operator=(const PageFramePool &) = delete;
+
+        // Returns nullptr when every frame is in use.
+        uint8_t *allocate();
+        void release(uint8_t *frame);
+
+        bool contains(const uint8_t *ptr) const
+        {
+            return ptr >= base_ && ptr < base_ + region_size_;
+        }
+
+        uint8_t *base() const { return base_; }
+        size_t region_size() const { return region_size_; }
+        size_t num_frames() const { return num_frames_; }
+        size_t frames_in_use() const { return in_use_.load(std::memory_order_relaxed); }
+        bool hugetlb_backed() const { return hugetlb_; }
+
+    private:
+        uint8_t *base_;
+        size_t region_size_;
+        size_t num_frames_;
+        bool hugetlb_;
+        std::unique_ptr<std::atomic<uint32_t>[]> next_free_;
+        std::atomic<uint64_t> free_head_;
+        std::atomic<size_t> bump_;
+        std::atomic<size_t> in_use_;
+    };
+
+}
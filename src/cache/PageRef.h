@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Page.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace pagecache
+{
+
+    // A pinned reference to a cached page. Eviction skips pinned pages, so
+    // the bytes behind data() stay resident and in place for the lifetime
+    // of the handle. By default a reference spans the whole page; readers
+    // narrow it to the part of the page a request covers.
+    class PageRef
+    {
+    public:
+        PageRef() : offset_(0), length_(0) {}
+
+        // Adopts a pin the caller already holds on the page.
+        explicit PageRef(std::shared_ptr<Page> page)
+            : page_(std::move(page)), offset_(0), length_(page_ ? Page::PAGE_SIZE : 0)
+        {
+        }
+
+        ~PageRef() { reset(); }
+
+        PageRef(PageRef &&other) noexcept
+            : page_(std::move(other.page_)), offset_(other.offset_), length_(other.length_)
+        {
+            other.length_ = 0;
+        }
+
+        PageRef &operator=(PageRef &&other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                page_ = std::move(other.page_);
+                offset_ = other.offset_;
+                length_ = other.length_;
+                other.length_ = 0;
+            }
+            return *this;
+        }
+
+        PageRef(const PageRef &) = delete;
+        PageRef &operator=(const PageRef &) = delete;
+
+        explicit operator bool() const { return page_ != nullptr; }
+
+        const std::shared_ptr<Page> &page() const { return page_; }
+        const uint8_t *data() const { return page_->data() + offset_; }
+        size_t size() const { return length_; }
+        size_t offset() const { return offset_; }
+
+        // Restricts the reference to [offset, offset + length) of the page.
+        void narrow(size_t offset, size_t length)
+        {
+            offset_ = offset;
+            length_ = length;
+        }
+
+        void reset()
+        {
+            if (page_)
+            {
+                page_->unpin();
+                page_.reset();
+            }
+            length_ = 0;
+        }
+
+    private:
+        std::shared_ptr<Page> page_;
+        size_t offset_;
+        size_t length_;
+    };
+
+}
@@ -1,60 +1,185 @@
 #include "File.h"
+#include "../scheduler/EventLoop.h"
+#include <algorithm>
 #include <cstring>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/uio.h>
 
 namespace pagecache
 {
 
-    File::File(std::shared_ptr<Inode> inode, FileMode mode, std::shared_ptr<PageCache> cache)
-        : inode_(inode), mode_(mode), offset_(0), cache_(cache)
+    namespace
+    {
+        // Waits for a page being read in, resuming on the awaiting
+        // coroutine's loop.
+        struct PageIO
+        {
+            std::shared_ptr<Page> page;
+
+            bool await_ready() const { return !page->under_io(); }
+            bool await_suspend(std::coroutine_handle<> handle) const
+            {
+                return page->wait_io_async(EventLoop::resumer(handle));
+            }
+            void await_resume() const {}
+        };
+
+        // Runs blocking work on a pool thread in the given class and
+        // resumes once it is done.
+        struct OnPool
+        {
+            std::shared_ptr<IOThreadPool> pool;
+            IOPriority priority;
+            std::function<void()> work;
+
+            bool await_ready() const { return false; }
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                pool->submit([work = std::move(work), resume = EventLoop::resumer(handle)]() mutable
+                             {
+                    work();
+                    // Release what the work captured before resuming: once the
+                    // awaiter lets go, it may be the last reference to the
+                    // engine that owns this pool, which cannot be destroyed
+                    // on one of the pool's own threads.
+                    work = nullptr;
+                    resume(); },
+                             priority);
+            }
+            void await_resume() const {}
+        };
+
+        // One run's read from disk. A short read is resumed where it stopped;
+        // only a read that returns nothing has reached the end of the file.
+        struct RunRead
+        {
+            IOEngine *io;
+            int fd;
+            bool direct;
+            uint64_t offset;
+            uint64_t in_file;
+            std::vector<uint8_t *> frames;
+            std::function<void(size_t loaded)> complete;
+            LatencyHistogram *latency;
+            LatencyHistogram::Clock::time_point start;
+            size_t bytes = 0;
+        };
+
+        void finish_run_read(const std::shared_ptr<RunRead> &read, ssize_t result);
+
+        // Queues the part of the run not read yet; the caller submits.
+        void queue_run_read(const std::shared_ptr<RunRead> &read)
+        {
+            std::vector<struct iovec> iov;
+            iov.reserve(read->frames.size() - read->bytes / Page::PAGE_SIZE);
+            for (size_t i = read->bytes / Page::PAGE_SIZE; i < read->frames.size(); ++i)
+            {
+                size_t from = i == read->bytes / Page::PAGE_SIZE ? read->bytes % Page::PAGE_SIZE : 0;
+                iov.push_back({read->frames[i] + from, Page::PAGE_SIZE - from});
+            }
+            read->io->queue_read(read->fd, read->offset + read->bytes, iov.data(), iov.size(),
+                                 [read](ssize_t result)
+                                 { finish_run_read(read, result); });
+        }
+
+        void finish_run_read(const std::shared_ptr<RunRead> &read, ssize_t result)
+        {
+            const uint64_t length = read->frames.size() * Page::PAGE_SIZE;
+            bool eof = result == 0;
+            if (result > 0)
+            {
+                read->bytes += (size_t)result;
+                // A direct read cannot resume mid-page, and it only comes
+                // back short at the end of the file anyway.
+                eof = read->direct && read->bytes < length;
+                if (!eof && read->bytes < length)
+                {
+                    queue_run_read(read);
+                    read->io->submit();
+                    return;
+                }
+            }
+
+            if (read->latency)
+            {
+                read->latency->record_since(read->start);
+            }
+
+            // Past the end of what is on disk, the pages within the file's
+            // size read as a hole. After an error, only whole pages count.
+            size_t pages = read->bytes / Page::PAGE_SIZE;
+            if (result >= 0)
+            {
+                uint64_t valid = read->bytes;
+                if (eof)
+                {
+                    valid = std::max<uint64_t>(valid, std::min<uint64_t>(read->in_file, length));
+                }
+                pages = (valid + Page::PAGE_SIZE - 1) / Page::PAGE_SIZE;
+            }
+            for (size_t i = read->bytes / Page::PAGE_SIZE; i < pages; ++i)
+            {
+                size_t from = i == read->bytes / Page::PAGE_SIZE ? read->bytes % Page::PAGE_SIZE : 0;
+                std::memset(read->frames[i] + from, 0, Page::PAGE_SIZE - from);
+            }
+            read->complete(pages);
+        }
+    }
+
+    File::File(std::shared_ptr<Inode> inode, FileMode mode, std::shared_ptr<PageCache> cache,
+               std::shared_ptr<IOEngine> io, std::shared_ptr<WritebackEngine> writeback,
+               std::shared_ptr<Readahead> readahead)
+        : inode_(inode), mode_(mode), offset_(0), cache_(cache),
+          io_(io ? std::move(io) : std::make_shared<SyncIOEngine>()),
+          writeback_(std::move(writeback)), readahead_(std::move(readahead))
     {
     }
 
     File::~File()
     {
+        cancel_readahead();
     }
 
     size_t File::read(uint8_t *buffer, size_t count)
     {
+        LatencyHistogram::Clock::time_point start = LatencyHistogram::Clock::now();
         std::lock_guard<std::mutex> lock(file_lock_);
 
-        if (mode_ == FileMode::WriteOnly)
+        if (mode_ == FileMode::WriteOnly || offset_ >= inode_->size())
         {
             return 0;
         }
 
         size_t bytes_read = 0;
-        uint64_t remaining = count;
-        uint64_t current_offset = offset_;
+        uint64_t end = std::min<uint64_t>(offset_ + count, inode_->size());
+        bool missed = false;
 
-        while (remaining > 0 && current_offset < inode_->size())
+        while (offset_ < end)
         {
-            uint64_t page_index = current_offset / Page::PAGE_SIZE;
-            uint64_t page_offset = current_offset % Page::PAGE_SIZE;
-            size_t to_read = std::min(remaining, Page::PAGE_SIZE - page_offset);
-            to_read = std::min(to_read, (size_t)(inode_->size() - current_offset));
-
-            auto loader = [this, page_index](uint8_t *page_data)
+            if (readahead_)
             {
-                return read_from_disk(page_data, page_index * Page::PAGE_SIZE, Page::PAGE_SIZE) > 0;
-            };
+                read_ahead(offset_, end);
+            }
 
-            auto page = cache_->get_or_load(inode_->ino(), page_index, loader);
-            if (!page)
+            std::vector<PageRef> pages = pin_range(offset_, end, true, &missed);
+            if (pages.empty())
             {
                 break;
             }
 
-            std::memcpy(buffer + bytes_read, page->data() + page_offset, to_read);
-            page->decrement_refcount();
-
-            bytes_read += to_read;
-            remaining -= to_read;
-            current_offset += to_read;
+            for (const PageRef &page : pages)
+            {
+                std::memcpy(buffer + bytes_read, page.data(), page.size());
+                bytes_read += page.size();
+                offset_ += page.size();
+            }
         }
 
-        offset_ = current_offset;
+        if (!missed && bytes_read > 0)
+        {
+            cache_->counters()->read_hit_latency().record_since(start);
+        }
         return bytes_read;
     }
 
@@ -68,68 +193,377 @@ namespace pagecache
         }
 
         size_t bytes_written = 0;
-        uint64_t remaining = count;
-        uint64_t current_offset = offset_;
+        uint64_t end = offset_ + count;
 
-        while (remaining > 0)
+        while (offset_ < end)
         {
-            uint64_t page_index = current_offset / Page::PAGE_SIZE;
-            uint64_t page_offset = current_offset % Page::PAGE_SIZE;
-            size_t to_write = std::min(remaining, Page::PAGE_SIZE - page_offset);
+            size_t dirtied = 0;
+            size_t written = write_batch(offset_, end, buffer + bytes_written, dirtied);
+            if (written == 0)
+            {
+                break;
+            }
+            bytes_written += written;
+            offset_ += written;
+
+            if (writeback_ && dirtied > 0)
+            {
+                writeback_->balance_dirty_pages(dirty_pacing_, dirtied);
+            }
+        }
 
-            auto loader = [](uint8_t *)
-            { return true; };
-            auto page = cache_->get_or_load(inode_->ino(), page_index, loader);
+        return bytes_written;
+    }
+
+    Async<size_t> File::read_async(uint64_t offset, uint8_t *buffer, size_t count)
+    {
+        LatencyHistogram::Clock::time_point start = LatencyHistogram::Clock::now();
+        if (mode_ == FileMode::WriteOnly || offset >= inode_->size())
+        {
+            co_return 0;
+        }
 
-            if (!page)
+        size_t bytes_read = 0;
+        uint64_t end = std::min<uint64_t>(offset + count, inode_->size());
+        bool missed = false;
+
+        while (offset < end)
+        {
+            if (readahead_)
+            {
+                std::lock_guard<std::mutex> lock(file_lock_);
+                read_ahead(offset, end);
+            }
+            for (PageIO pending{start_load(offset, end, missed)}; pending.page;
+                 pending.page = start_load(offset, end, missed))
+            {
+                co_await pending;
+            }
+
+            std::vector<PageRef> pages = pin_range(offset, end, true, &missed);
+            if (pages.empty())
             {
                 break;
             }
 
-            std::memcpy(page->data() + page_offset, buffer + bytes_written, to_write);
-            page->set_state(PageState::Dirty);
-            page->decrement_refcount();
+            for (const PageRef &page : pages)
+            {
+                std::memcpy(buffer + bytes_read, page.data(), page.size());
+                bytes_read += page.size();
+                offset += page.size();
+            }
+        }
+
+        if (!missed && bytes_read > 0)
+        {
+            cache_->counters()->read_hit_latency().record_since(start);
+        }
+        co_return bytes_read;
+    }
 
-            uint64_t new_end = current_offset + to_write;
-            if (new_end > inode_->size())
+    Async<size_t> File::write_async(uint64_t offset, const uint8_t *buffer, size_t count)
+    {
+        if (mode_ == FileMode::ReadOnly)
+        {
+            co_return 0;
+        }
+
+        size_t bytes_written = 0;
+        uint64_t end = offset + count;
+
+        while (offset < end)
+        {
+            size_t written = 0;
+            DirtyThrottle::Clock::duration pause = DirtyThrottle::Clock::duration::zero();
             {
-                inode_->set_size(new_end);
+                std::lock_guard<std::mutex> lock(file_lock_);
+                size_t dirtied = 0;
+                written = write_batch(offset, end, buffer + bytes_written, dirtied);
+                if (writeback_ && dirtied > 0)
+                {
+                    pause = writeback_->dirty_pause(dirty_pacing_, dirtied);
+                }
+            }
+            if (written == 0)
+            {
+                break;
             }
+            bytes_written += written;
+            offset += written;
 
-            bytes_written += to_write;
-            remaining -= to_write;
-            current_offset += to_write;
+            co_await EventLoop::sleep_for(pause);
         }
 
-        offset_ = current_offset;
-        return bytes_written;
+        co_return bytes_written;
+    }
+
+    Async<int> File::sync_async()
+    {
+        if (!writeback_)
+        {
+            co_return 0;
+        }
+
+        // A named awaiter: GCC 12 destroys brace-initialised temporaries in
+        // a co_await operand twice.
+        int error = 0;
+        OnPool sync{writeback_->pool(), IOPriority::Sync, [writeback = writeback_, ino = inode_->ino(), &error]()
+                    { error = writeback->sync_range(ino, 0, 0); }};
+        co_await sync;
+        co_return error;
     }
 
-    void File::sync()
+    std::vector<PageRef> File::read_pages(uint64_t offset, size_t count)
     {
+        LatencyHistogram::Clock::time_point start = LatencyHistogram::Clock::now();
         std::lock_guard<std::mutex> lock(file_lock_);
+
+        std::vector<PageRef> pages;
+        if (mode_ == FileMode::WriteOnly || offset >= inode_->size())
+        {
+            return pages;
+        }
+
+        uint64_t end = std::min<uint64_t>(offset + count, inode_->size());
+        pages.reserve((end - 1) / Page::PAGE_SIZE - offset / Page::PAGE_SIZE + 1);
+        bool missed = false;
+
+        while (offset < end)
+        {
+            std::vector<PageRef> batch = pin_range(offset, end, true, &missed);
+            if (batch.empty())
+            {
+                break;
+            }
+
+            for (PageRef &page : batch)
+            {
+                offset += page.size();
+                pages.push_back(std::move(page));
+            }
+        }
+
+        if (!missed && !pages.empty())
+        {
+            cache_->counters()->read_hit_latency().record_since(start);
+        }
+        return pages;
     }
 
-    size_t File::read_from_disk(uint8_t *buffer, uint64_t offset, size_t count)
+    void File::cancel_readahead()
     {
-        if (inode_->file_descriptor() < 0)
+        std::lock_guard<std::mutex> lock(file_lock_);
+        if (ra_queue_)
         {
-            return 0;
+            ra_queue_->cancelled.store(true);
+            ra_queue_.reset();
         }
+        ra_streams_ = ReadaheadStreams();
+    }
 
-        ssize_t result = pread(inode_->file_descriptor(), buffer, count, offset);
-        return result > 0 ? result : 0;
+    int File::sync()
+    {
+        return sync_range(0, 0);
     }
 
-    size_t File::write_to_disk(const uint8_t *buffer, uint64_t offset, size_t count)
+    int File::sync_range(uint64_t offset, uint64_t length)
     {
-        if (inode_->file_descriptor() < 0)
+        std::lock_guard<std::mutex> lock(file_lock_);
+        return writeback_ ? writeback_->sync_range(inode_->ino(), offset, length) : 0;
+    }
+
+    // Pins the pages covering [offset, end), up to the cache's range limit,
+    // each narrowed to its share of the range. Pages that are not cached
+    // are read from the file when fill is set, setting missed. Otherwise
+    // they are for callers about to overwrite them: only the bytes outside
+    // [offset, end) are zeroed.
+    std::vector<PageRef> File::pin_range(uint64_t offset, uint64_t end, bool fill, bool *missed)
+    {
+        uint64_t first_page = offset / Page::PAGE_SIZE;
+        size_t count = std::min<uint64_t>((end - 1) / Page::PAGE_SIZE - first_page + 1,
+                                          cache_->max_range_pages());
+
+        PageCache::BatchLoader loader;
+        if (fill)
         {
-            return 0;
+            loader = [this, missed](std::vector<PageCache::LoadRun> &runs)
+            {
+                if (missed)
+                {
+                    *missed = true;
+                }
+                read_from_disk(*inode_, *io_, runs, &cache_->counters()->miss_latency());
+            };
+        }
+        else
+        {
+            loader = [offset, end](std::vector<PageCache::LoadRun> &runs)
+            {
+                for (PageCache::LoadRun &run : runs)
+                {
+                    for (size_t i = 0; i < run.frames.size(); ++i)
+                    {
+                        uint64_t page_start = (run.first_page + i) * Page::PAGE_SIZE;
+                        if (page_start < offset)
+                        {
+                            std::memset(run.frames[i], 0, offset - page_start);
+                        }
+                        if (page_start + Page::PAGE_SIZE > end)
+                        {
+                            std::memset(run.frames[i] + (end - page_start), 0, page_start + Page::PAGE_SIZE - end);
+                        }
+                    }
+                    run.complete(run.frames.size());
+                }
+            };
+        }
+
+        std::vector<PageRef> pages = cache_->get_or_load_range(inode_->ino(), first_page, count, loader);
+        for (PageRef &page : pages)
+        {
+            uint64_t page_start = page.page()->index() * Page::PAGE_SIZE;
+            uint64_t from = std::max(offset, page_start);
+            uint64_t to = std::min(end, page_start + Page::PAGE_SIZE);
+            page.narrow(from - page_start, to - from);
+        }
+        return pages;
+    }
+
+    // Starts loading what pin_range() would take of [offset, end) without
+    // waiting, and returns a page of it still being read in, or null once
+    // all of it is resident. Sets missed if it issued reads.
+    std::shared_ptr<Page> File::start_load(uint64_t offset, uint64_t end, bool &missed)
+    {
+        uint64_t first_page = offset / Page::PAGE_SIZE;
+        size_t count = std::min<uint64_t>((end - 1) / Page::PAGE_SIZE - first_page + 1,
+                                          cache_->max_range_pages());
+        return cache_->load_range_async(inode_->ino(), first_page, count,
+                                        [this, &missed](std::vector<PageCache::LoadRun> &runs)
+                                        {
+            missed = true;
+            read_from_disk(*inode_, *io_, runs, &cache_->counters()->miss_latency()); });
+    }
+
+    // Copies what pin_range() takes of [offset, end) from buffer into the
+    // cache, extending the file if need be, and returns the bytes copied;
+    // dirtied gets the number of pages that turned dirty. The pages are
+    // unpinned on return, so writeback and eviction can get at them while
+    // the writer is paused.
+    size_t File::write_batch(uint64_t offset, uint64_t end, const uint8_t *buffer, size_t &dirtied)
+    {
+        // A head or tail page the batch covers only in part keeps the rest
+        // of its bytes, so one that starts inside the file is read in first
+        // and stays pinned while the batch is copied.
+        const uint64_t size = inode_->size();
+        uint64_t head_start = offset - offset % Page::PAGE_SIZE;
+        uint64_t batch_end = std::min<uint64_t>(end, head_start + cache_->max_range_pages() * Page::PAGE_SIZE);
+        uint64_t tail_start = (batch_end - 1) / Page::PAGE_SIZE * Page::PAGE_SIZE;
+
+        std::vector<PageRef> head;
+        std::vector<PageRef> tail;
+        if (head_start < size && (offset > head_start || batch_end < head_start + Page::PAGE_SIZE))
+        {
+            head = pin_range(offset, std::min(batch_end, head_start + Page::PAGE_SIZE), true);
+            if (head.empty())
+            {
+                return 0;
+            }
+        }
+        if (tail_start > head_start && tail_start < size && batch_end % Page::PAGE_SIZE)
+        {
+            tail = pin_range(tail_start, batch_end, true);
+            batch_end = tail.empty() ? tail_start : batch_end;
+        }
+
+        std::vector<PageRef> pages = pin_range(offset, batch_end, false);
+        size_t bytes_written = 0;
+        for (const PageRef &page : pages)
+        {
+            std::memcpy(page.page()->data() + page.offset(), buffer + bytes_written, page.size());
+            bytes_written += page.size();
+        }
+
+        // The size goes out before the pages turn dirty: writeback must
+        // never take a dirty page that lies past the size it reads.
+        if (bytes_written > 0)
+        {
+            inode_->extend_size(offset + bytes_written);
+        }
+        for (const PageRef &page : pages)
+        {
+            dirtied += cache_->mark_dirty(page.page());
+        }
+        return bytes_written;
+    }
+
+    // Feeds the pages pin_range() is about to take for [offset, end) to
+    // readahead and starts loading the windows it asks for, clipped to the
+    // file. A sequential window covers the request's own pages when they
+    // missed, so they are read in the same batch. A first page that is
+    // still queued for readahead is fetched ahead of other queued work.
+    void File::read_ahead(uint64_t offset, uint64_t end)
+    {
+        uint64_t first_page = offset / Page::PAGE_SIZE;
+        size_t count = std::min<uint64_t>((end - 1) / Page::PAGE_SIZE - first_page + 1,
+                                          cache_->max_range_pages());
+        bool cached = cache_->contains(inode_->ino(), first_page);
+        if (cached && ra_queue_ && cache_->loading(inode_->ino(), first_page))
+        {
+            readahead_->expedite(*ra_queue_, first_page);
+        }
+
+        std::vector<Readahead::Window> windows = readahead_->on_read(ra_streams_, first_page, count, cached);
+        if (windows.empty())
+        {
+            return;
+        }
+        if (!ra_queue_)
+        {
+            ra_queue_ = std::make_shared<Readahead::FileQueue>();
+        }
+
+        uint64_t file_pages = (inode_->size() + Page::PAGE_SIZE - 1) / Page::PAGE_SIZE;
+        auto loader = [inode = inode_, io = io_](std::vector<PageCache::LoadRun> &runs)
+        { read_from_disk(*inode, *io, runs); };
+        for (Readahead::Window &window : windows)
+        {
+            if (window.start >= file_pages)
+            {
+                continue;
+            }
+            window.size = std::min<uint64_t>(window.size, file_pages - window.start);
+            readahead_->submit(inode_->ino(), window, loader, ra_queue_);
+        }
+    }
+
+    // Queues one vectored read per run and submits them together. A run
+    // completes with the pages that received data, or that lie within the
+    // file's size but past the end of what is on disk, which read as a
+    // hole; whatever the reads did not fill of those is zeroed. latency,
+    // if given, gets each run's time from queueing to completion.
+    void File::read_from_disk(const Inode &inode, IOEngine &io, std::vector<PageCache::LoadRun> &runs,
+                              LatencyHistogram *latency)
+    {
+        int fd = inode.file_descriptor();
+        LatencyHistogram::Clock::time_point start = LatencyHistogram::Clock::now();
+
+        const uint64_t size = inode.size();
+
+        for (PageCache::LoadRun &run : runs)
+        {
+            if (fd < 0)
+            {
+                run.complete(0);
+                continue;
+            }
+
+            uint64_t run_start = run.first_page * Page::PAGE_SIZE;
+            uint64_t in_file = size > run_start ? size - run_start : 0;
+            queue_run_read(std::make_shared<RunRead>(RunRead{&io, fd, inode.direct_io(), run_start, in_file,
+                                                             run.frames, run.complete, latency, start}));
         }
 
-        ssize_t result = pwrite(inode_->file_descriptor(), buffer, count, offset);
-        return result > 0 ? result : 0;
+        io.submit();
     }
 
 }
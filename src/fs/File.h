@@ -2,6 +2,10 @@
 
 #include "Inode.h"
 #include "../cache/PageCache.h"
+#include "../io/IOEngine.h"
+#include "../io/Readahead.h"
+#include "../io/Writeback.h"
+#include "../scheduler/Async.h"
 #include <memory>
 #include <vector>
 #include <mutex>
@@ -19,7 +23,13 @@ namespace pagecache
     class File
     {
     public:
-        File(std::shared_ptr<Inode> inode, FileMode mode, std::shared_ptr<PageCache> cache);
+        // Without an I/O engine the file reads synchronously with preadv;
+        // without a writeback engine writes are not throttled and sync()
+        // and sync_range() do nothing; without readahead read() loads only
+        // what it returns.
+        File(std::shared_ptr<Inode> inode, FileMode mode, std::shared_ptr<PageCache> cache,
+             std::shared_ptr<IOEngine> io = nullptr, std::shared_ptr<WritebackEngine> writeback = nullptr,
+             std::shared_ptr<Readahead> readahead = nullptr);
         ~File();
 
         std::shared_ptr<Inode> inode() const { return inode_; }
@@ -30,18 +40,53 @@ namespace pagecache
         size_t read(uint8_t *buffer, size_t count);
         size_t write(const uint8_t *buffer, size_t count);
 
+        // Zero-copy read of [offset, offset + count), clipped to the file
+        // size: one pinned reference per page, each narrowed to the bytes
+        // it contributes. The pages stay resident until the references are
+        // dropped, so callers should bound count well below the cache size.
+        // Does not move the file offset.
+        std::vector<PageRef> read_pages(uint64_t offset, size_t count);
+
+        // Awaitable read(), write() and sync() for coroutines on an
+        // EventLoop, at an explicit offset; the file offset does not move.
+        // A read that hits completes without suspending. Misses go to the
+        // I/O engine, which should be asynchronous, and the coroutine
+        // resumes on its loop once they land. A throttled write pauses on
+        // the loop rather than sleeping, and a sync runs on the writeback
+        // pool. The file and the buffer must outlive the operation.
+        Async<size_t> read_async(uint64_t offset, uint8_t *buffer, size_t count);
+        Async<size_t> write_async(uint64_t offset, const uint8_t *buffer, size_t count);
+        Async<int> sync_async();
+
         void seek(uint64_t offset) { offset_ = offset; }
-        void sync();
+        // Drops readahead windows still queued for this file, as on close.
+        void cancel_readahead();
+        // Write back this file's dirty pages, all of them or those
+        // overlapping [offset, offset + length), and fdatasync() the file.
+        // Return 0, or -errno if writeback of the file has failed since it
+        // was last synced; see WritebackEngine::sync_range().
+        int sync();
+        int sync_range(uint64_t offset, uint64_t length);
 
     private:
         std::shared_ptr<Inode> inode_;
         FileMode mode_;
         uint64_t offset_;
         std::shared_ptr<PageCache> cache_;
+        std::shared_ptr<IOEngine> io_;
+        std::shared_ptr<WritebackEngine> writeback_;
+        DirtyThrottle::Writer dirty_pacing_;
+        std::shared_ptr<Readahead> readahead_;
+        ReadaheadStreams ra_streams_;
+        std::shared_ptr<Readahead::FileQueue> ra_queue_;
         mutable std::mutex file_lock_;
 
-        size_t read_from_disk(uint8_t *buffer, uint64_t offset, size_t count);
-        size_t write_to_disk(const uint8_t *buffer, uint64_t offset, size_t count);
+        std::vector<PageRef> pin_range(uint64_t offset, uint64_t end, bool fill, bool *missed = nullptr);
+        std::shared_ptr<Page> start_load(uint64_t offset, uint64_t end, bool &missed);
+        size_t write_batch(uint64_t offset, uint64_t end, const uint8_t *buffer, size_t &dirtied);
+        static void read_from_disk(const Inode &inode, IOEngine &io, std::vector<PageCache::LoadRun> &runs,
+                                   LatencyHistogram *latency = nullptr);
+        void read_ahead(uint64_t offset, uint64_t end);
     };
 
 }
@@ -4,7 +4,7 @@ namespace pagecache
 {
 
     Inode::Inode(uint64_t ino, const std::string &path)
-        : ino_(ino), path_(path), size_(0), fd_(-1), open_count_(0)
+        : ino_(ino), path_(path), size_(0), fd_(-1), direct_io_(false), writeback_error_(0), open_count_(0)
     {
     }
 
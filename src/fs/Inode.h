@@ -1,8 +1,10 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <string>
 #include <memory>
+#include <mutex>
 
 namespace pagecache
 {
@@ -16,12 +18,43 @@ namespace pagecache
         uint64_t ino() const { return ino_; }
         const std::string &path() const { return path_; }
 
-        uint64_t size() const { return size_; }
-        void set_size(uint64_t size) { size_ = size; }
+        // Writers store a new size before dirtying the pages behind it, so
+        // writeback that reads the size after taking a dirty page sees at
+        // least the size the page was written under.
+        uint64_t size() const { return size_.load(std::memory_order_acquire); }
+        void set_size(uint64_t size) { size_.store(size, std::memory_order_release); }
+        // Raises the size to at least size; concurrent writers never move
+        // it back.
+        void extend_size(uint64_t size)
+        {
+            uint64_t current = size_.load(std::memory_order_relaxed);
+            while (current < size &&
+                   !size_.compare_exchange_weak(current, size, std::memory_order_release, std::memory_order_relaxed))
+            {
+            }
+        }
 
         int file_descriptor() const { return fd_; }
         void set_file_descriptor(int fd) { fd_ = fd; }
 
+        // Whether the descriptor was opened with O_DIRECT. Direct I/O must
+        // move whole, aligned pages: reads of the tail page come back short
+        // and writes of it are padded to a page and trimmed with ftruncate.
+        bool direct_io() const { return direct_io_; }
+        void set_direct_io(bool direct) { direct_io_ = direct; }
+        // Held by writeback across direct writes and the trim that follows
+        // them, so a trim never cuts off pages another writeback has just
+        // written for a larger size.
+        std::mutex &writeback_lock() { return writeback_lock_; }
+        // The first writeback failure since the file was last synced, as
+        // -errno, held until a sync reports it.
+        void record_writeback_error(int error)
+        {
+            int none = 0;
+            writeback_error_.compare_exchange_strong(none, error, std::memory_order_relaxed);
+        }
+        int take_writeback_error() { return writeback_error_.exchange(0, std::memory_order_relaxed); }
+
         uint64_t open_count() const { return open_count_; }
         void increment_open_count() { open_count_++; }
         void decrement_open_count()
@@ -33,8 +66,11 @@ namespace pagecache
     private:
         uint64_t ino_;
         std::string path_;
-        uint64_t size_;
+        std::atomic<uint64_t> size_;
         int fd_;
+        bool direct_io_;
+        std::mutex writeback_lock_;
+        std::atomic<int> writeback_error_;
         uint64_t open_count_;
     };
 
@@ -0,0 +1,98 @@
+#include "../io/DirtyThrottle.h"
+#include <algorithm>
+
+namespace pagecache
+{
+
+    namespace
+    {
+        constexpr std::chrono::milliseconds SAMPLE_INTERVAL{200};
+        // Older samples span time writeback may have sat idle.
+        constexpr std::chrono::seconds STALE_SAMPLE{1};
+    }
+
+    DirtyThrottle::DirtyThrottle(size_t background_pages, size_t hard_pages)
+        : written_(0), bandwidth_(INITIAL_BANDWIDTH), sampled_written_(0)
+    {
+        set_limits(background_pages, hard_pages);
+    }
+
+    void DirtyThrottle::set_limits(size_t background_pages, size_t hard_pages)
+    {
+        background_.store(background_pages, std::memory_order_relaxed);
+        hard_.store(std::max(hard_pages, background_pages + 1), std::memory_order_relaxed);
+    }
+
+    DirtyThrottle::Clock::duration DirtyThrottle::pause_for(Writer &writer, size_t pages, size_t dirty)
+    {
+        Clock::time_point now = Clock::now();
+        size_t freerun = freerun_limit();
+        size_t hard = hard_limit();
+        if (dirty <= freerun)
+        {
+            writer.dirtied = 0;
+            writer.window_start = now;
+            return Clock::duration::zero();
+        }
+
+        update_bandwidth(now);
+        if (writer.dirtied == 0)
+        {
+            writer.window_start = now;
+        }
+        writer.dirtied += pages;
+
+        if (dirty >= hard)
+        {
+            writer.dirtied = 0;
+            writer.window_start = now + MAX_PAUSE;
+            return MAX_PAUSE;
+        }
+
+        double ratio = double(hard - dirty) / double(hard - freerun);
+        double rate = std::max(1.0, double(write_bandwidth()) * ratio);
+        auto owed = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(writer.dirtied / rate));
+        Clock::duration elapsed = now - writer.window_start;
+        Clock::duration pause = owed - elapsed;
+
+        if (pause < MIN_PAUSE)
+        {
+            // Within its rate. A writer this far behind is dirtying slower
+            // than its rate, so start measuring it afresh.
+            if (elapsed > MAX_PAUSE)
+            {
+                writer.dirtied = 0;
+                writer.window_start = now;
+            }
+            return Clock::duration::zero();
+        }
+
+        pause = std::min<Clock::duration>(pause, MAX_PAUSE);
+        writer.dirtied = 0;
+        writer.window_start = now + pause;
+        return pause;
+    }
+
+    // Only runs while writers are being paced, when writeback has more than
+    // enough to do, so pages written per second is what the disk sustains.
+    void DirtyThrottle::update_bandwidth(Clock::time_point now)
+    {
+        std::unique_lock<std::mutex> lock(sample_lock_, std::try_to_lock);
+        if (!lock || now - sampled_at_ < SAMPLE_INTERVAL)
+        {
+            return;
+        }
+
+        uint64_t written = written_pages();
+        if (now - sampled_at_ < STALE_SAMPLE)
+        {
+            double seconds = std::chrono::duration<double>(now - sampled_at_).count();
+            uint64_t sample = uint64_t((written - sampled_written_) / seconds);
+            uint64_t smoothed = (3 * write_bandwidth() + sample) / 4;
+            bandwidth_.store(std::max(smoothed, MIN_BANDWIDTH), std::memory_order_relaxed);
+        }
+        sampled_at_ = now;
+        sampled_written_ = written;
+    }
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace pagecache
+{
+
+    // Paces writers as dirty pages build up, after Linux's
+    // balance_dirty_pages(). Writers run free until dirty pages pass the
+    // midpoint of the background and hard limits. Beyond it each writer is
+    // held to the measured write bandwidth, scaled down linearly to zero at
+    // the hard limit. Every writer gets the same rate, so N busy writers
+    // settle where each gets 1/N of the bandwidth. A writer that dirties
+    // pages more slowly than its rate is never paused.
+    class DirtyThrottle
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        static constexpr std::chrono::milliseconds MIN_PAUSE{1};
+        static constexpr std::chrono::milliseconds MAX_PAUSE{200};
+        // Pages per second assumed until writeback has been measured
+        // (100MB/s), and the floor the estimate never drops below.
+        static constexpr uint64_t INITIAL_BANDWIDTH = 25600;
+        static constexpr uint64_t MIN_BANDWIDTH = 64;
+
+        // Pacing state of one writer, owned by the writer's thread.
+        struct Writer
+        {
+            Clock::time_point window_start{};
+            size_t dirtied = 0;
+        };
+
+        DirtyThrottle(size_t background_pages, size_t hard_pages);
+
+        // hard_pages is raised above background_pages if need be.
+        void set_limits(size_t background_pages, size_t hard_pages);
+        size_t background_limit() const { return background_.load(std::memory_order_relaxed); }
+        size_t hard_limit() const { return hard_.load(std::memory_order_relaxed); }
+        size_t freerun_limit() const { return (background_limit() + hard_limit()) / 2; }
+
+        // Pages that reached the disk; feeds the bandwidth estimate.
+        void record_written(size_t pages) { written_.fetch_add(pages, std::memory_order_relaxed); }
+        uint64_t written_pages() const { return written_.load(std::memory_order_relaxed); }
+        uint64_t write_bandwidth() const { return bandwidth_.load(std::memory_order_relaxed); }
+
+        // The writer has just dirtied pages more pages, with dirty pages
+        // dirty in the cache. Returns how long it should sleep; zero below
+        // the freerun limit or while the writer is within its rate.
+        Clock::duration pause_for(Writer &writer, size_t pages, size_t dirty);
+
+    private:
+        std::atomic<size_t> background_;
+        std::atomic<size_t> hard_;
+        std::atomic<uint64_t> written_;
+        std::atomic<uint64_t> bandwidth_;
+
+        std::mutex sample_lock_;
+        Clock::time_point sampled_at_;
+        uint64_t sampled_written_;
+
+        void update_bandwidth(Clock::time_point now);
+    };
+
+}
@@ -0,0 +1,403 @@
+#include "../io/IOEngine.h"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define PAGECACHE_HAVE_IO_URING 1
+#endif
+
+namespace pagecache
+{
+
+    ssize_t IOEngine::read(int fd, uint64_t offset, const struct iovec *iov, size_t iovcnt)
+    {
+        std::promise<ssize_t> result;
+        queue_read(fd, offset, iov, iovcnt, [&result](ssize_t res)
+                   { result.set_value(res); });
+        submit();
+        return result.get_future().get();
+    }
+
+    ssize_t IOEngine::write(int fd, uint64_t offset, const struct iovec *iov, size_t iovcnt)
+    {
+        std::promise<ssize_t> result;
+        queue_write(fd, offset, iov, iovcnt, [&result](ssize_t res)
+                    { result.set_value(res); });
+        submit();
+        return result.get_future().get();
+    }
+
+    void SyncIOEngine::queue_read(int fd, uint64_t offset, const struct iovec *iov, size_t iovcnt,
+                                  Completion done)
+    {
+        ssize_t result = preadv(fd, iov, (int)iovcnt, offset);
+        done(result < 0 ? -errno : result);
+    }
+
+    void SyncIOEngine::queue_write(int fd, uint64_t offset, const struct iovec *iov, size_t iovcnt,
+                                   Completion done)
+    {
+        ssize_t result = pwritev(fd, iov, (int)iovcnt, offset);
+        done(result < 0 ? -errno : result);
+    }
+
+#ifdef PAGECACHE_HAVE_IO_URING
+
+    namespace
+    {
+        int io_uring_setup(unsigned entries, struct io_uring_params *params)
+        {
+            return (int)syscall(__NR_io_uring_setup, entries, params);
+        }
+
+        int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+        {
+            return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+        }
+
+        int io_uring_register(int fd, unsigned opcode, const void *arg, unsigned nr_args)
+        {
+            return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+        }
+
+        inline unsigned load_acquire(const unsigned *p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+        inline void store_release(unsigned *p, unsigned v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+    }
+
+    // io_uring driven through the raw system calls. Any thread may queue;
+    // the queue lock serialises access to the submission ring. A dedicated
+    // thread blocks in io_uring_enter for completions and runs the
+    // callbacks. Requests in flight are capped at the completion ring size
+    // so completions can never overflow it, except for follow-ups a callback
+    // queues from the completion thread, which cannot wait on itself; those
+    // go past the cap, and the kernel holds any overflow until reaped.
+    class UringIOEngine : public IOEngine
+    {
+    public:
+        static std::shared_ptr<UringIOEngine> create(unsigned queue_depth,
+                                                     std::shared_ptr<PageFramePool> pool)
+        {
+            struct io_uring_params params;
+            std::memset(&params, 0, sizeof(params));
+            int fd = io_uring_setup(queue_depth, &params);
+            if (fd < 0)
+            {
+                return nullptr;
+            }
+
+            std::shared_ptr<UringIOEngine> engine(new UringIOEngine(fd, params));
+            if (!engine->map_rings())
+            {
+                return nullptr;
+            }
+            engine->register_pool(std::move(pool));
+            engine->reaper_ = std::thread(&UringIOEngine::reap_loop, engine.get());
+            return engine;
+        }
+
+        ~UringIOEngine() override
+        {
+            if (reaper_.joinable())
+            {
+                // Completes once everything queued before it has.
+                {
+                    std::lock_guard<std::mutex> lock(sq_lock_);
+                    struct io_uring_sqe *sqe = next_sqe();
+                    sqe->opcode = IORING_OP_NOP;
+                    sqe->user_data = 0;
+                    submit_locked();
+                }
+                reaper_.join();
+            }
+            if (sqes_)
+            {
+                munmap(sqes_, params_.sq_entries * sizeof(struct io_uring_sqe));
+            }
+            if (cq_ring_ && cq_ring_ != sq_ring_)
+            {
+                munmap(cq_ring_, cq_ring_size_);
+            }
+            if (sq_ring_)
+            {
+                munmap(sq_ring_, sq_ring_size_);
+            }
+            close(fd_);
+        }
+
+        void queue_read(int fd, uint64_t offset, const struct iovec *iov, size_t iovcnt,
+                        Completion done) override
+        {
+            queue(IORING_OP_READV, IORING_OP_READ_FIXED, fd, offset, iov, iovcnt, std::move(done));
+        }
+
+        void queue_write(int fd, uint64_t offset, const struct iovec *iov, size_t iovcnt,
+                         Completion done) override
+        {
+            queue(IORING_OP_WRITEV, IORING_OP_WRITE_FIXED, fd, offset, iov, iovcnt, std::move(done));
+        }
+
+        void submit() override
+        {
+            std::lock_guard<std::mutex> lock(sq_lock_);
+            submit_locked();
+        }
+
+        const char *name() const override { return "io_uring"; }
+        unsigned queue_depth() const override { return params_.sq_entries; }
+        bool registered_buffers() const override { return pool_ != nullptr; }
+
+    private:
+        struct Request
+        {
+            Completion done;
+            std::vector<struct iovec> iov;
+        };
+
+        int fd_;
+        struct io_uring_params params_;
+        void *sq_ring_ = nullptr;
+        void *cq_ring_ = nullptr;
+        size_t sq_ring_size_ = 0;
+        size_t cq_ring_size_ = 0;
+        struct io_uring_sqe *sqes_ = nullptr;
+        unsigned *sq_head_ = nullptr;
+        unsigned *sq_tail_ = nullptr;
+        unsigned *sq_array_ = nullptr;
+        unsigned sq_mask_ = 0;
+        unsigned *cq_head_ = nullptr;
+        unsigned *cq_tail_ = nullptr;
+        unsigned cq_mask_ = 0;
+        struct io_uring_cqe *cqes_ = nullptr;
+
+        std::shared_ptr<PageFramePool> pool_;
+        std::thread reaper_;
+
+        std::mutex sq_lock_;
+        unsigned unsubmitted_ = 0;
+        std::mutex inflight_lock_;
+        std::condition_variable inflight_cv_;
+        unsigned inflight_ = 0;
+
+        UringIOEngine(int fd, const struct io_uring_params &params)
+            : fd_(fd), params_(params)
+        {
+        }
+
+        bool map_rings()
+        {
+            sq_ring_size_ = params_.sq_off.array + params_.sq_entries * sizeof(unsigned);
+            cq_ring_size_ = params_.cq_off.cqes + params_.cq_entries * sizeof(struct io_uring_cqe);
+            bool single_mmap = params_.features & IORING_FEAT_SINGLE_MMAP;
+            if (single_mmap)
+            {
+                sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+            }
+
+            void *sq = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            fd_, IORING_OFF_SQ_RING);
+            if (sq == MAP_FAILED)
+            {
+                return false;
+            }
+            sq_ring_ = sq;
+
+            void *cq = sq;
+            if (!single_mmap)
+            {
+                cq = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          fd_, IORING_OFF_CQ_RING);
+                if (cq == MAP_FAILED)
+                {
+                    return false;
+                }
+            }
+            cq_ring_ = cq;
+
+            void *sqes = mmap(nullptr, params_.sq_entries * sizeof(struct io_uring_sqe),
+                              PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+            if (sqes == MAP_FAILED)
+            {
+                return false;
+            }
+            sqes_ = static_cast<struct io_uring_sqe *>(sqes);
+
+            uint8_t *sq_base = static_cast<uint8_t *>(sq_ring_);
+            sq_head_ = reinterpret_cast<unsigned *>(sq_base + params_.sq_off.head);
+            sq_tail_ = reinterpret_cast<unsigned *>(sq_base + params_.sq_off.tail);
+            sq_mask_ = *reinterpret_cast<unsigned *>(sq_base + params_.sq_off.ring_mask);
+            sq_array_ = reinterpret_cast<unsigned *>(sq_base + params_.sq_off.array);
+
+            uint8_t *cq_base = static_cast<uint8_t *>(cq_ring_);
+            cq_head_ = reinterpret_cast<unsigned *>(cq_base + params_.cq_off.head);
+            cq_tail_ = reinterpret_cast<unsigned *>(cq_base + params_.cq_off.tail);
+            cq_mask_ = *reinterpret_cast<unsigned *>(cq_base + params_.cq_off.ring_mask);
+            cqes_ = reinterpret_cast<struct io_uring_cqe *>(cq_base + params_.cq_off.cqes);
+            return true;
+        }
+
+        // Registering pins the pool's memory for the life of the ring; when
+        // the memlock limit forbids it every request goes the vectored way.
+        void register_pool(std::shared_ptr<PageFramePool> pool)
+        {
+            if (!pool)
+            {
+                return;
+            }
+            struct iovec region = {pool->base(), pool->region_size()};
+            if (io_uring_register(fd_, IORING_REGISTER_BUFFERS, &region, 1) == 0)
+            {
+                pool_ = std::move(pool);
+            }
+        }
+
+        void queue(uint8_t vectored_op, uint8_t fixed_op, int fd, uint64_t offset,
+                   const struct iovec *iov, size_t iovcnt, Completion done)
+        {
+            Request *request = new Request{std::move(done), std::vector<struct iovec>(iov, iov + iovcnt)};
+
+            std::lock_guard<std::mutex> lock(sq_lock_);
+            {
+                std::unique_lock<std::mutex> inflight(inflight_lock_);
+                if (inflight_ >= params_.cq_entries && std::this_thread::get_id() != reaper_.get_id())
+                {
+                    inflight.unlock();
+                    submit_locked();
+                    inflight.lock();
+                    inflight_cv_.wait(inflight, [this]
+                                      { return inflight_ < params_.cq_entries; });
+                }
+                inflight_++;
+            }
+
+            struct io_uring_sqe *sqe = next_sqe();
+            sqe->fd = fd;
+            sqe->off = offset;
+            sqe->user_data = reinterpret_cast<uint64_t>(request);
+
+            // Only a single non-empty buffer can go through the fixed op.
+            const uint8_t *base = iovcnt == 1 ? static_cast<const uint8_t *>(request->iov[0].iov_base) : nullptr;
+            if (pool_ && base && request->iov[0].iov_len > 0 && pool_->contains(base) &&
+                pool_->contains(base + request->iov[0].iov_len - 1))
+            {
+                sqe->opcode = fixed_op;
+                sqe->addr = reinterpret_cast<uint64_t>(base);
+                sqe->len = (uint32_t)request->iov[0].iov_len;
+                sqe->buf_index = 0;
+            }
+            else
+            {
+                sqe->opcode = vectored_op;
+                sqe->addr = reinterpret_cast<uint64_t>(request->iov.data());
+                sqe->len = (uint32_t)iovcnt;
+            }
+        }
+
+        // Called with sq_lock_ held. Flushes the ring first if it is full.
+        struct io_uring_sqe *next_sqe()
+        {
+            unsigned tail = *sq_tail_;
+            if (tail - load_acquire(sq_head_) == params_.sq_entries)
+            {
+                submit_locked();
+            }
+
+            unsigned index = tail & sq_mask_;
+            struct io_uring_sqe *sqe = &sqes_[index];
+            std::memset(sqe, 0, sizeof(*sqe));
+            sq_array_[index] = index;
+            store_release(sq_tail_, tail + 1);
+            unsubmitted_++;
+            return sqe;
+        }
+
+        void submit_locked()
+        {
+            while (unsubmitted_ > 0)
+            {
+                int submitted = io_uring_enter(fd_, unsubmitted_, 0, 0);
+                if (submitted < 0)
+                {
+                    if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                    {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    break;
+                }
+                unsubmitted_ -= submitted;
+            }
+        }
+
+        void reap_loop()
+        {
+            bool stopping = false;
+            for (;;)
+            {
+                unsigned head = *cq_head_;
+                unsigned tail = load_acquire(cq_tail_);
+                if (head == tail)
+                {
+                    if (stopping)
+                    {
+                        std::lock_guard<std::mutex> lock(inflight_lock_);
+                        if (inflight_ == 0)
+                        {
+                            return;
+                        }
+                    }
+                    io_uring_enter(fd_, 0, 1, IORING_ENTER_GETEVENTS);
+                    continue;
+                }
+
+                for (; head != tail; ++head)
+                {
+                    const struct io_uring_cqe &cqe = cqes_[head & cq_mask_];
+                    Request *request = reinterpret_cast<Request *>(cqe.user_data);
+                    int result = cqe.res;
+                    store_release(cq_head_, head + 1);
+
+                    if (!request)
+                    {
+                        stopping = true;
+                        continue;
+                    }
+
+                    request->done(result);
+                    delete request;
+                    {
+                        std::lock_guard<std::mutex> lock(inflight_lock_);
+                        inflight_--;
+                    }
+                    inflight_cv_.notify_all();
+                }
+            }
+        }
+    };
+
+#endif
+
+    std::shared_ptr<IOEngine> IOEngine::create(unsigned queue_depth, std::shared_ptr<PageFramePool> pool)
+    {
+#ifdef PAGECACHE_HAVE_IO_URING
+        if (auto engine = UringIOEngine::create(std::max(queue_depth, 1u), std::move(pool)))
+        {
+            return engine;
+        }
+#else
+        (void)queue_depth;
+        (void)pool;
+#endif
+        return std::make_shared<SyncIOEngine>();
+    }
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "../cache/PageFramePool.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+namespace pagecache
+{
+
+    // Asynchronous block I/O against file descriptors. Requests queue up
+    // until submit() hands the whole batch to the kernel; each completion
+    // callback receives the preadv/pwritev-style result (bytes transferred
+    // or -errno) and may run on the engine's completion thread.
+    class IOEngine
+    {
+    public:
+        using Completion = std::function<void(ssize_t result)>;
+
+        // An io_uring engine when the kernel supports one, otherwise a
+        // synchronous engine that completes each request as it is queued.
+        // Frames of the pool, if given, are registered with the ring so
+        // single-frame requests skip per-I/O page pinning.
+        static std::shared_ptr<IOEngine> create(unsigned queue_depth = 128,
+                                                std::shared_ptr<PageFramePool> pool = nullptr);
+
+        virtual ~IOEngine() = default;
+
+        // iov is copied, so it may go out of scope once the call returns.
+        virtual void queue_read(int fd, uint64_t offset, const struct iovec *iov, size_t iovcnt,
+                                Completion done) = 0;
+        virtual void queue_write(int fd, uint64_t offset, const struct iovec *iov, size_t iovcnt,
+                                 Completion done) = 0;
+        virtual void submit() = 0;
+
+        virtual const char *name() const = 0;
+        virtual unsigned queue_depth() const = 0;
+        virtual bool registered_buffers() const { return false; }
+
+        // Queues, submits and waits for a single request.
+        ssize_t read(int fd, uint64_t offset, const struct iovec *iov, size_t iovcnt);
+        ssize_t write(int fd, uint64_t offset, const struct iovec *iov, size_t iovcnt);
+    };
+
+    // Runs each request with preadv/pwritev on the queueing thread.
+    class SyncIOEngine : public IOEngine
+    {
+    public:
+        void queue_read(int fd, uint64_t offset, const struct iovec *iov, size_t iovcnt,
+                        Completion done) override;
+        void queue_write(int fd, uint64_t offset, const struct iovec *iov, size_t iovcnt,
+                         Completion done) override;
+        void submit() override {}
+
+        const char *name() const override { return "sync"; }
+        unsigned queue_depth() const override { return 1; }
+    };
+
+}
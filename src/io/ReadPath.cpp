@@ -19,14 +19,14 @@ namespace pagecache
 
             auto loader = [](uint8_t *)
             { return true; };
-            auto page = cache->get_or_load(file_id, page_index, loader);
+            PageRef page = cache->pin_or_load(file_id, page_index, loader);
 
             if (!page)
             {
                 break;
             }
 
-            std::memcpy(buffer + bytes_read, page->data() + page_offset, to_read);
+            std::memcpy(buffer + bytes_read, page.data() + page_offset, to_read);
 
             bytes_read += to_read;
             remaining -= to_read;
@@ -51,15 +51,15 @@ namespace pagecache
 
             auto loader = [](uint8_t *)
             { return true; };
-            auto page = cache->get_or_load(file_id, page_index, loader);
+            PageRef page = cache->pin_or_load(file_id, page_index, loader);
 
             if (!page)
             {
                 break;
             }
 
-            std::memcpy(page->data() + page_offset, buffer + bytes_written, to_write);
-            page->set_state(PageState::Dirty);
+            std::memcpy(page.page()->data() + page_offset, buffer + bytes_written, to_write);
+            cache->mark_dirty(page.page());
 
             bytes_written += to_write;
             remaining -= to_write;
@@ -1,40 +1,378 @@
 #include "../io/Readahead.h"
+#include <algorithm>
 
 namespace pagecache
 {
 
-    Readahead::Readahead(std::shared_ptr<PageCache> cache)
-        : cache_(cache), last_file_id_(0), last_page_index_(0), window_size_(8)
+    namespace
     {
+        using Stream = ReadaheadStreams::Stream;
+
+        // Furthest apart two reads may be and still pair up as a stream.
+        constexpr uint64_t MAX_STRIDE = 65536;
+
+        uint64_t distance(uint64_t a, uint64_t b)
+        {
+            return a > b ? a - b : b - a;
+        }
+
+        bool follows(const Stream &stream, uint64_t first_page)
+        {
+            if (stream.count == 0)
+            {
+                return false;
+            }
+            return first_page == stream.last_page + stream.count ||
+                   (stream.hits > 0 && int64_t(first_page - stream.last_page) == stream.stride);
+        }
     }
 
+    struct Readahead::Job
+    {
+        // Pages the job's runs span.
+        uint64_t first_page = UINT64_MAX;
+        uint64_t last_page = 0;
+        std::vector<PageCache::LoadRun> runs;
+        PageCache::BatchLoader loader;
+        std::shared_ptr<FileQueue> queue;
+        std::shared_ptr<PageCache> cache;
+        std::shared_ptr<std::atomic<bool>> stopping;
+        std::atomic<bool> started{false};
+        std::atomic<bool> expedited{false};
+    };
+
+    Readahead::Readahead(std::shared_ptr<PageCache> cache, size_t max_window, size_t num_threads,
+                         std::shared_ptr<IOThreadPool> pool)
+        : cache_(cache), max_window_(max_window),
+          stopping_(std::make_shared<std::atomic<bool>>(false)),
+          in_flight_(std::make_shared<std::atomic<size_t>>(0)),
+          pool_(pool ? std::move(pool) : std::make_shared<IOThreadPool>(std::max<size_t>(1, num_threads)))
+    {
+    }
+
+    // Jobs still queued on a shared pool find stopping set and drop their
+    // windows.
     Readahead::~Readahead()
     {
+        stopping_->store(true);
+    }
+
+    Readahead::Window Readahead::on_read(ReadaheadState &ra, uint64_t first_page, size_t count,
+                                         bool cached) const
+    {
+        uint64_t last_page = first_page + count - 1;
+        bool sequential = first_page == 0 || first_page == ra.prev_page || first_page == ra.prev_page + 1;
+        bool in_window = ra.size > 0 && first_page >= ra.start && first_page < ra.start + ra.size;
+        bool at_marker = ra.async_size > 0 && ra.marker() >= first_page && ra.marker() <= last_page;
+        ra.prev_page = last_page;
+
+        if (max_window_ == 0 || (cached && !at_marker))
+        {
+            return {};
+        }
+
+        Window window;
+        if (!cached && in_window)
+        {
+            // Read ahead, then evicted before the reader got there.
+            ra.start = first_page;
+            ra.size = std::max(std::min(count, max_window_), ra.size / 2);
+            ra.async_size = ra.size > count ? ra.size - count : 0;
+        }
+        else if (at_marker || (ra.size > 0 && first_page == ra.start + ra.size))
+        {
+            ra.start += ra.size;
+            ra.size = next_size(ra.size);
+            ra.async_size = ra.size;
+            window.async = cached;
+        }
+        else if (sequential)
+        {
+            ra.start = first_page;
+            ra.size = initial_size(count);
+            ra.async_size = ra.size > count ? ra.size - count : ra.size;
+        }
+        else
+        {
+            ra.size = 0;
+            ra.async_size = 0;
+            return {};
+        }
+
+        window.start = ra.start;
+        window.size = ra.size;
+        return window;
+    }
+
+    std::vector<Readahead::Window> Readahead::on_read(ReadaheadStreams &streams, uint64_t first_page,
+                                                      size_t count, bool cached) const
+    {
+        streams.clock++;
+
+        Stream *stream = nullptr;
+        for (Stream &candidate : streams.streams)
+        {
+            if (follows(candidate, first_page))
+            {
+                stream = &candidate;
+                break;
+            }
+        }
+
+        bool contiguous = false;
+        if (stream)
+        {
+            contiguous = first_page == stream->last_page + stream->count;
+            stream->stride = int64_t(first_page - stream->last_page);
+            stream->hits++;
+        }
+        else
+        {
+            // A new stream, in the least recently used slot. Its stride is
+            // guessed from the nearest stream read only once so far and
+            // taken up if its next read keeps to it.
+            const Stream *nearest = nullptr;
+            Stream *slot = &streams.streams[0];
+            for (Stream &candidate : streams.streams)
+            {
+                uint64_t d = distance(first_page, candidate.last_page);
+                if (candidate.count > 0 && candidate.hits == 0 && d > 0 && d <= MAX_STRIDE &&
+                    (!nearest || d < distance(first_page, nearest->last_page)))
+                {
+                    nearest = &candidate;
+                }
+                if (candidate.last_used < slot->last_used)
+                {
+                    slot = &candidate;
+                }
+            }
+
+            int64_t stride = nearest ? int64_t(first_page - nearest->last_page) : 0;
+            *slot = Stream();
+            stream = slot;
+            stream->stride = stride;
+            stream->hits = nearest ? 1 : 0;
+        }
+        stream->last_page = first_page;
+        stream->count = count;
+        stream->last_used = streams.clock;
+
+        std::vector<Window> windows;
+        if (stream->hits == 0 || contiguous || stream->stride == 0)
+        {
+            Window window = on_read(stream->ra, first_page, count, cached);
+            if (window.size > 0)
+            {
+                windows.push_back(window);
+            }
+            return windows;
+        }
+
+        // Should the stream turn sequential, its window starts afresh.
+        stream->ra = ReadaheadState();
+        stream->ra.prev_page = first_page + count - 1;
+        if (stream->hits < 2)
+        {
+            return windows;
+        }
+        return predict(*stream);
+    }
+
+    // Submits the stream's next reads at its stride, ahead of the reader
+    // by a depth that doubles each time, up to max_window() pages. A new
+    // batch goes out once the reader is halfway through the last one.
+    std::vector<Readahead::Window> Readahead::predict(Stream &stream) const
+    {
+        std::vector<Window> windows;
+        if (stream.ahead > 0)
+        {
+            stream.ahead--;
+        }
+        if (max_window_ == 0 || stream.ahead > stream.depth / 2)
+        {
+            return windows;
+        }
+
+        size_t max_depth = std::max<size_t>(1, max_window_ / stream.count);
+        size_t depth = std::min(max_depth, std::max<size_t>(4, stream.depth * 2));
+        for (size_t k = stream.ahead + 1; k <= depth; ++k)
+        {
+            int64_t page = int64_t(stream.last_page) + int64_t(k) * stream.stride;
+            if (page < 0)
+            {
+                break;
+            }
+            windows.push_back({uint64_t(page), stream.count, true});
+        }
+        stream.ahead = depth;
+        stream.depth = depth;
+
+        std::sort(windows.begin(), windows.end(), [](const Window &a, const Window &b)
+                  { return a.start < b.start; });
+        std::vector<Window> merged;
+        for (const Window &window : windows)
+        {
+            if (!merged.empty() && window.start <= merged.back().start + merged.back().size)
+            {
+                Window &last = merged.back();
+                last.size = std::max(last.start + last.size, window.start + window.size) - last.start;
+                continue;
+            }
+            merged.push_back(window);
+        }
+        return merged;
+    }
+
+    void Readahead::submit(uint64_t file_id, const Window &window, PageCache::BatchLoader loader,
+                           std::shared_ptr<FileQueue> queue)
+    {
+        PageCache::BatchLoader deferred;
+        if (window.async)
+        {
+            if (under_pressure(window.size))
+            {
+                return;
+            }
+            deferred = [this, loader, queue](std::vector<PageCache::LoadRun> &runs)
+            { run_async(std::move(runs), loader, queue); };
+        }
+
+        uint64_t start = window.start;
+        size_t remaining = window.size;
+        while (remaining > 0)
+        {
+            size_t batch = std::min(remaining, cache_->max_range_pages());
+            cache_->prefetch_range(file_id, start, batch, window.async ? deferred : loader);
+            start += batch;
+            remaining -= batch;
+        }
+    }
+
+    bool Readahead::under_pressure(size_t window_pages) const
+    {
+        return dirty_pressure(*cache_) || pages_in_flight() + window_pages > cache_->max_pages() / 4;
     }
 
-    void Readahead::on_sequential_read(uint64_t file_id, uint64_t page_index)
+    bool Readahead::expedite(FileQueue &queue, uint64_t page)
     {
-        if (file_id == last_file_id_ && page_index == last_page_index_ + 1)
+        std::shared_ptr<Job> job;
         {
-            prefetch_pages(file_id, page_index + 1, window_size_);
+            std::lock_guard<std::mutex> lock(queue.lock);
+            for (const std::weak_ptr<Job> &entry : queue.jobs)
+            {
+                std::shared_ptr<Job> candidate = entry.lock();
+                if (candidate && !candidate->started.load() && page >= candidate->first_page &&
+                    page <= candidate->last_page)
+                {
+                    job = std::move(candidate);
+                    break;
+                }
+            }
         }
-        last_file_id_ = file_id;
-        last_page_index_ = page_index;
+        if (!job || job->expedited.exchange(true))
+        {
+            return false;
+        }
+
+        // Whichever of the two copies runs first does the job.
+        pool_->submit([job]()
+                      { run_job(*job); },
+                      IOPriority::Demand);
+        return true;
     }
 
-    void Readahead::prefetch_pages(uint64_t file_id, uint64_t start_page, size_t count)
+    void Readahead::run_job(Job &job)
     {
-        for (size_t i = 0; i < count; ++i)
+        if (job.started.exchange(true))
+        {
+            return;
+        }
+        if (job.stopping->load() || (job.queue && job.queue->cancelled.load()) || dirty_pressure(*job.cache))
         {
-            uint64_t page_index = start_page + i;
-            auto existing_page = cache_->get_page(file_id, page_index);
-            if (!existing_page)
+            for (PageCache::LoadRun &run : job.runs)
             {
-                auto loader = [](uint8_t *)
-                { return true; };
-                cache_->get_or_load(file_id, page_index, loader);
+                run.complete(0);
             }
+            return;
+        }
+        job.loader(job.runs);
+    }
+
+    // Counts the runs' pages in flight until they complete, and queues
+    // them for the pool.
+    void Readahead::run_async(std::vector<PageCache::LoadRun> runs, const PageCache::BatchLoader &loader,
+                              const std::shared_ptr<FileQueue> &queue)
+    {
+        auto job = std::make_shared<Job>();
+        for (PageCache::LoadRun &run : runs)
+        {
+            size_t pages = run.frames.size();
+            job->first_page = std::min(job->first_page, run.first_page);
+            job->last_page = std::max(job->last_page, run.first_page + pages - 1);
+            in_flight_->fetch_add(pages, std::memory_order_relaxed);
+            run.complete = [complete = std::move(run.complete), in_flight = in_flight_, pages](size_t loaded)
+            {
+                complete(loaded);
+                in_flight->fetch_sub(pages, std::memory_order_relaxed);
+            };
+        }
+        job->runs = std::move(runs);
+        job->loader = loader;
+        job->queue = queue;
+        job->cache = cache_;
+        job->stopping = stopping_;
+
+        if (queue)
+        {
+            std::lock_guard<std::mutex> lock(queue->lock);
+            auto &jobs = queue->jobs;
+            jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [](const std::weak_ptr<Job> &entry)
+                                      {
+                std::shared_ptr<Job> queued = entry.lock();
+                return !queued || queued->started.load(); }),
+                       jobs.end());
+            jobs.push_back(job);
+        }
+
+        pool_->submit([job]()
+                      { run_job(*job); },
+                      IOPriority::Readahead);
+    }
+
+    size_t Readahead::initial_size(size_t request) const
+    {
+        size_t size = 1;
+        while (size < request)
+        {
+            size <<= 1;
+        }
+
+        if (size <= max_window_ / 32)
+        {
+            size *= 4;
+        }
+        else if (size <= max_window_ / 4)
+        {
+            size *= 2;
+        }
+        else
+        {
+            size = max_window_;
+        }
+        return std::min(size, max_window_);
+    }
+
+    size_t Readahead::next_size(size_t current) const
+    {
+        if (current < max_window_ / 16)
+        {
+            return std::min(current * 4, max_window_);
+        }
+        if (current <= max_window_ / 2)
+        {
+            return std::min(current * 2, max_window_);
         }
+        return max_window_;
     }
 
 }
@@ -1,28 +1,159 @@
 #pragma once
 
 #include "../cache/PageCache.h"
+#include "../scheduler/IOThreadPool.h"
+#include <array>
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <cstdint>
 
 namespace pagecache
 {
 
+    // Readahead state of one stream, after Linux's file_ra_state: the
+    // window [start, start + size) last read ahead, whose page at
+    // start + size - async_size is the marker that starts the next window
+    // when a reader gets to it.
+    struct ReadaheadState
+    {
+        uint64_t start = 0;
+        size_t size = 0;
+        size_t async_size = 0;
+        uint64_t prev_page = UINT64_MAX;
+
+        uint64_t marker() const { return start + size - async_size; }
+    };
+
+    // Up to MAX_STREAMS access streams of one file, told apart by where
+    // each expects its next read, so that interleaved scans of one file
+    // keep separate patterns. A read that no stream expects starts a new
+    // one, taking its stride (the distance in pages between the starts of
+    // consecutive reads) from the nearest stream seen only once. Streams
+    // that read forward contiguously use the sequential window in ra;
+    // reverse and strided ones predict their next reads once a second
+    // read has kept to the stride.
+    struct ReadaheadStreams
+    {
+        static constexpr size_t MAX_STREAMS = 4;
+
+        struct Stream
+        {
+            uint64_t last_page = 0;
+            size_t count = 0;
+            int64_t stride = 0;
+            // Reads that followed on from the one before.
+            unsigned hits = 0;
+            uint64_t last_used = 0;
+            ReadaheadState ra;
+            // Predicted reads already submitted beyond the last one, and
+            // how far ahead the last prediction reached.
+            size_t ahead = 0;
+            size_t depth = 0;
+        };
+
+        std::array<Stream, MAX_STREAMS> streams;
+        uint64_t clock = 0;
+    };
+
+    // On-demand readahead. A sequential miss opens a window a few times
+    // the request; reaching the window's marker reads the next one ahead
+    // while the current one is still being consumed, growing 4x while
+    // small and 2x after, up to max_window() pages. A miss inside the
+    // window means its pages were evicted unread, so the window restarts
+    // at half the size. Random reads get no readahead.
+    //
+    // Asynchronous windows run on the I/O pool in its Readahead class, so
+    // the triggering read does not wait for them. Their pages are indexed
+    // as loading when the window is submitted; a reader that gets there
+    // before the window has started moves it up to the Demand class
+    // rather than wait its turn behind other files' readahead. A window
+    // still queued is dropped when its file's queue is cancelled or the
+    // cache comes under pressure, which fails its pages out of the cache
+    // again.
     class Readahead
     {
     public:
-        explicit Readahead(std::shared_ptr<PageCache> cache);
+        static constexpr size_t DEFAULT_MAX_WINDOW = 128;
+        static constexpr size_t DEFAULT_THREADS = 2;
+
+        struct Window
+        {
+            uint64_t start = 0;
+            size_t size = 0;
+            // Started from a marker: the reader has its pages already.
+            bool async = false;
+        };
+
+        struct Job;
+
+        // A file's asynchronous windows not yet started. Setting cancelled
+        // drops them.
+        struct FileQueue
+        {
+            std::atomic<bool> cancelled{false};
+            std::mutex lock;
+            std::vector<std::weak_ptr<Job>> jobs;
+        };
+
+        // Windows run on pool, shared with writeback so that its priority
+        // classes order them, or on num_threads threads of its own.
+        explicit Readahead(std::shared_ptr<PageCache> cache, size_t max_window = DEFAULT_MAX_WINDOW,
+                           size_t num_threads = DEFAULT_THREADS, std::shared_ptr<IOThreadPool> pool = nullptr);
         ~Readahead();
 
-        void on_sequential_read(uint64_t file_id, uint64_t page_index);
-        void set_readahead_window(size_t pages) { window_size_ = pages; }
+        void set_max_window(size_t pages) { max_window_ = pages; }
+        size_t max_window() const { return max_window_; }
+
+        // Plans readahead for a read of pages [first_page, first_page +
+        // count) of a stream, given whether first_page is already cached.
+        // Updates the state and returns the window to read ahead, which is
+        // empty when there is none.
+        Window on_read(ReadaheadState &ra, uint64_t first_page, size_t count, bool cached) const;
+
+        // on_read() for a file with several streams: finds or starts the
+        // stream the read belongs to and returns the windows to read
+        // ahead for it. Predicted strided or reverse reads come back as
+        // asynchronous windows, with adjacent ones merged.
+        std::vector<Window> on_read(ReadaheadStreams &streams, uint64_t first_page, size_t count,
+                                    bool cached) const;
+
+        // Starts loading the window's uncached pages through loader
+        // without waiting for them: at once for a synchronous window, whose
+        // first pages the reader is about to take, and on the pool for an
+        // asynchronous one, queued on queue, so the loader must hold on to
+        // whatever it reads with.
+        void submit(uint64_t file_id, const Window &window, PageCache::BatchLoader loader,
+                    std::shared_ptr<FileQueue> queue = nullptr);
+
+        // For a reader about to wait on page: runs the queued window that
+        // loads it as demand I/O. Returns whether there was one.
+        bool expedite(FileQueue &queue, uint64_t page);
+
+        // Too many pages dirty or already being read ahead for more.
+        bool under_pressure(size_t window_pages) const;
+        size_t pages_in_flight() const { return in_flight_->load(std::memory_order_relaxed); }
 
     private:
         std::shared_ptr<PageCache> cache_;
-        uint64_t last_file_id_;
-        uint64_t last_page_index_;
-        size_t window_size_;
+        size_t max_window_;
+        // Shared with jobs and completions, which may run after readahead
+        // is gone.
+        std::shared_ptr<std::atomic<bool>> stopping_;
+        std::shared_ptr<std::atomic<size_t>> in_flight_;
+        std::shared_ptr<IOThreadPool> pool_;
+
+        static bool dirty_pressure(const PageCache &cache)
+        {
+            return cache.dirty_pages() > cache.max_pages() / 2;
+        }
+        static void run_job(Job &job);
+        void run_async(std::vector<PageCache::LoadRun> runs, const PageCache::BatchLoader &loader,
+                       const std::shared_ptr<FileQueue> &queue);
 
-        void prefetch_pages(uint64_t file_id, uint64_t start_page, size_t count);
+        std::vector<Window> predict(ReadaheadStreams::Stream &stream) const;
+        size_t initial_size(size_t request) const;
+        size_t next_size(size_t current) const;
     };
 
 }
@@ -1,13 +1,53 @@
 #include "../io/Writeback.h"
+#include <algorithm>
+#include <cerrno>
 #include <chrono>
+#include <unistd.h>
 
 namespace pagecache
 {
 
-    WritebackEngine::WritebackEngine(std::shared_ptr<PageCache> cache)
-        : cache_(cache), running_(false), dirty_threshold_(8192)
+    namespace
+    {
+        // Counts outstanding pieces of work and lets one thread wait for all
+        // of them.
+        class Latch
+        {
+        public:
+            explicit Latch(size_t count) : count_(count) {}
+
+            void count_down()
+            {
+                std::lock_guard<std::mutex> lock(lock_);
+                if (--count_ == 0)
+                {
+                    cv_.notify_all();
+                }
+            }
+
+            void wait()
+            {
+                std::unique_lock<std::mutex> lock(lock_);
+                cv_.wait(lock, [this]
+                         { return count_ == 0; });
+            }
+
+        private:
+            std::mutex lock_;
+            std::condition_variable cv_;
+            size_t count_;
+        };
+    }
+
+    WritebackEngine::WritebackEngine(std::shared_ptr<PageCache> cache, std::shared_ptr<IOEngine> io,
+                                     size_t num_threads, std::shared_ptr<IOThreadPool> pool)
+        : cache_(cache),
+          io_(io ? std::move(io) : std::make_shared<SyncIOEngine>()),
+          pool_(pool ? std::move(pool) : std::make_shared<IOThreadPool>(std::max<size_t>(1, num_threads))),
+          running_(false),
+          flush_requested_(false),
+          throttle_(cache_->max_pages() / 10, cache_->max_pages() / 5)
     {
-        counters_ = std::make_shared<Counters>();
     }
 
     WritebackEngine::~WritebackEngine()
@@ -35,15 +75,125 @@ namespace pagecache
             running_ = false;
         }
         cv_.notify_one();
+        written_cv_.notify_all();
         if (writeback_thread_.joinable())
         {
             writeback_thread_.join();
+
+            // Write out what the background thread left behind.
+            while (flush_dirty_pages() > 0)
+            {
+            }
+        }
+    }
+
+    int WritebackEngine::fsync(uint64_t file_id)
+    {
+        if (file_id != 0)
+        {
+            return sync_range(file_id, 0, 0);
+        }
+        LatencyHistogram::Clock::time_point start = LatencyHistogram::Clock::now();
+
+        std::vector<std::shared_ptr<Inode>> inodes;
+        {
+            std::lock_guard<std::mutex> lock(inodes_lock_);
+            for (auto &entry : inodes_)
+            {
+                std::shared_ptr<Inode> inode = entry.second.lock();
+                if (inode && inode->file_descriptor() >= 0)
+                {
+                    inodes.push_back(std::move(inode));
+                }
+            }
+        }
+
+        std::vector<int> errors(inodes.size(), 0);
+        Latch done(inodes.size());
+        for (size_t i = 0; i < inodes.size(); ++i)
+        {
+            pool_->submit([this, &inodes, &errors, &done, i]()
+                          {
+                errors[i] = sync_inode(*inodes[i], 0, UINT64_MAX);
+                done.count_down(); },
+                          IOPriority::Sync);
+        }
+        done.wait();
+        cache_->counters()->fsync_latency().record_since(start);
+
+        for (int error : errors)
+        {
+            if (error != 0)
+            {
+                return error;
+            }
+        }
+        return 0;
+    }
+
+    int WritebackEngine::sync_range(uint64_t file_id, uint64_t offset, uint64_t length)
+    {
+        std::shared_ptr<Inode> inode = find_inode(file_id);
+        if (!inode || inode->file_descriptor() < 0)
+        {
+            return 0;
+        }
+
+        LatencyHistogram::Clock::time_point start = LatencyHistogram::Clock::now();
+        uint64_t first_page = offset / Page::PAGE_SIZE;
+        uint64_t last_page = length == 0 || offset + length < offset
+                                 ? UINT64_MAX
+                                 : (offset + length - 1) / Page::PAGE_SIZE;
+        int error = sync_inode(*inode, first_page, last_page);
+        cache_->counters()->fsync_latency().record_since(start);
+        return error;
+    }
+
+    // Like the kernel's TOWRITE tag, the pages to sync are fixed up front.
+    // Written on the calling thread: the caller is waiting anyway, and a
+    // queue of background flushes should not sit in front of it. A page
+    // whose write failed is Dirty again, and its error is on the inode.
+    int WritebackEngine::sync_inode(Inode &inode, uint64_t first_page, uint64_t last_page)
+    {
+        std::vector<std::shared_ptr<Page>> pages = cache_->collect_to_sync(inode.ino(), first_page, last_page);
+        if (!pages.empty())
+        {
+            // Pages another flush has under writeback are skipped here.
+            std::vector<std::shared_ptr<Page>> batch = pages;
+            cache_->counters()->increment_writeback_count(write_file_pages(inode, batch));
+
+            // Whoever has them ends with notify_written(), under lock_.
+            std::unique_lock<std::mutex> lock(lock_);
+            for (const std::shared_ptr<Page> &page : pages)
+            {
+                written_cv_.wait(lock, [&page]
+                                 { return page->state() != PageState::Writeback; });
+            }
+        }
+        if (::fdatasync(inode.file_descriptor()) != 0)
+        {
+            inode.record_writeback_error(-errno);
         }
+        return inode.take_writeback_error();
     }
 
-    void WritebackEngine::fsync(uint64_t file_id)
+    void WritebackEngine::register_inode(const std::shared_ptr<Inode> &inode)
     {
-        flush_dirty_pages();
+        std::lock_guard<std::mutex> lock(inodes_lock_);
+        inodes_[inode->ino()] = inode;
+    }
+
+    void WritebackEngine::unregister_inode(uint64_t ino)
+    {
+        std::lock_guard<std::mutex> lock(inodes_lock_);
+        inodes_.erase(ino);
+    }
+
+    std::shared_ptr<Inode> WritebackEngine::find_inode(uint64_t ino)
+    {
+        std::lock_guard<std::mutex> lock(inodes_lock_);
+        auto it = inodes_.find(ino);
+        return it != inodes_.end() ? it->second.lock() : nullptr;
     }
 
     void WritebackEngine::writeback_loop()
@@ -54,27 +204,252 @@ namespace pagecache
                 std::unique_lock<std::mutex> lock(lock_);
                 cv_.wait_for(lock, std::chrono::milliseconds(100),
                              [this]
-                             { return !running_.load(); });
+                             { return !running_.load() || flush_requested_; });
+                flush_requested_ = false;
+            }
+
+            while (running_.load() && cache_->dirty_pages() > throttle_.background_limit())
+            {
+                if (flush_dirty_pages() == 0)
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    void WritebackEngine::wake_writeback()
+    {
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            if (flush_requested_)
+            {
+                return;
+            }
+            flush_requested_ = true;
+        }
+        cv_.notify_one();
+    }
+
+    void WritebackEngine::balance_dirty_pages(DirtyThrottle::Writer &writer, size_t pages)
+    {
+        size_t dirty = cache_->dirty_pages();
+        if (dirty > throttle_.background_limit())
+        {
+            wake_writeback();
+        }
+
+        if (dirty >= throttle_.hard_limit())
+        {
+            wait_below_hard_limit();
+            return;
+        }
+
+        DirtyThrottle::Clock::duration pause = throttle_.pause_for(writer, pages, dirty);
+        if (pause > DirtyThrottle::Clock::duration::zero())
+        {
+            std::this_thread::sleep_for(pause);
+        }
+    }
+
+    DirtyThrottle::Clock::duration WritebackEngine::dirty_pause(DirtyThrottle::Writer &writer, size_t pages)
+    {
+        size_t dirty = cache_->dirty_pages();
+        if (dirty > throttle_.background_limit())
+        {
+            wake_writeback();
+        }
+        if (dirty >= throttle_.hard_limit())
+        {
+            return DirtyThrottle::MAX_PAUSE;
+        }
+        return throttle_.pause_for(writer, pages, dirty);
+    }
+
+    void WritebackEngine::wait_below_hard_limit()
+    {
+        while (cache_->dirty_pages() >= throttle_.hard_limit())
+        {
+            if (!running_.load())
+            {
+                // No background thread to wait for: write back here.
+                if (flush_dirty_pages() == 0)
+                {
+                    return;
+                }
+                continue;
+            }
+
+            uint64_t written = throttle_.written_pages();
+            std::unique_lock<std::mutex> lock(lock_);
+            bool progressed = written_cv_.wait_for(lock, DirtyThrottle::MAX_PAUSE, [this, written]
+                                                   { return throttle_.written_pages() != written ||
+                                                            !running_.load(); });
+            if (!progressed)
+            {
+                return;
             }
+        }
+    }
+
+    size_t WritebackEngine::flush_dirty_pages()
+    {
+        return flush_pages(cache_->collect_dirty(FLUSH_BATCH_PAGES));
+    }
+
+    size_t WritebackEngine::flush_pages(std::vector<std::shared_ptr<Page>> pages)
+    {
+        std::unordered_map<uint64_t, std::vector<std::shared_ptr<Page>>> by_file;
+        for (auto &page : pages)
+        {
+            by_file[page->file_id()].push_back(std::move(page));
+        }
 
-            if (cache_->dirty_pages() > dirty_threshold_)
+        std::vector<std::pair<std::shared_ptr<Inode>, std::vector<std::shared_ptr<Page>>>> work;
+        for (auto &entry : by_file)
+        {
+            std::shared_ptr<Inode> inode = find_inode(entry.first);
+            if (inode && inode->file_descriptor() >= 0)
             {
-                flush_dirty_pages();
+                work.emplace_back(std::move(inode), std::move(entry.second));
             }
         }
+
+        std::atomic<size_t> written(0);
+        Latch done(work.size());
+        for (auto &item : work)
+        {
+            pool_->submit([this, &item, &written, &done]()
+                          {
+                written += write_file_pages(*item.first, item.second);
+                done.count_down(); },
+                          IOPriority::Background);
+        }
+        done.wait();
+
+        cache_->counters()->increment_writeback_count(written);
+        return written;
     }
 
-    void WritebackEngine::flush_dirty_pages()
+    size_t WritebackEngine::write_file_pages(Inode &inode, std::vector<std::shared_ptr<Page>> &pages)
     {
-        size_t flushed = 0;
-        while (cache_->dirty_pages() > 0 && flushed < 1000)
+        struct Extent
+        {
+            uint64_t first_page;
+            std::vector<std::shared_ptr<Page>> pages;
+            std::vector<struct iovec> iov;
+            size_t bytes = 0;
+        };
+
+        std::sort(pages.begin(), pages.end(), [](const std::shared_ptr<Page> &a, const std::shared_ptr<Page> &b)
+                  { return a->index() < b->index(); });
+
+        const bool direct = inode.direct_io();
+        bool wrote_tail = false;
+        std::vector<Extent> extents;
+
+        // Direct I/O pads the tail page and trims the file back once it is
+        // written; see Inode::writeback_lock().
+        std::unique_lock<std::mutex> direct_lock;
+        if (direct)
         {
-            flushed++;
+            direct_lock = std::unique_lock<std::mutex>(inode.writeback_lock());
         }
-        if (counters_)
+
+        for (auto &page : pages)
         {
-            counters_->increment_writeback_count(flushed);
+            if (!cache_->begin_writeback(page))
+            {
+                continue;
+            }
+
+            // Read once the page is taken, so it is at least the size the
+            // page was dirtied under.
+            const uint64_t size = inode.size();
+            uint64_t start = page->index() * Page::PAGE_SIZE;
+            if (start >= size)
+            {
+                // Nothing of it is in the file: it stays dirty rather than
+                // being reported written.
+                cache_->end_writeback(page, false);
+                continue;
+            }
+
+            // Direct I/O moves whole pages; the file is trimmed back below.
+            size_t length = direct ? Page::PAGE_SIZE : std::min<uint64_t>(Page::PAGE_SIZE, size - start);
+            wrote_tail |= start + Page::PAGE_SIZE > size;
+
+            if (extents.empty() ||
+                extents.back().first_page + extents.back().pages.size() != page->index() ||
+                extents.back().pages.size() == MAX_EXTENT_PAGES)
+            {
+                extents.push_back({page->index(), {}, {}, 0});
+            }
+            Extent &extent = extents.back();
+            extent.iov.push_back({page->data(), length});
+            extent.bytes += length;
+            extent.pages.push_back(page);
+        }
+
+        if (extents.empty())
+        {
+            // Pages past EOF went through Writeback on the way back to Dirty.
+            notify_written(0);
+            return 0;
+        }
+
+        std::atomic<size_t> written(0);
+        Latch done(extents.size());
+        LatencyHistogram &latency = cache_->counters()->writeback_latency();
+        LatencyHistogram::Clock::time_point start = LatencyHistogram::Clock::now();
+        for (Extent &extent : extents)
+        {
+            io_->queue_write(inode.file_descriptor(), extent.first_page * Page::PAGE_SIZE,
+                             extent.iov.data(), extent.iov.size(),
+                             [this, &inode, &extent, &written, &done, &latency, start](ssize_t result)
+                             {
+                latency.record_since(start);
+                bool success = result == (ssize_t)extent.bytes;
+                if (!success)
+                {
+                    // A short write has no errno of its own.
+                    inode.record_writeback_error(result < 0 ? (int)result : -EIO);
+                }
+                for (auto &page : extent.pages)
+                {
+                    cache_->end_writeback(page, success);
+                }
+                if (success)
+                {
+                    written += extent.pages.size();
+                }
+                done.count_down(); });
+        }
+        io_->submit();
+        done.wait();
+
+        // The size may have grown since the tail was written; padding past
+        // it is all that is left to trim.
+        const uint64_t size = inode.size();
+        if (direct && wrote_tail && size % Page::PAGE_SIZE)
+        {
+            // Should this fail, the padding stays until the tail page is
+            // written again.
+            [[maybe_unused]] int trimmed = ftruncate(inode.file_descriptor(), size);
+        }
+        notify_written(written);
+        return written;
+    }
+
+    // Wakes writers waiting on the hard limit and syncs waiting for pages
+    // to leave Writeback.
+    void WritebackEngine::notify_written(size_t pages)
+    {
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            throttle_.record_written(pages);
         }
+        written_cv_.notify_all();
     }
 
 }
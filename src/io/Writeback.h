@@ -1,37 +1,107 @@
 #pragma once
 
 #include "../cache/PageCache.h"
+#include "../fs/Inode.h"
+#include "../io/DirtyThrottle.h"
+#include "../io/IOEngine.h"
 #include "../metrics/Counters.h"
+#include "../scheduler/IOThreadPool.h"
 #include <memory>
 #include <thread>
 #include <atomic>
 #include <condition_variable>
+#include <unordered_map>
+#include <vector>
 
 namespace pagecache
 {
 
+    // Writes dirty pages back to their files. A flush gathers dirty pages,
+    // groups them by inode and hands each inode to the thread pool, which
+    // sorts its pages, coalesces runs of adjacent pages into extents of up
+    // to MAX_EXTENT_PAGES and writes each extent with one vectored write.
+    // Pages are Writeback while their extent is in flight and readers are
+    // never held up; pages of unregistered files stay dirty. Flushes for
+    // fsync() queue in the pool's Sync class, the rest as Background.
+    //
+    // The background thread flushes whenever dirty pages pass the
+    // background limit, by default a tenth of the cache. Writers call
+    // balance_dirty_pages(), which paces them between the background and
+    // hard limits (a fifth of the cache) and blocks them at the hard limit.
     class WritebackEngine
     {
     public:
-        explicit WritebackEngine(std::shared_ptr<PageCache> cache);
+        static constexpr size_t MAX_EXTENT_PAGES = 256;
+        // Pages taken per flush pass.
+        static constexpr size_t FLUSH_BATCH_PAGES = 4096;
+
+        // Flushes run on pool, shared with other I/O so that its priority
+        // classes can order them, or on num_threads threads of its own.
+        explicit WritebackEngine(std::shared_ptr<PageCache> cache,
+                                 std::shared_ptr<IOEngine> io = nullptr, size_t num_threads = 4,
+                                 std::shared_ptr<IOThreadPool> pool = nullptr);
         ~WritebackEngine();
 
         void start();
         void stop();
-        void fsync(uint64_t file_id);
-        void set_dirty_threshold(size_t threshold) { dirty_threshold_ = threshold; }
+        // Writes back the dirty pages of one file, or of every registered
+        // file when file_id is 0, and syncs the files. Returns 0 or the
+        // first error, as -errno, of any file it synced.
+        int fsync(uint64_t file_id);
+        // Writes back the file's dirty pages overlapping [offset, offset +
+        // length), or to the end of the file when length is 0, then
+        // fdatasync()s it. Only the pages dirty or under writeback when it
+        // is called are waited for: pages dirtied or appended meanwhile are
+        // left to later writeback, so other writers cannot hold it up.
+        // Returns 0, or -errno for a failed write or fdatasync(): this
+        // sync's, or a background writeback's since the file's last sync.
+        int sync_range(uint64_t file_id, uint64_t offset, uint64_t length);
+        void set_dirty_limits(size_t background_pages, size_t hard_pages)
+        {
+            throttle_.set_limits(background_pages, hard_pages);
+        }
+        const DirtyThrottle &throttle() const { return throttle_; }
+        std::shared_ptr<IOThreadPool> pool() const { return pool_; }
+
+        // Called by a writer after dirtying pages pages. Wakes background
+        // writeback past the background limit and sleeps as long as the
+        // throttle asks. At the hard limit it waits for writeback to get
+        // below it, giving up once writeback stops making progress.
+        void balance_dirty_pages(DirtyThrottle::Writer &writer, size_t pages);
+        // balance_dirty_pages() for writers that must not block: returns
+        // how long the writer should pause instead of sleeping, MAX_PAUSE
+        // at the hard limit.
+        DirtyThrottle::Clock::duration dirty_pause(DirtyThrottle::Writer &writer, size_t pages);
+
+        // Makes a file's pages writable: file_id is the inode number.
+        void register_inode(const std::shared_ptr<Inode> &inode);
+        void unregister_inode(uint64_t ino);
+
+        // One flush pass over the whole cache; returns the pages written.
+        size_t flush_dirty_pages();
 
     private:
         std::shared_ptr<PageCache> cache_;
+        std::shared_ptr<IOEngine> io_;
+        std::shared_ptr<IOThreadPool> pool_;
         std::atomic<bool> running_;
         std::thread writeback_thread_;
         std::mutex lock_;
         std::condition_variable cv_;
-        size_t dirty_threshold_;
-        std::shared_ptr<Counters> counters_;
+        std::condition_variable written_cv_;
+        bool flush_requested_;
+        DirtyThrottle throttle_;
+        std::mutex inodes_lock_;
+        std::unordered_map<uint64_t, std::weak_ptr<Inode>> inodes_;
 
         void writeback_loop();
-        void flush_dirty_pages();
+        void wake_writeback();
+        void wait_below_hard_limit();
+        std::shared_ptr<Inode> find_inode(uint64_t ino);
+        int sync_inode(Inode &inode, uint64_t first_page, uint64_t last_page);
+        size_t flush_pages(std::vector<std::shared_ptr<Page>> pages);
+        size_t write_file_pages(Inode &inode, std::vector<std::shared_ptr<Page>> &pages);
+        void notify_written(size_t pages);
     };
 
 }
@@ -13,4 +13,38 @@ namespace pagecache
     {
     }
 
+    Counters::Snapshot Counters::snapshot() const
+    {
+        Snapshot snapshot;
+        snapshot.cache_hits = cache_hits();
+        snapshot.cache_misses = cache_misses();
+        snapshot.bytes_read = bytes_read();
+        snapshot.bytes_written = bytes_written();
+        snapshot.evictions = evictions();
+        snapshot.writebacks = writebacks();
+        snapshot.read_hit_latency = read_hit_latency_.snapshot();
+        snapshot.miss_latency = miss_latency_.snapshot();
+        snapshot.eviction_latency = eviction_latency_.snapshot();
+        snapshot.writeback_latency = writeback_latency_.snapshot();
+        snapshot.fsync_latency = fsync_latency_.snapshot();
+        return snapshot;
+    }
+
+    Counters::Snapshot Counters::Snapshot::since(const Snapshot &earlier) const
+    {
+        Snapshot interval;
+        interval.cache_hits = cache_hits - earlier.cache_hits;
+        interval.cache_misses = cache_misses - earlier.cache_misses;
+        interval.bytes_read = bytes_read - earlier.bytes_read;
+        interval.bytes_written = bytes_written - earlier.bytes_written;
+        interval.evictions = evictions - earlier.evictions;
+        interval.writebacks = writebacks - earlier.writebacks;
+        interval.read_hit_latency = read_hit_latency.since(earlier.read_hit_latency);
+        interval.miss_latency = miss_latency.since(earlier.miss_latency);
+        interval.eviction_latency = eviction_latency.since(earlier.eviction_latency);
+        interval.writeback_latency = writeback_latency.since(earlier.writeback_latency);
+        interval.fsync_latency = fsync_latency.since(earlier.fsync_latency);
+        return interval;
+    }
+
 }
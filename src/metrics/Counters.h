@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../metrics/LatencyHistogram.h"
 #include <atomic>
 #include <cstdint>
 #include <chrono>
@@ -10,6 +11,25 @@ namespace pagecache
     class Counters
     {
     public:
+        // Point-in-time copy of every counter, to diff against a later one.
+        struct Snapshot
+        {
+            uint64_t cache_hits = 0;
+            uint64_t cache_misses = 0;
+            uint64_t bytes_read = 0;
+            uint64_t bytes_written = 0;
+            uint64_t evictions = 0;
+            uint64_t writebacks = 0;
+            LatencyHistogram::Snapshot read_hit_latency;
+            LatencyHistogram::Snapshot miss_latency;
+            LatencyHistogram::Snapshot eviction_latency;
+            LatencyHistogram::Snapshot writeback_latency;
+            LatencyHistogram::Snapshot fsync_latency;
+
+            // What happened between earlier and this snapshot.
+            Snapshot since(const Snapshot &earlier) const;
+        };
+
         Counters();
         ~Counters();
 
@@ -27,6 +47,17 @@ namespace pagecache
         uint64_t evictions() const { return evictions_.load(std::memory_order_relaxed); }
         uint64_t writebacks() const { return writebacks_.load(std::memory_order_relaxed); }
 
+        // File reads that issued no disk reads of their own; the disk read
+        // behind each run of demand misses; evicting one page; writing one
+        // writeback extent; and a whole fsync or sync_range.
+        LatencyHistogram &read_hit_latency() { return read_hit_latency_; }
+        LatencyHistogram &miss_latency() { return miss_latency_; }
+        LatencyHistogram &eviction_latency() { return eviction_latency_; }
+        LatencyHistogram &writeback_latency() { return writeback_latency_; }
+        LatencyHistogram &fsync_latency() { return fsync_latency_; }
+
+        Snapshot snapshot() const;
+
         double hit_ratio() const
         {
             uint64_t hits = cache_hits_.load(std::memory_order_relaxed);
@@ -43,6 +74,11 @@ namespace pagecache
             bytes_written_.store(0, std::memory_order_relaxed);
             evictions_.store(0, std::memory_order_relaxed);
             writebacks_.store(0, std::memory_order_relaxed);
+            read_hit_latency_.reset();
+            miss_latency_.reset();
+            eviction_latency_.reset();
+            writeback_latency_.reset();
+            fsync_latency_.reset();
         }
 
     private:
@@ -52,6 +88,11 @@ namespace pagecache
         std::atomic<uint64_t> bytes_written_;
         std::atomic<uint64_t> evictions_;
         std::atomic<uint64_t> writebacks_;
+        LatencyHistogram read_hit_latency_;
+        LatencyHistogram miss_latency_;
+        LatencyHistogram eviction_latency_;
+        LatencyHistogram writeback_latency_;
+        LatencyHistogram fsync_latency_;
     };
 
 }
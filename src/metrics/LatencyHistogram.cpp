@@ -0,0 +1,103 @@
+#include "../metrics/LatencyHistogram.h"
+#include <algorithm>
+#include <cmath>
+
+namespace pagecache
+{
+
+    LatencyHistogram::LatencyHistogram()
+        : stripes_(new Stripe[STRIPES])
+    {
+        reset();
+    }
+
+    // Threads take stripes in turn as they first record.
+    size_t LatencyHistogram::stripe_index()
+    {
+        static std::atomic<size_t> next_stripe(0);
+        thread_local size_t stripe = next_stripe.fetch_add(1, std::memory_order_relaxed) % STRIPES;
+        return stripe;
+    }
+
+    LatencyHistogram::Snapshot LatencyHistogram::snapshot() const
+    {
+        Snapshot snapshot;
+        for (size_t s = 0; s < STRIPES; ++s)
+        {
+            const Stripe &stripe = stripes_[s];
+            for (size_t b = 0; b < BUCKETS; ++b)
+            {
+                uint64_t count = stripe.counts[b].load(std::memory_order_relaxed);
+                snapshot.counts_[b] += count;
+                snapshot.count_ += count;
+            }
+            snapshot.sum_ += stripe.sum.load(std::memory_order_relaxed);
+            snapshot.max_ = std::max(snapshot.max_, stripe.max.load(std::memory_order_relaxed));
+        }
+        return snapshot;
+    }
+
+    void LatencyHistogram::reset()
+    {
+        for (size_t s = 0; s < STRIPES; ++s)
+        {
+            Stripe &stripe = stripes_[s];
+            for (size_t b = 0; b < BUCKETS; ++b)
+            {
+                stripe.counts[b].store(0, std::memory_order_relaxed);
+            }
+            stripe.sum.store(0, std::memory_order_relaxed);
+            stripe.max.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t LatencyHistogram::Snapshot::percentile(double percent) const
+    {
+        if (count_ == 0)
+        {
+            return 0;
+        }
+
+        double rank = std::ceil(std::clamp(percent, 0.0, 100.0) / 100.0 * count_);
+        uint64_t target = std::max<uint64_t>(1, std::min<uint64_t>(count_, (uint64_t)rank));
+        uint64_t seen = 0;
+        for (size_t b = 0; b < BUCKETS; ++b)
+        {
+            seen += counts_[b];
+            if (seen >= target)
+            {
+                return std::min(bucket_top(b), max_);
+            }
+        }
+        return max_;
+    }
+
+    LatencyHistogram::Snapshot &LatencyHistogram::Snapshot::merge(const Snapshot &other)
+    {
+        for (size_t b = 0; b < BUCKETS; ++b)
+        {
+            counts_[b] += other.counts_[b];
+        }
+        count_ += other.count_;
+        sum_ += other.sum_;
+        max_ = std::max(max_, other.max_);
+        return *this;
+    }
+
+    LatencyHistogram::Snapshot LatencyHistogram::Snapshot::since(const Snapshot &earlier) const
+    {
+        Snapshot interval;
+        for (size_t b = 0; b < BUCKETS; ++b)
+        {
+            interval.counts_[b] = counts_[b] - earlier.counts_[b];
+            interval.count_ += interval.counts_[b];
+            if (interval.counts_[b])
+            {
+                interval.max_ = std::min(bucket_top(b), max_);
+            }
+        }
+        interval.sum_ = sum_ - earlier.sum_;
+        return interval;
+    }
+
+}
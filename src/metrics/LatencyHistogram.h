@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace pagecache
+{
+
+    // Log-linear latency histogram in nanoseconds, after HdrHistogram.
+    // Values below 2^SUB_BUCKET_BITS are counted exactly. Above that, every
+    // power of two is split into 2^SUB_BUCKET_BITS equal buckets, so a value
+    // is known to within about 3% up to MAX_VALUE (about 68s); larger values
+    // land in the last bucket. Recording is a few relaxed atomic adds on one
+    // of STRIPES copies of the counts, picked per thread, so threads
+    // recording at once rarely share a cache line. snapshot() merges the
+    // stripes into a plain copy to query or diff.
+    class LatencyHistogram
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        static constexpr unsigned SUB_BUCKET_BITS = 5;
+        static constexpr size_t SUB_BUCKETS = size_t(1) << SUB_BUCKET_BITS;
+        static constexpr unsigned MAX_VALUE_BITS = 36;
+        static constexpr uint64_t MAX_VALUE = (uint64_t(1) << MAX_VALUE_BITS) - 1;
+        static constexpr size_t BUCKETS = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+        static constexpr size_t STRIPES = 8;
+
+        class Snapshot
+        {
+        public:
+            Snapshot() : counts_(BUCKETS, 0) {}
+
+            uint64_t count() const { return count_; }
+            uint64_t sum() const { return sum_; }
+            uint64_t max() const { return max_; }
+            double mean() const { return count_ ? double(sum_) / count_ : 0.0; }
+            // Smallest recorded value that percent of the values are at or
+            // below, as the top of its bucket; 0 when empty.
+            uint64_t percentile(double percent) const;
+            uint64_t count_at(size_t bucket) const { return counts_[bucket]; }
+
+            // Adds other's values, as from another histogram or process.
+            Snapshot &merge(const Snapshot &other);
+            // The values recorded after earlier, an older snapshot of the
+            // same histogram. The maximum is only known to bucket precision.
+            Snapshot since(const Snapshot &earlier) const;
+
+        private:
+            friend class LatencyHistogram;
+
+            std::vector<uint64_t> counts_;
+            uint64_t count_ = 0;
+            uint64_t sum_ = 0;
+            uint64_t max_ = 0;
+        };
+
+        LatencyHistogram();
+        LatencyHistogram(const LatencyHistogram &) = delete;
+        LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+        void record(uint64_t nanos)
+        {
+            Stripe &stripe = stripes_[stripe_index()];
+            uint64_t value = nanos < MAX_VALUE ? nanos : MAX_VALUE;
+            stripe.counts[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+            stripe.sum.fetch_add(value, std::memory_order_relaxed);
+            uint64_t max = stripe.max.load(std::memory_order_relaxed);
+            while (value > max && !stripe.max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+            {
+            }
+        }
+        void record_since(Clock::time_point start)
+        {
+            record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+        }
+
+        Snapshot snapshot() const;
+        // Not atomic with respect to concurrent record() calls.
+        void reset();
+
+        static size_t bucket_of(uint64_t value)
+        {
+            if (value < SUB_BUCKETS)
+            {
+                return value;
+            }
+            unsigned shift = 63 - __builtin_clzll(value) - SUB_BUCKET_BITS;
+            return (shift + 1) * SUB_BUCKETS + ((value >> shift) - SUB_BUCKETS);
+        }
+        // Largest value that falls in bucket.
+        static uint64_t bucket_top(size_t bucket)
+        {
+            if (bucket < SUB_BUCKETS)
+            {
+                return bucket;
+            }
+            unsigned shift = bucket / SUB_BUCKETS - 1;
+            return ((SUB_BUCKETS + bucket % SUB_BUCKETS + 1) << shift) - 1;
+        }
+
+    private:
+        struct alignas(64) Stripe
+        {
+            std::atomic<uint64_t> counts[BUCKETS];
+            std::atomic<uint64_t> sum;
+            std::atomic<uint64_t> max;
+        };
+
+        std::unique_ptr<Stripe[]> stripes_;
+
+        static size_t stripe_index();
+    };
+
+}
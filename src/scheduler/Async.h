@@ -0,0 +1,146 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace pagecache
+{
+
+    template <typename T>
+    class Async;
+
+    namespace detail
+    {
+        struct AsyncPromiseBase
+        {
+            std::coroutine_handle<> continuation;
+            std::exception_ptr exception;
+
+            // Hands control straight back to the awaiting coroutine, so a
+            // chain of co_awaits that never suspends runs like plain calls.
+            struct FinalAwaiter
+            {
+                bool await_ready() const noexcept { return false; }
+                template <typename Promise>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+                {
+                    std::coroutine_handle<> next = handle.promise().continuation;
+                    return next ? next : std::noop_coroutine();
+                }
+                void await_resume() const noexcept {}
+            };
+
+            std::suspend_always initial_suspend() const noexcept { return {}; }
+            FinalAwaiter final_suspend() const noexcept { return {}; }
+            void unhandled_exception() { exception = std::current_exception(); }
+        };
+
+        template <typename T>
+        struct AsyncPromise : AsyncPromiseBase
+        {
+            std::optional<T> value;
+
+            Async<T> get_return_object();
+            template <typename U>
+            void return_value(U &&result) { value.emplace(std::forward<U>(result)); }
+            T take()
+            {
+                if (exception)
+                {
+                    std::rethrow_exception(exception);
+                }
+                return std::move(*value);
+            }
+        };
+
+        template <>
+        struct AsyncPromise<void> : AsyncPromiseBase
+        {
+            Async<void> get_return_object();
+            void return_void() {}
+            void take()
+            {
+                if (exception)
+                {
+                    std::rethrow_exception(exception);
+                }
+            }
+        };
+    }
+
+    // A lazily started coroutine producing a T. Nothing runs until it is
+    // co_awaited; the awaiting coroutine is then suspended and this one
+    // runs in its place, and control passes back to the awaiter as soon as
+    // it finishes. Exceptions propagate to the awaiter. Top-level tasks
+    // are started with EventLoop::spawn().
+    template <typename T = void>
+    class [[nodiscard]] Async
+    {
+    public:
+        using promise_type = detail::AsyncPromise<T>;
+
+        Async() = default;
+        explicit Async(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+        Async(Async &&other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+        Async &operator=(Async &&other) noexcept
+        {
+            if (this != &other)
+            {
+                if (handle_)
+                {
+                    handle_.destroy();
+                }
+                handle_ = std::exchange(other.handle_, nullptr);
+            }
+            return *this;
+        }
+        Async(const Async &) = delete;
+        Async &operator=(const Async &) = delete;
+        ~Async()
+        {
+            if (handle_)
+            {
+                handle_.destroy();
+            }
+        }
+
+        bool done() const { return !handle_ || handle_.done(); }
+
+        auto operator co_await() const noexcept
+        {
+            struct Awaiter
+            {
+                std::coroutine_handle<promise_type> handle;
+
+                bool await_ready() const noexcept { return !handle || handle.done(); }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+                {
+                    handle.promise().continuation = awaiting;
+                    return handle;
+                }
+                T await_resume() { return handle.promise().take(); }
+            };
+            return Awaiter{handle_};
+        }
+
+    private:
+        std::coroutine_handle<promise_type> handle_;
+    };
+
+    namespace detail
+    {
+        template <typename T>
+        Async<T> AsyncPromise<T>::get_return_object()
+        {
+            return Async<T>(std::coroutine_handle<AsyncPromise<T>>::from_promise(*this));
+        }
+
+        inline Async<void> AsyncPromise<void>::get_return_object()
+        {
+            return Async<void>(std::coroutine_handle<AsyncPromise<void>>::from_promise(*this));
+        }
+    }
+
+}
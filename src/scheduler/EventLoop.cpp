@@ -0,0 +1,120 @@
+#include "../scheduler/EventLoop.h"
+
+namespace pagecache
+{
+
+    namespace
+    {
+        thread_local EventLoop *current_loop = nullptr;
+
+        // Top-level frame of a spawned task; frees itself when the task is
+        // done.
+        struct Detached
+        {
+            struct promise_type
+            {
+                Detached get_return_object()
+                {
+                    return {std::coroutine_handle<promise_type>::from_promise(*this)};
+                }
+                std::suspend_always initial_suspend() const noexcept { return {}; }
+                std::suspend_never final_suspend() const noexcept { return {}; }
+                void return_void() {}
+                void unhandled_exception() { std::terminate(); }
+            };
+
+            std::coroutine_handle<promise_type> handle;
+        };
+
+        Detached drive(Async<void> task, size_t &live_tasks)
+        {
+            co_await task;
+            live_tasks--;
+        }
+    }
+
+    EventLoop::EventLoop()
+        : live_tasks_(0),
+          resumptions_(0)
+    {
+    }
+
+    EventLoop *EventLoop::current()
+    {
+        return current_loop;
+    }
+
+    void EventLoop::spawn(Async<void> task)
+    {
+        live_tasks_++;
+        post(drive(std::move(task), live_tasks_).handle);
+    }
+
+    // Notifies under the lock: once the handle is visible the loop may
+    // finish its last task and be destroyed.
+    void EventLoop::post(std::coroutine_handle<> handle)
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        ready_.push_back(handle);
+        cv_.notify_one();
+    }
+
+    std::function<void()> EventLoop::resumer(std::coroutine_handle<> handle)
+    {
+        if (EventLoop *loop = current())
+        {
+            return [loop, handle]()
+            { loop->post(handle); };
+        }
+        return [handle]()
+        { handle.resume(); };
+    }
+
+    // Each turn takes the due timers and everything posted so far, then
+    // resumes them, so coroutines posted meanwhile wait for the next turn.
+    void EventLoop::run()
+    {
+        EventLoop *outer = current_loop;
+        current_loop = this;
+
+        std::vector<std::coroutine_handle<>> batch;
+        while (live_tasks_ > 0)
+        {
+            Clock::time_point now = Clock::now();
+            while (!timers_.empty() && timers_.top().when <= now)
+            {
+                batch.push_back(timers_.top().handle);
+                timers_.pop();
+            }
+
+            {
+                std::unique_lock<std::mutex> lock(lock_);
+                if (batch.empty())
+                {
+                    auto posted = [this]()
+                    { return !ready_.empty(); };
+                    if (timers_.empty())
+                    {
+                        cv_.wait(lock, posted);
+                    }
+                    else if (!cv_.wait_until(lock, timers_.top().when, posted))
+                    {
+                        continue;
+                    }
+                }
+                batch.insert(batch.end(), ready_.begin(), ready_.end());
+                ready_.clear();
+            }
+
+            for (std::coroutine_handle<> handle : batch)
+            {
+                resumptions_++;
+                handle.resume();
+            }
+            batch.clear();
+        }
+
+        current_loop = outer;
+    }
+
+}
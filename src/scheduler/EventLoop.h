@@ -0,0 +1,93 @@
+#pragma once
+
+#include "../scheduler/Async.h"
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace pagecache
+{
+
+    // Single-threaded executor for Async coroutines. Tasks spawned on the
+    // loop run on the thread that calls run(), which returns once all of
+    // them have finished. Coroutines waiting on I/O are resumed through
+    // post(), which any thread may call; timers serve sleep_for().
+    class EventLoop
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        EventLoop();
+        EventLoop(const EventLoop &) = delete;
+        EventLoop &operator=(const EventLoop &) = delete;
+
+        // The loop running on the calling thread, or null outside run().
+        static EventLoop *current();
+
+        // Starts task on the loop's next turn. Call from the loop's thread,
+        // before or during run(). A spawned task that throws terminates
+        // the process, as a thread would.
+        void spawn(Async<void> task);
+        // Queues handle to be resumed on the loop's thread.
+        void post(std::coroutine_handle<> handle);
+        void run();
+
+        // A callable that resumes handle on the calling thread's loop, or
+        // on whichever thread calls it when there is no loop, for awaitables
+        // whose completions arrive on other threads.
+        static std::function<void()> resumer(std::coroutine_handle<> handle);
+
+        // Suspends the coroutine for delay on the current loop; outside a
+        // loop it sleeps the thread instead.
+        static auto sleep_for(Clock::duration delay)
+        {
+            struct Sleep
+            {
+                Clock::duration delay;
+
+                bool await_ready() const
+                {
+                    if (delay > Clock::duration::zero() && !current())
+                    {
+                        std::this_thread::sleep_for(delay);
+                    }
+                    return delay <= Clock::duration::zero() || !current();
+                }
+                void await_suspend(std::coroutine_handle<> handle) const
+                {
+                    current()->timers_.push({Clock::now() + delay, handle});
+                }
+                void await_resume() const {}
+            };
+            return Sleep{delay};
+        }
+
+        // Coroutines resumed by the loop, counting each task's start.
+        uint64_t resumptions() const { return resumptions_; }
+
+    private:
+        struct Timer
+        {
+            Clock::time_point when;
+            std::coroutine_handle<> handle;
+
+            bool operator>(const Timer &other) const { return when > other.when; }
+        };
+
+        std::mutex lock_;
+        std::condition_variable cv_;
+        std::deque<std::coroutine_handle<>> ready_;
+        // Only touched on the loop's thread.
+        std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers_;
+        size_t live_tasks_;
+        uint64_t resumptions_;
+    };
+
+}
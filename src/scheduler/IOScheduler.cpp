@@ -0,0 +1,320 @@
+#include "../scheduler/IOScheduler.h"
+#include <algorithm>
+
+namespace pagecache
+{
+
+    IOScheduler::IOScheduler(std::shared_ptr<IOEngine> engine, Clock::duration plug_window)
+        : engine_(std::move(engine)),
+          plug_window_(plug_window),
+          max_in_flight_(std::max(engine_->queue_depth(), 1u)),
+          position_{Key{-1, 0}, Key{-1, 0}},
+          batch_direction_(READ),
+          batched_(FIFO_BATCH),
+          starved_(0),
+          in_flight_(0),
+          next_sequence_(0),
+          unplugged_(0),
+          stopping_(false)
+    {
+        dispatcher_ = std::thread(&IOScheduler::dispatch_loop, this);
+    }
+
+    // Dispatches whatever is still queued and waits for it.
+    IOScheduler::~IOScheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        dispatcher_.join();
+    }
+
+    void IOScheduler::queue_read(int fd, uint64_t offset, const struct iovec *iov, size_t iovcnt,
+                                 Completion done)
+    {
+        queue(READ, fd, offset, iov, iovcnt, std::move(done));
+    }
+
+    void IOScheduler::queue_write(int fd, uint64_t offset, const struct iovec *iov, size_t iovcnt,
+                                  Completion done)
+    {
+        queue(WRITE, fd, offset, iov, iovcnt, std::move(done));
+    }
+
+    void IOScheduler::submit()
+    {
+        std::unique_lock<std::mutex> lock(lock_);
+        unplugged_ = next_sequence_;
+        Clock::time_point wake = Clock::time_point::max();
+        dispatch_ready(lock, wake);
+    }
+
+    IOScheduler::Stats IOScheduler::stats() const
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        return stats_;
+    }
+
+    void IOScheduler::queue(Direction direction, int fd, uint64_t offset, const struct iovec *iov,
+                            size_t iovcnt, Completion done)
+    {
+        Request *request = new Request();
+        request->direction = direction;
+        request->fd = fd;
+        request->offset = offset;
+        request->iov.assign(iov, iov + iovcnt);
+        request->bytes = 0;
+        for (size_t i = 0; i < iovcnt; ++i)
+        {
+            request->bytes += iov[i].iov_len;
+        }
+        request->parts.push_back({request->bytes, std::move(done)});
+        request->arrival = Clock::now();
+        request->deadline = request->arrival + (direction == READ ? Clock::duration(READ_EXPIRE)
+                                                                  : Clock::duration(WRITE_EXPIRE));
+
+        // Held for the caller's submit(); the dispatcher is not woken.
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            stats_.requests++;
+            request->sequence = next_sequence_++;
+            auto &sorted = sorted_[direction];
+            request->sorted = sorted.emplace(Key{fd, offset}, request);
+            request->fifo = fifo_[direction].insert(fifo_[direction].end(), request);
+
+            // Back merge into the request before it, then front merge the
+            // one after.
+            if (request->sorted != sorted.begin())
+            {
+                Request *before = std::prev(request->sorted)->second;
+                if (try_merge(before, request))
+                {
+                    request = before;
+                }
+            }
+            auto after = std::next(request->sorted);
+            if (after != sorted.end())
+            {
+                try_merge(request, after->second);
+            }
+        }
+    }
+
+    // Appends back to front when back starts where front ends. The merged
+    // request keeps the earlier arrival, deadline, sequence and place in
+    // the FIFO.
+    bool IOScheduler::try_merge(Request *front, Request *back)
+    {
+        if (front->fd != back->fd || front->end() != back->offset ||
+            front->bytes + back->bytes > MAX_MERGE_BYTES ||
+            front->iov.size() + back->iov.size() > MAX_MERGE_SEGMENTS)
+        {
+            return false;
+        }
+
+        front->iov.insert(front->iov.end(), back->iov.begin(), back->iov.end());
+        for (Part &part : back->parts)
+        {
+            front->parts.push_back(std::move(part));
+        }
+        front->bytes += back->bytes;
+        if (back->arrival < front->arrival)
+        {
+            front->arrival = back->arrival;
+            auto &fifo = fifo_[front->direction];
+            fifo.splice(back->fifo, fifo, front->fifo);
+        }
+        front->deadline = std::min(front->deadline, back->deadline);
+        front->sequence = std::min(front->sequence, back->sequence);
+
+        remove(back);
+        delete back;
+        stats_.merged++;
+        return true;
+    }
+
+    void IOScheduler::remove(Request *request)
+    {
+        sorted_[request->direction].erase(request->sorted);
+        fifo_[request->direction].erase(request->fifo);
+    }
+
+    bool IOScheduler::ready(const Request *request, Clock::time_point now) const
+    {
+        return stopping_ || request->sequence < unplugged_ || now >= request->arrival + plug_window_ ||
+               request->bytes >= MAX_MERGE_BYTES || request->iov.size() >= MAX_MERGE_SEGMENTS;
+    }
+
+    // The first request of the direction at or past where its sweep got to.
+    IOScheduler::Request *IOScheduler::next_in_sweep(Direction direction)
+    {
+        auto it = sorted_[direction].lower_bound(position_[direction]);
+        return it != sorted_[direction].end() ? it->second : nullptr;
+    }
+
+    // Takes the next request to dispatch, or returns null and lowers wake
+    // to when the oldest held request's plug window ends.
+    IOScheduler::Request *IOScheduler::pick(Clock::time_point now, Clock::time_point &wake)
+    {
+        Request *request = nullptr;
+        if (batched_ < FIFO_BATCH)
+        {
+            request = next_in_sweep(batch_direction_);
+            if (request && !ready(request, now))
+            {
+                request = nullptr;
+            }
+        }
+
+        if (!request)
+        {
+            bool reads = !fifo_[READ].empty() && ready(fifo_[READ].front(), now);
+            bool writes = !fifo_[WRITE].empty() && ready(fifo_[WRITE].front(), now);
+            if (!reads && !writes)
+            {
+                for (const auto &fifo : fifo_)
+                {
+                    if (!fifo.empty())
+                    {
+                        wake = std::min(wake, fifo.front()->arrival + plug_window_);
+                    }
+                }
+                return nullptr;
+            }
+
+            Direction direction = WRITE;
+            if (reads && (!writes || starved_ < WRITES_STARVED))
+            {
+                direction = READ;
+                starved_ = writes ? starved_ + 1 : 0;
+            }
+            else
+            {
+                starved_ = 0;
+            }
+
+            // A new batch carries on the sweep, unless the oldest request
+            // has waited too long or the sweep has run off the end.
+            Request *oldest = fifo_[direction].front();
+            Request *next = next_in_sweep(direction);
+            bool expired = oldest->deadline <= now;
+            request = expired || !next || !ready(next, now) ? oldest : next;
+            if (expired)
+            {
+                stats_.expired++;
+            }
+            batch_direction_ = direction;
+            batched_ = 0;
+        }
+
+        batched_++;
+        position_[request->direction] = Key{request->fd, request->end()};
+        remove(request);
+        stats_.dispatched++;
+        stats_.bytes += request->bytes;
+        return request;
+    }
+
+    // Hands the request to the engine; its completion splits the result
+    // between the requests merged into it, in offset order.
+    void IOScheduler::dispatch(Request *request)
+    {
+        Completion done = [this, parts = std::move(request->parts)](ssize_t result) mutable
+        {
+            size_t offset = 0;
+            for (Part &part : parts)
+            {
+                ssize_t share = result;
+                if (result >= 0)
+                {
+                    size_t transferred = (size_t)result > offset ? (size_t)result - offset : 0;
+                    share = (ssize_t)std::min(part.bytes, transferred);
+                }
+                part.done(share);
+                offset += part.bytes;
+            }
+
+            // The dispatcher only waits on completions to stop, or when
+            // the engine's queue was full with more requests behind it.
+            std::lock_guard<std::mutex> lock(lock_);
+            bool was_full = in_flight_-- == max_in_flight_;
+            if (stopping_ || (was_full && (!fifo_[READ].empty() || !fifo_[WRITE].empty())))
+            {
+                cv_.notify_one();
+            }
+        };
+
+        if (request->direction == READ)
+        {
+            engine_->queue_read(request->fd, request->offset, request->iov.data(), request->iov.size(),
+                                std::move(done));
+        }
+        else
+        {
+            engine_->queue_write(request->fd, request->offset, request->iov.data(), request->iov.size(),
+                                 std::move(done));
+        }
+        delete request;
+    }
+
+    // Sends what is ready to the engine, up to its queue depth, and
+    // returns whether there was any. Otherwise lowers wake to when the
+    // next held request becomes ready. Called and returns with lock held.
+    bool IOScheduler::dispatch_ready(std::unique_lock<std::mutex> &lock, Clock::time_point &wake)
+    {
+        Clock::time_point now = Clock::now();
+        std::vector<Request *> batch;
+        while (in_flight_ + batch.size() < max_in_flight_)
+        {
+            Request *request = pick(now, wake);
+            if (!request)
+            {
+                break;
+            }
+            batch.push_back(request);
+        }
+        if (batch.empty())
+        {
+            return false;
+        }
+
+        in_flight_ += batch.size();
+        lock.unlock();
+        for (Request *request : batch)
+        {
+            dispatch(request);
+        }
+        engine_->submit();
+        lock.lock();
+        return true;
+    }
+
+    void IOScheduler::dispatch_loop()
+    {
+        std::unique_lock<std::mutex> lock(lock_);
+        for (;;)
+        {
+            Clock::time_point wake = Clock::time_point::max();
+            if (dispatch_ready(lock, wake))
+            {
+                continue;
+            }
+
+            if (stopping_ && fifo_[READ].empty() && fifo_[WRITE].empty() && in_flight_ == 0)
+            {
+                return;
+            }
+            if (wake == Clock::time_point::max() || in_flight_ >= max_in_flight_)
+            {
+                cv_.wait(lock);
+            }
+            else
+            {
+                cv_.wait_until(lock, wake);
+            }
+        }
+    }
+
+}
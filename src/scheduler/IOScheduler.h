@@ -0,0 +1,145 @@
+#pragma once
+
+#include "../io/IOEngine.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pagecache
+{
+
+    // Elevator stage in front of an IOEngine, after Linux's mq-deadline.
+    // Requests are held while their caller is still queueing, as under a
+    // block plug, until its submit(); one the dispatcher finds held past
+    // a short plug window goes out anyway. They are kept sorted by file
+    // and offset, and merged with queued neighbours of the same file and
+    // direction into single vectored I/Os of up to MAX_MERGE_BYTES, each
+    // completion getting its share of the merged result. A dispatcher
+    // thread keeps up to the engine's queue depth in flight: it sweeps
+    // each direction in offset order, up to FIFO_BATCH requests at a time,
+    // unless the oldest request has passed its deadline; reads go first,
+    // but writes at the latest after WRITES_STARVED read batches.
+    //
+    // Requests that overlap rather than touch are not merged: the cache
+    // never has two I/Os in flight for one page, so they only come from
+    // other callers, and go out as they came.
+    class IOScheduler : public IOEngine
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        static constexpr std::chrono::microseconds DEFAULT_PLUG_WINDOW{50};
+        static constexpr size_t MAX_MERGE_BYTES = 1024 * 1024;
+        static constexpr size_t MAX_MERGE_SEGMENTS = 256;
+        static constexpr std::chrono::milliseconds READ_EXPIRE{500};
+        static constexpr std::chrono::milliseconds WRITE_EXPIRE{5000};
+        static constexpr unsigned FIFO_BATCH = 16;
+        static constexpr unsigned WRITES_STARVED = 2;
+
+        struct Stats
+        {
+            // Requests queued, and how many of them were merged into another.
+            uint64_t requests = 0;
+            uint64_t merged = 0;
+            // I/Os sent to the engine, and their bytes.
+            uint64_t dispatched = 0;
+            uint64_t bytes = 0;
+            // Dispatched because their deadline had passed.
+            uint64_t expired = 0;
+
+            double merge_ratio() const { return requests ? double(merged) / requests : 0.0; }
+            double average_request_bytes() const { return dispatched ? double(bytes) / dispatched : 0.0; }
+        };
+
+        explicit IOScheduler(std::shared_ptr<IOEngine> engine,
+                             Clock::duration plug_window = DEFAULT_PLUG_WINDOW);
+        ~IOScheduler() override;
+
+        void queue_read(int fd, uint64_t offset, const struct iovec *iov, size_t iovcnt,
+                        Completion done) override;
+        void queue_write(int fd, uint64_t offset, const struct iovec *iov, size_t iovcnt,
+                         Completion done) override;
+        // Unplugs, like blk_finish_plug(): everything queued so far is
+        // ready, and the calling thread dispatches it up to the engine's
+        // queue depth rather than waiting for the dispatcher.
+        void submit() override;
+
+        const char *name() const override { return "deadline"; }
+        unsigned queue_depth() const override { return engine_->queue_depth(); }
+        bool registered_buffers() const override { return engine_->registered_buffers(); }
+
+        std::shared_ptr<IOEngine> engine() const { return engine_; }
+        Stats stats() const;
+
+    private:
+        enum Direction
+        {
+            READ,
+            WRITE
+        };
+
+        struct Part
+        {
+            size_t bytes;
+            Completion done;
+        };
+
+        using Key = std::pair<int, uint64_t>;
+
+        struct Request
+        {
+            Direction direction;
+            int fd;
+            uint64_t offset;
+            size_t bytes;
+            std::vector<struct iovec> iov;
+            std::vector<Part> parts;
+            Clock::time_point arrival;
+            Clock::time_point deadline;
+            // Order of queueing; a submit() unplugs everything before it.
+            uint64_t sequence;
+            std::multimap<Key, Request *>::iterator sorted;
+            std::list<Request *>::iterator fifo;
+
+            uint64_t end() const { return offset + bytes; }
+        };
+
+        std::shared_ptr<IOEngine> engine_;
+        Clock::duration plug_window_;
+        unsigned max_in_flight_;
+
+        mutable std::mutex lock_;
+        std::condition_variable cv_;
+        std::multimap<Key, Request *> sorted_[2];
+        std::list<Request *> fifo_[2];
+        // Where each direction's sweep got to, and how far into its batch.
+        Key position_[2];
+        Direction batch_direction_;
+        unsigned batched_;
+        unsigned starved_;
+        unsigned in_flight_;
+        uint64_t next_sequence_;
+        uint64_t unplugged_;
+        bool stopping_;
+        Stats stats_;
+        std::thread dispatcher_;
+
+        void queue(Direction direction, int fd, uint64_t offset, const struct iovec *iov, size_t iovcnt,
+                   Completion done);
+        bool try_merge(Request *front, Request *back);
+        void remove(Request *request);
+        Request *pick(Clock::time_point now, Clock::time_point &wake);
+        Request *next_in_sweep(Direction direction);
+        bool ready(const Request *request, Clock::time_point now) const;
+        void dispatch(Request *request);
+        bool dispatch_ready(std::unique_lock<std::mutex> &lock, Clock::time_point &wake);
+        void dispatch_loop();
+    };
+
+}
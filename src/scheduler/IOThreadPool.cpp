@@ -1,14 +1,75 @@
 #include "../scheduler/IOThreadPool.h"
+#include <algorithm>
+#include <functional>
 
 namespace pagecache
 {
 
-    IOThreadPool::IOThreadPool(size_t num_threads)
-        : num_threads_(num_threads), shutdown_flag_(false), pending_tasks_(0)
+    namespace
     {
+        // Slots pulled from the inbox at once; the rest go on the worker's
+        // own deque, where idle workers can steal them.
+        constexpr size_t INBOX_BATCH = 8;
+
+        // Set on worker threads, so their submissions go to their own deque.
+        thread_local const IOThreadPool *current_pool = nullptr;
+        thread_local size_t current_index = 0;
+
+        // Freelist head: ABA tag above, slot + 1 below, 0 when empty.
+        inline uint64_t pack_head(uint64_t tag, uint32_t slot) { return (tag << 32) | slot; }
+        inline uint32_t head_slot(uint64_t head) { return (uint32_t)head; }
+        inline uint64_t head_tag(uint64_t head) { return head >> 32; }
+
+        int64_t now_ns()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       IOThreadPool::Clock::now().time_since_epoch())
+                .count();
+        }
+    }
+
+    constexpr std::array<unsigned, IOThreadPool::NUM_PRIORITIES> IOThreadPool::WEIGHTS;
+
+    IOThreadPool::IOThreadPool(size_t num_threads, size_t max_tasks)
+        : max_tasks_(std::max<size_t>(max_tasks, 1)),
+          tasks_(new Task[max_tasks_]),
+          deadlines_(new std::atomic<int64_t>[max_tasks_]),
+          next_free_(new std::atomic<uint32_t>[max_tasks_]),
+          free_head_(0),
+          bump_(0),
+          queued_(0),
+          pending_(0),
+          expired_runs_(0),
+          prioritized_(true),
+          sleepers_(0),
+          shutdown_flag_(false)
+    {
+        for (std::atomic<size_t> &count : class_queued_)
+        {
+            count.store(0, std::memory_order_relaxed);
+        }
+
+        // Sized to hold every slot, so pushes never fail.
+        size_t shards = std::max<size_t>(num_threads, 1);
+        for (size_t i = 0; i < shards; ++i)
+        {
+            inbox_.emplace_back(new InboxShard());
+            for (Ring &ring : inbox_.back()->rings)
+            {
+                ring.slots.resize(max_tasks_);
+            }
+        }
         for (size_t i = 0; i < num_threads; ++i)
         {
-            threads_.emplace_back(&IOThreadPool::worker_loop, this);
+            workers_.emplace_back(new Worker());
+            for (auto &deque : workers_.back()->deques)
+            {
+                deque.reset(new WorkStealingDeque(max_tasks_));
+            }
+        }
+        for (size_t i = 0; i < num_threads; ++i)
+        {
+            workers_[i]->thread = std::thread(&IOThreadPool::worker_loop, this, i);
         }
     }
 
@@ -17,69 +78,328 @@ namespace pagecache
         shutdown();
     }
 
-    void IOThreadPool::submit(Task task)
+    void IOThreadPool::submit(Task task, IOPriority priority, Clock::duration max_wait)
     {
+        uint32_t slot;
+        if (!acquire_slot(slot))
+        {
+            task();
+            return;
+        }
+        if (!prioritized_.load(std::memory_order_relaxed))
+        {
+            priority = IOPriority::Background;
+        }
+        if (max_wait == Clock::duration::zero())
         {
-            std::lock_guard<std::mutex> lock(queue_lock_);
-            task_queue_.push(task);
-            pending_tasks_.fetch_add(1, std::memory_order_release);
+            max_wait = default_deadline(priority);
+        }
+        size_t cls = size_t(priority);
+        int64_t deadline = now_ns() + std::chrono::duration_cast<std::chrono::nanoseconds>(max_wait).count();
+
+        tasks_[slot] = std::move(task);
+        deadlines_[slot].store(deadline, std::memory_order_relaxed);
+        pending_.fetch_add(1, std::memory_order_relaxed);
+        class_queued_[cls].fetch_add(1, std::memory_order_relaxed);
+        // Counted before it is visible, so the worker that runs it cannot
+        // take the counts below zero. Pairs with worker_loop(): either the
+        // worker sees the count before it sleeps, or this sees it sleeping
+        // and wakes it.
+        queued_.fetch_add(1, std::memory_order_seq_cst);
+
+        if (current_pool == this)
+        {
+            workers_[current_index]->deques[cls]->push(slot);
+        }
+        else
+        {
+            size_t hash = std::hash<std::thread::id>()(std::this_thread::get_id());
+            InboxShard &shard = *inbox_[hash % inbox_.size()];
+            std::lock_guard<std::mutex> lock(shard.lock);
+            Ring &ring = shard.rings[cls];
+            ring.slots[(ring.head + ring.count) % max_tasks_] = slot;
+            if (ring.count++ == 0)
+            {
+                ring.head_deadline.store(deadline, std::memory_order_relaxed);
+            }
+        }
+
+        if (sleepers_.load(std::memory_order_seq_cst) > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(park_lock_);
+            }
+            park_cv_.notify_one();
         }
-        cv_.notify_one();
     }
 
     void IOThreadPool::wait_all()
     {
-        while (pending_tasks_.load(std::memory_order_acquire) > 0)
+        std::unique_lock<std::mutex> lock(idle_lock_);
+        idle_cv_.wait(lock, [this]
+                      { return pending_.load(std::memory_order_acquire) == 0; });
+    }
+
+    IOThreadPool::Clock::duration IOThreadPool::default_deadline(IOPriority priority)
+    {
+        switch (priority)
         {
-            std::this_thread::yield();
+        case IOPriority::Demand:
+            return std::chrono::milliseconds(5);
+        case IOPriority::Sync:
+            return std::chrono::milliseconds(50);
+        case IOPriority::Readahead:
+            return std::chrono::milliseconds(100);
+        default:
+            return std::chrono::milliseconds(500);
         }
     }
 
     void IOThreadPool::shutdown()
     {
         {
-            std::lock_guard<std::mutex> lock(queue_lock_);
+            std::lock_guard<std::mutex> lock(park_lock_);
             shutdown_flag_ = true;
         }
-        cv_.notify_all();
+        park_cv_.notify_all();
 
-        for (auto &thread : threads_)
+        for (auto &worker : workers_)
         {
-            if (thread.joinable())
+            if (worker->thread.joinable())
             {
-                thread.join();
+                worker->thread.join();
             }
         }
     }
 
-    void IOThreadPool::worker_loop()
+    bool IOThreadPool::acquire_slot(uint32_t &slot)
     {
-        while (true)
+        uint64_t head = free_head_.load(std::memory_order_acquire);
+        while (head_slot(head) != 0)
         {
-            Task task = nullptr;
+            uint32_t candidate = head_slot(head) - 1;
+            uint32_t next = next_free_[candidate].load(std::memory_order_relaxed);
+            if (free_head_.compare_exchange_weak(head, pack_head(head_tag(head) + 1, next),
+                                                 std::memory_order_acq_rel,
+                                                 std::memory_order_acquire))
             {
-                std::unique_lock<std::mutex> lock(queue_lock_);
-                cv_.wait(lock, [this]
-                         { return !task_queue_.empty() || shutdown_flag_.load(); });
+                slot = candidate;
+                return true;
+            }
+        }
 
-                if (shutdown_flag_.load() && task_queue_.empty())
-                {
-                    break;
-                }
+        uint32_t fresh = bump_.load(std::memory_order_relaxed);
+        while (fresh < max_tasks_)
+        {
+            if (bump_.compare_exchange_weak(fresh, fresh + 1, std::memory_order_relaxed))
+            {
+                slot = fresh;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void IOThreadPool::release_slot(uint32_t slot)
+    {
+        uint64_t head = free_head_.load(std::memory_order_relaxed);
+        do
+        {
+            next_free_[slot].store(head_slot(head), std::memory_order_relaxed);
+        } while (!free_head_.compare_exchange_weak(head, pack_head(head_tag(head) + 1, slot + 1),
+                                                   std::memory_order_release,
+                                                   std::memory_order_relaxed));
+    }
+
+    // Overdue tasks first, most urgent class first. Otherwise classes take
+    // turns by weight, each worker running up to WEIGHTS[c] tasks of class
+    // c per round while more urgent ones are queued too.
+    bool IOThreadPool::take(size_t index, uint32_t &slot, size_t &priority)
+    {
+        if (queued_.load(std::memory_order_relaxed) == 0)
+        {
+            return false;
+        }
+
+        int64_t now = now_ns();
+        for (size_t cls = 0; cls < NUM_PRIORITIES; ++cls)
+        {
+            if (class_queued_[cls].load(std::memory_order_relaxed) > 0 && take_expired(index, cls, now, slot))
+            {
+                expired_runs_.fetch_add(1, std::memory_order_relaxed);
+                priority = cls;
+                return true;
+            }
+        }
 
-                if (!task_queue_.empty())
+        Worker &worker = *workers_[index];
+        for (int round = 0; round < 2; ++round)
+        {
+            for (size_t cls = 0; cls < NUM_PRIORITIES; ++cls)
+            {
+                if (worker.credits[cls] > 0 && class_queued_[cls].load(std::memory_order_relaxed) > 0 &&
+                    take_class(index, cls, slot))
                 {
-                    task = task_queue_.front();
-                    task_queue_.pop();
+                    worker.credits[cls]--;
+                    priority = cls;
+                    return true;
                 }
             }
+            // What is queued has used up its turn: start a new round.
+            worker.credits = WEIGHTS;
+        }
+        return false;
+    }
 
-            if (task)
+    // The oldest task of a class is at the head of an inbox ring or the
+    // top of a deque, so only those are checked against the clock.
+    bool IOThreadPool::take_expired(size_t index, size_t priority, int64_t now, uint32_t &slot)
+    {
+        for (auto &shard : inbox_)
+        {
+            Ring &ring = shard->rings[priority];
+            if (ring.head_deadline.load(std::memory_order_relaxed) > now)
             {
-                task();
-                pending_tasks_.fetch_sub(1, std::memory_order_release);
+                continue;
             }
+
+            std::lock_guard<std::mutex> lock(shard->lock);
+            if (ring.count == 0 || deadlines_[ring.slots[ring.head]].load(std::memory_order_relaxed) > now)
+            {
+                continue;
+            }
+            slot = ring.slots[ring.head];
+            ring.head = (ring.head + 1) % max_tasks_;
+            ring.count--;
+            ring.head_deadline.store(ring.count ? deadlines_[ring.slots[ring.head]].load(std::memory_order_relaxed)
+                                                : INT64_MAX,
+                                     std::memory_order_relaxed);
+            return true;
+        }
+
+        for (size_t i = 0; i < workers_.size(); ++i)
+        {
+            WorkStealingDeque &deque = *workers_[(index + i) % workers_.size()]->deques[priority];
+            uint32_t oldest;
+            if (deque.peek(oldest) && deadlines_[oldest].load(std::memory_order_relaxed) <= now &&
+                deque.steal(slot))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Own deque first, then the inbox starting at the worker's own shard,
+    // then the other workers' deques.
+    bool IOThreadPool::take_class(size_t index, size_t priority, uint32_t &slot)
+    {
+        if (workers_[index]->deques[priority]->pop(slot))
+        {
+            return true;
+        }
+
+        for (size_t i = 0; i < inbox_.size(); ++i)
+        {
+            if (take_inbox(index, priority, *inbox_[(index + i) % inbox_.size()], slot))
+            {
+                return true;
+            }
+        }
+
+        for (size_t i = 1; i < workers_.size(); ++i)
+        {
+            if (workers_[(index + i) % workers_.size()]->deques[priority]->steal(slot))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool IOThreadPool::take_inbox(size_t index, size_t priority, InboxShard &shard, uint32_t &slot)
+    {
+        Ring &ring = shard.rings[priority];
+        if (ring.head_deadline.load(std::memory_order_relaxed) == INT64_MAX)
+        {
+            return false;
         }
+
+        uint32_t batch[INBOX_BATCH];
+        size_t taken;
+        {
+            std::lock_guard<std::mutex> lock(shard.lock);
+            taken = std::min(ring.count, INBOX_BATCH);
+            for (size_t i = 0; i < taken; ++i)
+            {
+                batch[i] = ring.slots[ring.head];
+                ring.head = (ring.head + 1) % max_tasks_;
+            }
+            ring.count -= taken;
+            ring.head_deadline.store(ring.count ? deadlines_[ring.slots[ring.head]].load(std::memory_order_relaxed)
+                                                : INT64_MAX,
+                                     std::memory_order_relaxed);
+        }
+
+        if (taken == 0)
+        {
+            return false;
+        }
+        // Oldest runs now; the rest stay in submission order for stealers.
+        slot = batch[0];
+        for (size_t i = 1; i < taken; ++i)
+        {
+            workers_[index]->deques[priority]->push(batch[i]);
+        }
+        return true;
+    }
+
+    void IOThreadPool::run(uint32_t slot, size_t priority)
+    {
+        class_queued_[priority].fetch_sub(1, std::memory_order_relaxed);
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        Task task = std::move(tasks_[slot]);
+        release_slot(slot);
+        task();
+        task.reset();
+
+        if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            {
+                std::lock_guard<std::mutex> lock(idle_lock_);
+            }
+            idle_cv_.notify_all();
+        }
+    }
+
+    void IOThreadPool::worker_loop(size_t index)
+    {
+        current_pool = this;
+        current_index = index;
+
+        while (true)
+        {
+            uint32_t slot;
+            size_t priority;
+            if (take(index, slot, priority))
+            {
+                run(slot, priority);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(park_lock_);
+            sleepers_.fetch_add(1, std::memory_order_seq_cst);
+            park_cv_.wait(lock, [this]
+                          { return queued_.load(std::memory_order_seq_cst) > 0 || shutdown_flag_.load(); });
+            sleepers_.fetch_sub(1, std::memory_order_relaxed);
+
+            if (shutdown_flag_.load() && queued_.load(std::memory_order_seq_cst) == 0)
+            {
+                break;
+            }
+        }
+
+        current_pool = nullptr;
     }
 
 }
@@ -1,37 +1,140 @@
 #pragma once
 
+#include "../scheduler/Task.h"
+#include "../scheduler/WorkStealingDeque.h"
+#include <array>
+#include <chrono>
 #include <memory>
 #include <thread>
-#include <queue>
-#include <functional>
+#include <atomic>
+#include <vector>
 #include <mutex>
 #include <condition_variable>
 
 namespace pagecache
 {
 
-    using Task = std::function<void()>;
+    // I/O classes, most urgent first. Demand is work a reader is blocked
+    // on; Sync is writeback someone is fsync()ing. Readahead ranks above
+    // background writeback because a reader is about to need it, while
+    // background writeback only holds up writers, and the dirty throttle
+    // already paces those.
+    enum class IOPriority : uint8_t
+    {
+        Demand,
+        Sync,
+        Readahead,
+        Background
+    };
 
+    // Work-stealing pool. Each worker owns a deque: tasks a worker submits
+    // go on its own deque, which it pops newest first, and idle workers
+    // steal the oldest from each other's. Tasks submitted from outside go
+    // through an inbox sharded by submitting thread, so submitters do not
+    // all queue on one lock.
+    //
+    // Every priority class has its own deques and inbox. Workers share out
+    // their time between classes by weight, most urgent first, and a task
+    // that has waited past its deadline runs ahead of everything that has
+    // not, so no class starves behind a busier, more urgent one.
+    //
+    // Queued tasks live in a fixed slab of max_tasks slots, and the deques
+    // and inbox pass slot numbers, so submitting does not allocate. With
+    // every slot taken, submit() runs the task on the caller instead.
+    // Idle workers and wait_all() sleep on condition variables.
     class IOThreadPool
     {
     public:
-        explicit IOThreadPool(size_t num_threads = 4);
+        using Clock = std::chrono::steady_clock;
+
+        static constexpr size_t DEFAULT_MAX_TASKS = 4096;
+        static constexpr size_t NUM_PRIORITIES = 4;
+        // Tasks of each class a worker runs per round while all are busy.
+        static constexpr std::array<unsigned, NUM_PRIORITIES> WEIGHTS = {8, 4, 2, 1};
+
+        explicit IOThreadPool(size_t num_threads = 4, size_t max_tasks = DEFAULT_MAX_TASKS);
         ~IOThreadPool();
 
-        void submit(Task task);
+        // Queues task in its priority class, to run within max_wait if it
+        // can, or the class's default deadline when max_wait is zero.
+        void submit(Task task, IOPriority priority = IOPriority::Background,
+                    Clock::duration max_wait = Clock::duration::zero());
+        // Blocks until every task submitted so far, and any they submit,
+        // has run. Must not be called from a worker.
         void wait_all();
+        // Runs what is queued, then stops the workers.
         void shutdown();
 
+        // Without priorities every task queues as Background, for comparison.
+        void set_priorities(bool enabled) { prioritized_.store(enabled, std::memory_order_relaxed); }
+        static Clock::duration default_deadline(IOPriority priority);
+
+        size_t num_threads() const { return workers_.size(); }
+        size_t pending() const { return pending_.load(std::memory_order_acquire); }
+        size_t queued(IOPriority priority) const
+        {
+            return class_queued_[size_t(priority)].load(std::memory_order_relaxed);
+        }
+        // Tasks run ahead of their turn because their deadline had passed.
+        uint64_t expired_runs() const { return expired_runs_.load(std::memory_order_relaxed); }
+
     private:
-        size_t num_threads_;
-        std::vector<std::thread> threads_;
-        std::queue<Task> task_queue_;
-        std::mutex queue_lock_;
-        std::condition_variable cv_;
+        struct Worker
+        {
+            std::array<std::unique_ptr<WorkStealingDeque>, NUM_PRIORITIES> deques;
+            std::array<unsigned, NUM_PRIORITIES> credits = WEIGHTS;
+            std::thread thread;
+        };
+
+        struct Ring
+        {
+            std::vector<uint32_t> slots;
+            size_t head = 0;
+            size_t count = 0;
+            // Deadline of the slot at head, readable without the lock.
+            std::atomic<int64_t> head_deadline{INT64_MAX};
+        };
+
+        struct InboxShard
+        {
+            std::mutex lock;
+            std::array<Ring, NUM_PRIORITIES> rings;
+        };
+
+        size_t max_tasks_;
+        std::unique_ptr<Task[]> tasks_;
+        // Steady clock nanoseconds by which each queued slot should run.
+        std::unique_ptr<std::atomic<int64_t>[]> deadlines_;
+        std::unique_ptr<std::atomic<uint32_t>[]> next_free_;
+        std::atomic<uint64_t> free_head_;
+        std::atomic<uint32_t> bump_;
+
+        std::vector<std::unique_ptr<InboxShard>> inbox_;
+        std::vector<std::unique_ptr<Worker>> workers_;
+
+        // Tasks sitting in a deque or the inbox, in all and by class, and
+        // tasks not yet finished.
+        std::atomic<size_t> queued_;
+        std::array<std::atomic<size_t>, NUM_PRIORITIES> class_queued_;
+        std::atomic<size_t> pending_;
+        std::atomic<uint64_t> expired_runs_;
+        std::atomic<bool> prioritized_;
+        std::atomic<size_t> sleepers_;
         std::atomic<bool> shutdown_flag_;
-        std::atomic<size_t> pending_tasks_;
+        std::mutex park_lock_;
+        std::condition_variable park_cv_;
+        std::mutex idle_lock_;
+        std::condition_variable idle_cv_;
+
+        bool acquire_slot(uint32_t &slot);
+        void release_slot(uint32_t slot);
 
-        void worker_loop();
+        bool take(size_t index, uint32_t &slot, size_t &priority);
+        bool take_expired(size_t index, size_t priority, int64_t now, uint32_t &slot);
+        bool take_class(size_t index, size_t priority, uint32_t &slot);
+        bool take_inbox(size_t index, size_t priority, InboxShard &shard, uint32_t &slot);
+        void run(uint32_t slot, size_t priority);
+        void worker_loop(size_t index);
     };
 
 }
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace pagecache
+{
+
+    // A move-only void() callable stored inline when it fits in
+    // INLINE_SIZE bytes and moves without throwing, which covers the
+    // lambdas the cache submits (a few pointers and shared_ptrs), so
+    // queueing one does not allocate. Larger callables go to the heap.
+    class Task
+    {
+    public:
+        static constexpr size_t INLINE_SIZE = 64;
+
+        Task() noexcept : ops_(nullptr) {}
+        Task(std::nullptr_t) noexcept : ops_(nullptr) {}
+
+        template <typename F, typename = std::enable_if_t<!std::is_same<std::decay_t<F>, Task>::value>>
+        Task(F &&f)
+        {
+            using Fn = std::decay_t<F>;
+            if constexpr (fits_inline<Fn>())
+            {
+                new (storage_) Fn(std::forward<F>(f));
+                ops_ = &inline_ops<Fn>;
+            }
+            else
+            {
+                new (storage_) Fn *(new Fn(std::forward<F>(f)));
+                ops_ = &heap_ops<Fn>;
+            }
+        }
+
+        Task(Task &&other) noexcept : ops_(other.ops_)
+        {
+            if (ops_)
+            {
+                ops_->move(storage_, other.storage_);
+                other.ops_ = nullptr;
+            }
+        }
+
+        Task &operator=(Task &&other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                ops_ = other.ops_;
+                if (ops_)
+                {
+                    ops_->move(storage_, other.storage_);
+                    other.ops_ = nullptr;
+                }
+            }
+            return *this;
+        }
+
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+
+        ~Task() { reset(); }
+
+        explicit operator bool() const { return ops_ != nullptr; }
+        void operator()() { ops_->invoke(storage_); }
+
+        void reset()
+        {
+            if (ops_)
+            {
+                ops_->destroy(storage_);
+                ops_ = nullptr;
+            }
+        }
+
+        template <typename Fn>
+        static constexpr bool fits_inline()
+        {
+            return sizeof(Fn) <= INLINE_SIZE && alignof(Fn) <= alignof(std::max_align_t) &&
+                   std::is_nothrow_move_constructible<Fn>::value;
+        }
+
+    private:
+        struct Ops
+        {
+            void (*invoke)(void *storage);
+            // Move-constructs into dst and destroys what is left in src.
+            void (*move)(void *dst, void *src);
+            void (*destroy)(void *storage);
+        };
+
+        template <typename Fn>
+        static constexpr Ops inline_ops = {
+            [](void *s)
+            { (*static_cast<Fn *>(s))(); },
+            [](void *dst, void *src)
+            {
+                new (dst) Fn(std::move(*static_cast<Fn *>(src)));
+                static_cast<Fn *>(src)->~Fn();
+            },
+            [](void *s)
+            { static_cast<Fn *>(s)->~Fn(); }};
+
+        template <typename Fn>
+        static constexpr Ops heap_ops = {
+            [](void *s)
+            { (**static_cast<Fn **>(s))(); },
+            [](void *dst, void *src)
+            { new (dst) Fn *(*static_cast<Fn **>(src)); },
+            [](void *s)
+            { delete *static_cast<Fn **>(s); }};
+
+        alignas(std::max_align_t) unsigned char storage_[INLINE_SIZE];
+        const Ops *ops_;
+    };
+
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace pagecache
+{
+
+    // Bounded Chase-Lev deque of 32-bit task slots (Chase & Lev, SPAA '05,
+    // with the C11 orderings of Lê et al., PPoPP '13). The owning worker
+    // pushes and pops at the bottom; other workers steal from the top.
+    // Capacity is a power of two and fixed, so push() fails when full
+    // instead of growing.
+    class WorkStealingDeque
+    {
+    public:
+        explicit WorkStealingDeque(size_t capacity)
+            : mask_(round_up(capacity) - 1),
+              buffer_(new std::atomic<uint32_t>[mask_ + 1]),
+              top_(0),
+              bottom_(0)
+        {
+        }
+
+        // Owner only.
+        bool push(uint32_t slot)
+        {
+            int64_t b = bottom_.load(std::memory_order_relaxed);
+            int64_t t = top_.load(std::memory_order_acquire);
+            if (b - t > (int64_t)mask_)
+            {
+                return false;
+            }
+            buffer_[b & mask_].store(slot, std::memory_order_relaxed);
+            bottom_.store(b + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Owner only: takes the most recently pushed slot.
+        bool pop(uint32_t &slot)
+        {
+            int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+            bottom_.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top_.load(std::memory_order_relaxed);
+
+            if (t > b)
+            {
+                bottom_.store(b + 1, std::memory_order_relaxed);
+                return false;
+            }
+
+            slot = buffer_[b & mask_].load(std::memory_order_relaxed);
+            if (t == b)
+            {
+                // Last one: race thieves for it.
+                bool won = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                        std::memory_order_relaxed);
+                bottom_.store(b + 1, std::memory_order_relaxed);
+                return won;
+            }
+            return true;
+        }
+
+        // Any thread: takes the oldest slot. Fails when empty or when it
+        // loses a race, so callers move on to another victim.
+        bool steal(uint32_t &slot)
+        {
+            int64_t t = top_.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = bottom_.load(std::memory_order_acquire);
+            if (t >= b)
+            {
+                return false;
+            }
+
+            slot = buffer_[t & mask_].load(std::memory_order_relaxed);
+            return top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                std::memory_order_relaxed);
+        }
+
+        // Any thread: the oldest slot, without taking it. Only a hint, as
+        // it may be gone by the time the caller acts on it.
+        bool peek(uint32_t &slot) const
+        {
+            int64_t t = top_.load(std::memory_order_acquire);
+            int64_t b = bottom_.load(std::memory_order_acquire);
+            if (t >= b)
+            {
+                return false;
+            }
+            slot = buffer_[t & mask_].load(std::memory_order_relaxed);
+            return true;
+        }
+
+        bool empty() const
+        {
+            return bottom_.load(std::memory_order_relaxed) <= top_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        size_t mask_;
+        std::unique_ptr<std::atomic<uint32_t>[]> buffer_;
+        // Apart, so thieves hitting top do not bounce the owner's bottom.
+        alignas(64) std::atomic<int64_t> top_;
+        alignas(64) std::atomic<int64_t> bottom_;
+
+        static size_t round_up(size_t n)
+        {
+            size_t size = 2;
+            while (size < n)
+            {
+                size <<= 1;
+            }
+            return size;
+        }
+    };
+
+}
@@ -2,8 +2,10 @@
 #include <cassert>
 #include <vector>
 #include <memory>
+#include <random>
 #include "cache/Page.h"
 #include "cache/Eviction.h"
+#include "cache/PageCache.h"
 
 using namespace pagecache;
 
@@ -77,6 +79,43 @@ void test_clock_eviction_basic()
     std::cout << "✓ CLOCK eviction basic test passed" << std::endl;
 }
 
+void test_clock_second_chance()
+{
+    std::vector<std::shared_ptr<Page>> pages;
+    for (uint64_t i = 0; i < 4; ++i)
+    {
+        pages.push_back(std::make_shared<Page>(1, i));
+    }
+
+    CLOCKEviction clock;
+    pages[0]->mark_referenced();
+    [[maybe_unused]] std::shared_ptr<Page> swept = clock.select_victim(pages);
+    assert(swept == pages[1]);
+    assert(!pages[0]->referenced());
+
+    ClockPolicy policy;
+    for (const auto &page : pages)
+    {
+        policy.on_insert(page.get());
+    }
+    policy.on_access(pages[0].get());
+    policy.on_access(pages[1].get());
+
+    Page *victim = policy.select_victim();
+    assert(victim == pages[2].get());
+    policy.on_evict(victim);
+
+    // The freed slot sits just behind the hand, so a new page there is the
+    // last one the next sweep reaches.
+    auto fresh = std::make_shared<Page>(1, 9);
+    policy.on_insert(fresh.get());
+    assert(policy.size() == 4);
+    [[maybe_unused]] Page *next = policy.select_victim();
+    assert(next == pages[3].get());
+
+    std::cout << "✓ CLOCK second chance test passed" << std::endl;
+}
+
 void test_clock_respects_refcount()
 {
     std::vector<std::shared_ptr<Page>> pages;
@@ -135,6 +174,173 @@ void test_eviction_with_all_locked()
     std::cout << "✓ Eviction with all locked test passed" << std::endl;
 }
 
+namespace
+{
+    double run_trace(const std::string &policy, size_t capacity,
+                     const std::vector<std::pair<uint64_t, uint64_t>> &trace,
+                     bool admission_filter = false)
+    {
+        PageCache cache(capacity, 1);
+        cache.set_eviction_policy(policy);
+        cache.set_admission_filter(admission_filter);
+
+        size_t misses = 0;
+        auto loader = [&misses](uint8_t *)
+        {
+            misses++;
+            return true;
+        };
+
+        for (const auto &access : trace)
+        {
+            cache.get_or_load(access.first, access.second, loader);
+        }
+        return 1.0 - (double)misses / trace.size();
+    }
+
+    // Loops over a hot set `passes` times per round, then runs a one-shot
+    // sequential scan of pages that are never touched again.
+    std::vector<std::pair<uint64_t, uint64_t>> loop_with_scans(size_t hot_pages, size_t passes,
+                                                               size_t scan_pages, size_t rounds)
+    {
+        std::vector<std::pair<uint64_t, uint64_t>> trace;
+        uint64_t next_scan_page = 0;
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t pass = 0; pass < passes; ++pass)
+            {
+                for (uint64_t i = 0; i < hot_pages; ++i)
+                {
+                    trace.push_back({1, i});
+                }
+            }
+            for (size_t i = 0; i < scan_pages; ++i)
+            {
+                trace.push_back({2, next_scan_page++});
+            }
+        }
+        return trace;
+    }
+
+    // Random reads where a quarter of the accesses go to a small hot set and
+    // the rest to a long tail that is practically never read twice.
+    std::vector<std::pair<uint64_t, uint64_t>> hot_set_with_long_tail(size_t hot_pages,
+                                                                      size_t accesses)
+    {
+        std::mt19937_64 rng(42);
+        std::vector<std::pair<uint64_t, uint64_t>> trace;
+        for (size_t i = 0; i < accesses; ++i)
+        {
+            if (rng() % 4 == 0)
+            {
+                trace.push_back({1, rng() % hot_pages});
+            }
+            else
+            {
+                trace.push_back({2, rng() % 1000000});
+            }
+        }
+        return trace;
+    }
+}
+
+void test_arc_scan_resistance()
+{
+    auto trace = loop_with_scans(60, 2, 300, 20);
+
+    double lru = run_trace("lru", 100, trace);
+    double arc = run_trace("arc", 100, trace);
+    std::cout << "  2-pass loop + scans: lru " << lru << " arc " << arc << std::endl;
+
+    assert(arc > lru + 0.1);
+    std::cout << "✓ ARC scan resistance test passed" << std::endl;
+}
+
+void test_arc_ghost_adaptation()
+{
+    ArcPolicy arc(4);
+    std::vector<std::shared_ptr<Page>> pages;
+    for (uint64_t i = 0; i < 4; ++i)
+    {
+        pages.push_back(std::make_shared<Page>(1, i));
+        arc.on_miss({1, i});
+        arc.on_insert(pages.back().get());
+    }
+    assert(arc.t1_size() == 4);
+
+    // Re-referenced pages move to T2, so the victim comes from T1.
+    arc.on_access(pages[0].get());
+    Page *victim = arc.select_victim();
+    assert(victim == pages[1].get());
+    arc.on_evict(victim);
+    assert(arc.b1_size() == 1);
+
+    // A miss remembered in B1 grows T1's target and re-enters in T2.
+    arc.on_miss({1, 1});
+    assert(arc.target_t1() == 1);
+    auto again = std::make_shared<Page>(1, 1);
+    arc.on_insert(again.get());
+    assert(arc.b1_size() == 0);
+    assert(arc.t2_size() == 2);
+
+    // T1 is above its target, so only T1 is swept and a hit bit left on a
+    // T2 page survives for that page's own turn.
+    pages[0]->mark_referenced();
+    victim = arc.select_victim();
+    assert(victim == pages[2].get());
+    assert(pages[0]->referenced());
+
+    std::cout << "✓ ARC ghost adaptation test passed" << std::endl;
+}
+
+void test_frequency_sketch()
+{
+    FrequencySketch sketch(64);
+    const PageKey hot{1, 1};
+    const PageKey once{1, 2};
+
+    for (int i = 0; i < 6; ++i)
+    {
+        sketch.record(hot);
+    }
+    sketch.record(once);
+
+    assert(sketch.frequency(hot) > sketch.frequency(once));
+    assert(sketch.frequency(once) >= 1);
+
+    // Aging halves the counters once a full sample has been recorded.
+    [[maybe_unused]] uint32_t before = sketch.frequency(hot);
+    for (uint64_t i = 0;; ++i)
+    {
+        size_t additions = sketch.additions();
+        sketch.record({2, i});
+        if (sketch.additions() < additions)
+        {
+            break;
+        }
+    }
+    assert(sketch.frequency(hot) < before);
+
+    std::cout << "✓ Frequency sketch test passed" << std::endl;
+}
+
+void test_tinylfu_long_tail()
+{
+    auto trace = hot_set_with_long_tail(80, 40000);
+
+    double lru = run_trace("lru", 100, trace);
+    double lru_filtered = run_trace("lru", 100, trace, true);
+    double clock_filtered = run_trace("clock", 100, trace, true);
+    double arc_filtered = run_trace("arc", 100, trace, true);
+    std::cout << "  hot set + long tail: lru " << lru << " lru+tinylfu " << lru_filtered
+              << " clock+tinylfu " << clock_filtered << " arc+tinylfu " << arc_filtered << std::endl;
+
+    assert(lru_filtered > lru + 0.05);
+    assert(clock_filtered > lru + 0.05);
+    assert(arc_filtered > lru + 0.05);
+    std::cout << "✓ TinyLFU long tail test passed" << std::endl;
+}
+
 int main()
 {
     std::cout << "Running Eviction Strategy Tests\n"
@@ -144,9 +350,14 @@ int main()
     test_lru_respects_refcount();
     test_lru_respects_lock();
     test_clock_eviction_basic();
+    test_clock_second_chance();
     test_clock_respects_refcount();
     test_clock_respects_lock();
     test_eviction_with_all_locked();
+    test_arc_scan_resistance();
+    test_arc_ghost_adaptation();
+    test_frequency_sketch();
+    test_tinylfu_long_tail();
 
     std::cout << "\n✓ All eviction tests passed!" << std::endl;
     return 0;
@@ -1,8 +1,33 @@
 #include <iostream>
+#include <array>
+#include <atomic>
+#include <mutex>
 #include <cassert>
+#include <cerrno>
+#include <chrono>
 #include <cstring>
+#include <future>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
 #include "cache/Page.h"
 #include "cache/PageCache.h"
+#include "cache/PageRef.h"
+#include "cache/FlatPageMap.h"
+#include "cache/PageFramePool.h"
+#include "cache/Epoch.h"
+#include "io/DirtyThrottle.h"
+#include "io/IOEngine.h"
+#include "io/Readahead.h"
+#include "io/Writeback.h"
+#include "metrics/Counters.h"
+#include "metrics/LatencyHistogram.h"
+#include "fs/File.h"
+#include "fs/Inode.h"
+#include "scheduler/EventLoop.h"
+#include "scheduler/IOScheduler.h"
+#include "scheduler/IOThreadPool.h"
 
 using namespace pagecache;
 
@@ -152,12 +177,1713 @@ void test_dirty_tracking()
     assert(cache.clean_pages() == 1);
     assert(cache.dirty_pages() == 0);
 
-    page->set_state(PageState::Dirty);
+    [[maybe_unused]] bool dirtied = cache.mark_dirty(page);
+    [[maybe_unused]] bool redirtied = cache.mark_dirty(page);
+    assert(dirtied && !redirtied);
+    assert(page->state() == PageState::Dirty);
     assert(cache.dirty_pages() == 1);
+    assert(cache.clean_pages() == 0);
+
+    [[maybe_unused]] bool cleaned = cache.mark_clean(page);
+    assert(cleaned);
+    assert(cache.dirty_pages() == 0);
 
     std::cout << "✓ Dirty tracking test passed" << std::endl;
 }
 
+void test_file_page_stats()
+{
+    PageCache cache(4, 1);
+
+    auto loader = [](uint8_t *)
+    { return true; };
+
+    auto a0 = cache.get_or_load(1, 0, loader);
+    auto a1 = cache.get_or_load(1, 1, loader);
+    auto b0 = cache.get_or_load(2, 0, loader);
+    cache.mark_dirty(a0);
+    cache.mark_dirty(b0);
+
+    assert(cache.total_pages() == 3);
+    assert(cache.dirty_pages() == 2);
+    assert(cache.file_resident_pages(1) == 2);
+    assert(cache.file_dirty_pages(1) == 1);
+    assert(cache.file_resident_pages(2) == 1);
+    assert(cache.file_dirty_pages(2) == 1);
+    assert(cache.file_resident_pages(3) == 0);
+
+    // Eviction passes over the dirty page of file 1 for its clean one;
+    // replacing file 2's dirty page comes off the counters.
+    cache.get_or_load(2, 1, loader);
+    cache.get_or_load(2, 2, loader);
+    assert(cache.get_page(1, 0) != nullptr && cache.get_page(1, 1) == nullptr);
+    assert(cache.file_resident_pages(1) == 1);
+    assert(cache.file_dirty_pages(1) == 1);
+
+    cache.insert_page(2, 0, std::make_shared<Page>(0));
+    assert(cache.file_resident_pages(2) == 3);
+    assert(cache.file_dirty_pages(2) == 0);
+    assert(cache.total_pages() == 4);
+    assert(cache.dirty_pages() == 1);
+
+    // A page that has left the cache no longer moves the counters.
+    cache.mark_clean(b0);
+    cache.mark_dirty(b0);
+    assert(cache.dirty_pages() == 1);
+
+    std::cout << "✓ File page stats test passed" << std::endl;
+}
+
+void test_lru_order()
+{
+    PageCache cache(3, 1);
+
+    auto loader = [](uint8_t *data)
+    {
+        std::memset(data, 'g', Page::PAGE_SIZE);
+        return true;
+    };
+
+    cache.get_or_load(8, 0, loader);
+    cache.get_or_load(8, 1, loader);
+    cache.get_or_load(8, 2, loader);
+
+    cache.get_or_load(8, 0, loader);
+    cache.get_or_load(8, 3, loader);
+
+    assert(cache.get_page(8, 0) != nullptr);
+    assert(cache.get_page(8, 1) == nullptr);
+    assert(cache.get_page(8, 2) != nullptr);
+    assert(cache.get_page(8, 3) != nullptr);
+
+    auto replacement = std::make_shared<Page>(0);
+    cache.insert_page(8, 2, replacement);
+    assert(cache.get_page(8, 2) == replacement);
+    assert(replacement->file_id() == 8 && replacement->index() == 2);
+    assert(cache.total_pages() == 3);
+
+    cache.get_or_load(8, 4, loader);
+    assert(cache.get_page(8, 0) == nullptr);
+    assert(cache.get_page(8, 2) == replacement);
+
+    std::cout << "✓ LRU order test passed" << std::endl;
+}
+
+void test_flat_page_map()
+{
+    FlatPageMap map;
+    std::vector<std::shared_ptr<Page>> pages;
+
+    for (uint64_t i = 0; i < 5000; ++i)
+    {
+        pages.push_back(std::make_shared<Page>(i % 7, i));
+        [[maybe_unused]] bool inserted = map.insert_or_assign(pages.back());
+        assert(inserted);
+    }
+    assert(map.size() == 5000);
+    [[maybe_unused]] bool replaced = !map.insert_or_assign(pages[3]);
+    assert(replaced);
+
+    for (uint64_t i = 0; i < 5000; i += 2)
+    {
+        [[maybe_unused]] std::shared_ptr<Page> erased = map.erase({i % 7, i});
+        assert(erased == pages[i]);
+    }
+    [[maybe_unused]] std::shared_ptr<Page> missing = map.erase({0, 0});
+    assert(missing == nullptr);
+    assert(map.size() == 2500);
+
+    for (uint64_t i = 0; i < 5000; ++i)
+    {
+        [[maybe_unused]] Page *found = map.find({i % 7, i});
+        assert((found != nullptr) == (i % 2 == 1));
+        assert(!found || found == pages[i].get());
+    }
+
+    std::vector<std::shared_ptr<Page>> churn;
+    for (uint64_t i = 0; i < 1000; ++i)
+    {
+        churn.push_back(std::make_shared<Page>(99, i));
+    }
+    for (int round = 0; round < 20; ++round)
+    {
+        for (auto &page : churn)
+        {
+            map.insert_or_assign(page);
+        }
+        for (auto &page : churn)
+        {
+            map.erase({page->file_id(), page->index()});
+        }
+    }
+    assert(map.size() == 2500);
+
+    auto low = std::make_shared<Page>(1, 5);
+    auto high = std::make_shared<Page>(1, (uint64_t(1) << 32) + 5);
+    map.insert_or_assign(high);
+    map.insert_or_assign(low);
+    assert(map.find({1, (uint64_t(1) << 32) + 5}) == high.get());
+    assert(map.find({1, 5}) == low.get());
+
+    std::cout << "✓ FlatPageMap test passed" << std::endl;
+}
+
+void test_frame_pool()
+{
+    auto pool = std::make_shared<PageFramePool>(64);
+    std::vector<uint8_t *> frames;
+
+    for (int i = 0; i < 64; ++i)
+    {
+        uint8_t *frame = pool->allocate();
+        assert(frame != nullptr);
+        assert(reinterpret_cast<uintptr_t>(frame) % Page::PAGE_SIZE == 0);
+        assert(pool->contains(frame));
+        std::memset(frame, i, Page::PAGE_SIZE);
+        frames.push_back(frame);
+    }
+    [[maybe_unused]] uint8_t *exhausted = pool->allocate();
+    assert(exhausted == nullptr);
+    assert(pool->frames_in_use() == 64);
+
+    {
+        Page overflow(1, 0, pool);
+        assert(!overflow.pooled());
+        assert(reinterpret_cast<uintptr_t>(overflow.data()) % Page::PAGE_SIZE == 0);
+    }
+
+    pool->release(frames[10]);
+    {
+        Page borrowed(1, 1, pool);
+        assert(borrowed.pooled());
+        assert(borrowed.data() == frames[10]);
+    }
+    assert(pool->frames_in_use() == 63);
+
+    for (uint8_t *frame : frames)
+    {
+        if (frame != frames[10])
+        {
+            pool->release(frame);
+        }
+    }
+    assert(pool->frames_in_use() == 0);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&pool, t]()
+                             {
+            std::vector<uint8_t *> held;
+            for (int round = 0; round < 5000; ++round)
+            {
+                uint8_t *frame = pool->allocate();
+                if (frame)
+                {
+                    frame[0] = (uint8_t)t;
+                    held.push_back(frame);
+                }
+                if (held.size() > 8 || (!frame && !held.empty()))
+                {
+                    assert(held.front()[0] == (uint8_t)t);
+                    pool->release(held.front());
+                    held.erase(held.begin());
+                }
+            }
+            for (uint8_t *frame : held)
+            {
+                pool->release(frame);
+            } });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    assert(pool->frames_in_use() == 0);
+
+    PageCache cache(16, 1);
+    auto loader = [](uint8_t *)
+    { return true; };
+    for (uint64_t i = 0; i < 100; ++i)
+    {
+        std::shared_ptr<Page> page = cache.get_or_load(9, i, loader);
+        assert(page->pooled());
+    }
+    // Evicted frames return to the pool once no reader can still see them.
+    EpochDomain::global().synchronize();
+    assert(cache.frame_pool().frames_in_use() == 16);
+
+    std::cout << "✓ Page frame pool test passed" << std::endl;
+}
+
+void test_sharded_capacity()
+{
+    PageCache cache(1024, 8);
+    assert(cache.num_shards() == 8);
+
+    auto loader = [](uint8_t *data)
+    {
+        std::memset(data, 'f', Page::PAGE_SIZE);
+        return true;
+    };
+
+    for (uint64_t i = 0; i < 4096; ++i)
+    {
+        cache.get_or_load(6, i, loader);
+    }
+    assert(cache.total_pages() <= 1024);
+
+    cache.evict_to_target(100);
+    assert(cache.total_pages() <= 100);
+
+    PageCache tiny(3, 16);
+    assert(tiny.num_shards() == 1);
+
+    std::cout << "✓ Sharded capacity test passed" << std::endl;
+}
+
+void test_concurrent_get_or_load()
+{
+    PageCache cache(4096, 16);
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&cache, t]()
+                             {
+            for (uint64_t i = 0; i < 2000; ++i)
+            {
+                uint64_t page_index = (i * 7 + t) % 512;
+                auto page = cache.get_or_load(7, page_index, [page_index](uint8_t *data)
+                                              {
+                    std::memset(data, (int)(page_index & 0xff), Page::PAGE_SIZE);
+                    return true; });
+                assert(page != nullptr);
+                assert(page->data()[0] == (uint8_t)(page_index & 0xff));
+            } });
+    }
+
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    assert(cache.total_pages() == 512);
+    std::cout << "✓ Concurrent get_or_load test passed" << std::endl;
+}
+
+void test_miss_deduplication()
+{
+    PageCache cache(1024, 4);
+    std::atomic<int> loads(0);
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+
+    auto slow_loader = [&loads](uint8_t *data)
+    {
+        loads++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        std::memset(data, 0x5a, Page::PAGE_SIZE);
+        return true;
+    };
+
+    for (int t = 0; t < 8; ++t)
+    {
+        threads.emplace_back([&]()
+                             {
+            while (!go)
+            {
+                std::this_thread::yield();
+            }
+            auto page = cache.get_or_load(9, 1, slow_loader);
+            assert(page != nullptr);
+            assert(page->data()[Page::PAGE_SIZE - 1] == 0x5a); });
+    }
+    go = true;
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    assert(loads == 1);
+    assert(cache.total_pages() == 1);
+
+    // A failed read is reported to every waiter and leaves nothing cached.
+    loads = 0;
+    go = false;
+    threads.clear();
+    for (int t = 0; t < 8; ++t)
+    {
+        threads.emplace_back([&]()
+                             {
+            while (!go)
+            {
+                std::this_thread::yield();
+            }
+            auto page = cache.get_or_load(9, 2, [&loads](uint8_t *)
+                                          {
+                loads++;
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                return false; });
+            assert(page == nullptr); });
+    }
+    go = true;
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    assert(loads >= 1 && loads < 8);
+    assert(cache.get_page(9, 2) == nullptr);
+    assert(cache.total_pages() == 1);
+
+    std::cout << "✓ Miss deduplication test passed" << std::endl;
+}
+
+void test_pinned_page_refs()
+{
+    PageCache cache(64, 1);
+    auto loader = [](uint8_t *data)
+    {
+        std::memset(data, 0x33, Page::PAGE_SIZE);
+        return true;
+    };
+
+    PageRef pinned = cache.pin_or_load(13, 0, loader);
+    assert(pinned && pinned.size() == Page::PAGE_SIZE);
+    assert(pinned.page()->refcount() == 1);
+
+    for (uint64_t i = 1; i < 256; ++i)
+    {
+        cache.get_or_load(13, i, loader);
+    }
+    assert(cache.get_page(13, 0) == pinned.page());
+    assert(pinned.data()[0] == 0x33);
+
+    pinned.narrow(100, 10);
+    assert(pinned.data() == pinned.page()->data() + 100 && pinned.size() == 10);
+
+    PageRef moved = std::move(pinned);
+    assert(!pinned && moved.page()->refcount() == 1);
+    auto page = moved.page();
+    moved.reset();
+    assert(page->refcount() == 0);
+
+    std::cout << "✓ Pinned page reference test passed" << std::endl;
+}
+
+void test_range_load()
+{
+    PageCache cache(1024, 4);
+    std::vector<std::pair<uint64_t, size_t>> calls;
+    PageCache::RangeLoader loader = [&calls](uint64_t first_page, uint8_t *const *frames, size_t count)
+    {
+        calls.emplace_back(first_page, count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            std::memset(frames[i], (int)(first_page + i), Page::PAGE_SIZE);
+        }
+        // Pages from 30 on do not exist.
+        return first_page + count <= 30 ? count : (first_page < 30 ? 30 - first_page : 0);
+    };
+
+    cache.get_or_load(21, 4, [](uint8_t *data)
+                      { std::memset(data, 4, Page::PAGE_SIZE); return true; });
+
+    auto pages = cache.get_or_load_range(21, 0, 10, loader);
+    assert(pages.size() == 10);
+    for (size_t i = 0; i < pages.size(); ++i)
+    {
+        assert(pages[i].page()->index() == i && pages[i].data()[0] == i);
+        assert(pages[i].page()->refcount() == 1);
+    }
+    // One read on each side of the resident page.
+    assert(calls.size() == 2);
+    assert(calls[0] == std::make_pair(uint64_t(0), size_t(4)));
+    assert(calls[1] == std::make_pair(uint64_t(5), size_t(5)));
+
+    calls.clear();
+    auto again = cache.get_or_load_range(21, 0, 10, loader);
+    assert(again.size() == 10 && calls.empty());
+
+    // A run that runs off the end stops at the first missing page.
+    auto tail = cache.get_or_load_range(21, 25, 10, loader);
+    assert(tail.size() == 5);
+    assert(cache.get_page(21, 30) == nullptr);
+    assert(cache.total_pages() == 15);
+
+    pages.clear();
+    again.clear();
+    tail.clear();
+    assert(cache.get_page(21, 0)->refcount() == 0);
+
+    std::cout << "✓ Range load test passed" << std::endl;
+}
+
+void test_io_engine()
+{
+    const char *path = "/tmp/pagecache_io_engine_test.dat";
+    std::vector<uint8_t> contents(8 * Page::PAGE_SIZE);
+    for (size_t i = 0; i < contents.size(); ++i)
+    {
+        contents[i] = (uint8_t)(i * 31 + i / Page::PAGE_SIZE);
+    }
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+    [[maybe_unused]] ssize_t seeded = pwrite(fd, contents.data(), contents.size(), 0);
+    assert(seeded == (ssize_t)contents.size());
+
+    auto pool = std::make_shared<PageFramePool>(8);
+    for (auto engine : {IOEngine::create(8, pool), std::shared_ptr<IOEngine>(new SyncIOEngine())})
+    {
+        uint8_t *frames[4];
+        struct iovec iov[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            frames[i] = pool->allocate();
+            iov[i] = {frames[i], Page::PAGE_SIZE};
+        }
+
+        // One frame in the registered pool, then a vectored run.
+        [[maybe_unused]] ssize_t result = engine->read(fd, 2 * Page::PAGE_SIZE, iov, 1);
+        assert(result == (ssize_t)Page::PAGE_SIZE);
+        assert(std::memcmp(frames[0], &contents[2 * Page::PAGE_SIZE], Page::PAGE_SIZE) == 0);
+        result = engine->read(fd, 4 * Page::PAGE_SIZE, iov, 4);
+        assert(result == (ssize_t)(4 * Page::PAGE_SIZE));
+        for (int i = 0; i < 4; ++i)
+        {
+            assert(std::memcmp(frames[i], &contents[(4 + i) * Page::PAGE_SIZE], Page::PAGE_SIZE) == 0);
+        }
+
+        // Batched completions, then a short read at end of file.
+        std::atomic<int> done(0);
+        for (int i = 0; i < 4; ++i)
+        {
+            engine->queue_read(fd, i * Page::PAGE_SIZE, &iov[i], 1, [&done]([[maybe_unused]] ssize_t result)
+                               {
+                assert(result == (ssize_t)Page::PAGE_SIZE);
+                done++; });
+        }
+        engine->submit();
+        while (done < 4)
+        {
+            std::this_thread::yield();
+        }
+        assert(std::memcmp(frames[3], &contents[3 * Page::PAGE_SIZE], Page::PAGE_SIZE) == 0);
+        result = engine->read(fd, 7 * Page::PAGE_SIZE + 100, iov, 1);
+        assert(result == (ssize_t)(Page::PAGE_SIZE - 100));
+
+        // A request with no buffers transfers nothing.
+        result = engine->read(fd, 0, nullptr, 0);
+        assert(result == 0);
+
+        std::memset(frames[0], 0x7e, Page::PAGE_SIZE);
+        result = engine->write(fd, 8 * Page::PAGE_SIZE, iov, 1);
+        assert(result == (ssize_t)Page::PAGE_SIZE);
+        [[maybe_unused]] uint8_t check = 0;
+        result = pread(fd, &check, 1, 9 * Page::PAGE_SIZE - 1);
+        assert(result == 1 && check == 0x7e);
+        [[maybe_unused]] int truncated = ftruncate(fd, contents.size());
+        assert(truncated == 0);
+
+        for (int i = 0; i < 4; ++i)
+        {
+            pool->release(frames[i]);
+        }
+    }
+
+    close(fd);
+    unlink(path);
+    std::cout << "✓ I/O engine test passed" << std::endl;
+}
+
+void test_io_scheduler()
+{
+    const char *path = "/tmp/pagecache_io_scheduler_test.dat";
+    std::vector<uint8_t> contents(16 * Page::PAGE_SIZE + 100);
+    for (size_t i = 0; i < contents.size(); ++i)
+    {
+        contents[i] = (uint8_t)(i * 7 + i / Page::PAGE_SIZE);
+    }
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+    [[maybe_unused]] ssize_t seeded = pwrite(fd, contents.data(), contents.size(), 0);
+    assert(seeded == (ssize_t)contents.size());
+
+    // Everything queued below is held together until submit() unplugs it;
+    // the plug window is far too long for anything to go out on its clock.
+    for (auto engine : {IOEngine::create(8), std::shared_ptr<IOEngine>(new SyncIOEngine())})
+    {
+        IOScheduler scheduler(engine, std::chrono::seconds(10));
+        [[maybe_unused]] IOScheduler::Clock::time_point start = IOScheduler::Clock::now();
+        std::vector<std::vector<uint8_t>> frames(12, std::vector<uint8_t>(Page::PAGE_SIZE));
+        std::vector<ssize_t> results(12, 0);
+        std::atomic<int> done(0);
+        auto read_page = [&](int slot, uint64_t page)
+        {
+            struct iovec iov = {frames[slot].data(), Page::PAGE_SIZE};
+            scheduler.queue_read(fd, page * Page::PAGE_SIZE, &iov, 1, [&, slot](ssize_t result)
+                                 {
+                results[slot] = result;
+                done++; });
+        };
+
+        // Pages 4-11 out of order, which merge into one read, page 0 on
+        // its own, and the three pages from 14, the last one short.
+        for (int page : {7, 4, 6, 5, 11, 9, 8, 10})
+        {
+            read_page(page - 4, page);
+        }
+        read_page(8, 0);
+        for (int page : {16, 14, 15})
+        {
+            read_page(9 + page - 14, page);
+        }
+        scheduler.submit();
+        while (done < 12)
+        {
+            std::this_thread::yield();
+        }
+        assert(IOScheduler::Clock::now() - start < std::chrono::seconds(5));
+
+        for (int page = 4; page < 12; ++page)
+        {
+            assert(results[page - 4] == (ssize_t)Page::PAGE_SIZE);
+            assert(std::memcmp(frames[page - 4].data(), &contents[page * Page::PAGE_SIZE], Page::PAGE_SIZE) == 0);
+        }
+        assert(results[8] == (ssize_t)Page::PAGE_SIZE);
+        assert(std::memcmp(frames[8].data(), &contents[0], Page::PAGE_SIZE) == 0);
+        assert(results[9] == (ssize_t)Page::PAGE_SIZE && results[10] == (ssize_t)Page::PAGE_SIZE);
+        assert(results[11] == 100 && std::memcmp(frames[11].data(), &contents[16 * Page::PAGE_SIZE], 100) == 0);
+
+        [[maybe_unused]] IOScheduler::Stats stats = scheduler.stats();
+        assert(stats.requests == 12 && stats.merged == 9 && stats.dispatched == 3);
+        assert(stats.average_request_bytes() == 4.0 * Page::PAGE_SIZE);
+
+        // Adjacent writes merge the same way.
+        std::memset(frames[0].data(), 0x5a, Page::PAGE_SIZE);
+        std::memset(frames[1].data(), 0xa5, Page::PAGE_SIZE);
+        done = 0;
+        for (int i : {1, 0})
+        {
+            struct iovec iov = {frames[i].data(), Page::PAGE_SIZE};
+            scheduler.queue_write(fd, (2 + i) * Page::PAGE_SIZE, &iov, 1, [&]([[maybe_unused]] ssize_t result)
+                                  {
+                assert(result == (ssize_t)Page::PAGE_SIZE);
+                done++; });
+        }
+        scheduler.submit();
+        while (done < 2)
+        {
+            std::this_thread::yield();
+        }
+        assert(IOScheduler::Clock::now() - start < std::chrono::seconds(5));
+        [[maybe_unused]] uint8_t check[2];
+        [[maybe_unused]] ssize_t first = pread(fd, &check[0], 1, 2 * Page::PAGE_SIZE);
+        [[maybe_unused]] ssize_t second = pread(fd, &check[1], 1, 3 * Page::PAGE_SIZE);
+        assert(first == 1 && check[0] == 0x5a);
+        assert(second == 1 && check[1] == 0xa5);
+        assert(scheduler.stats().merged == 10 && scheduler.stats().dispatched == 4);
+        [[maybe_unused]] ssize_t restored = pwrite(fd, &contents[2 * Page::PAGE_SIZE], 2 * Page::PAGE_SIZE,
+                                                   2 * Page::PAGE_SIZE);
+        assert(restored == (ssize_t)(2 * Page::PAGE_SIZE));
+    }
+
+    close(fd);
+    unlink(path);
+    std::cout << "✓ I/O scheduler test passed" << std::endl;
+}
+
+void test_direct_io_file()
+{
+    const char *path = "/tmp/pagecache_direct_io_test.dat";
+    std::vector<uint8_t> contents(3 * Page::PAGE_SIZE + 100);
+    for (size_t i = 0; i < contents.size(); ++i)
+    {
+        contents[i] = (uint8_t)(i * 13 + 1);
+    }
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    [[maybe_unused]] ssize_t seeded = pwrite(fd, contents.data(), contents.size(), 0);
+    assert(seeded == (ssize_t)contents.size());
+    close(fd);
+
+    // Falls back to buffered I/O where the file system refuses O_DIRECT.
+    auto inode = std::make_shared<Inode>(77, path);
+    fd = open(path, O_RDONLY | O_DIRECT);
+    inode->set_direct_io(fd >= 0);
+    if (fd < 0)
+    {
+        fd = open(path, O_RDONLY);
+    }
+    inode->set_file_descriptor(fd);
+    inode->set_size(contents.size());
+
+    auto cache = std::make_shared<PageCache>(256, 1);
+    File file(inode, FileMode::ReadOnly, cache, IOEngine::create(8, cache->shared_frame_pool()));
+
+    std::vector<uint8_t> buffer(contents.size() + 4096);
+    file.seek(1000);
+    [[maybe_unused]] size_t read = file.read(buffer.data(), buffer.size());
+    assert(read == contents.size() - 1000);
+    assert(std::memcmp(buffer.data(), &contents[1000], contents.size() - 1000) == 0);
+
+    // The tail page holds the last 100 bytes and zeroes past end of file.
+    auto pages = file.read_pages(3 * Page::PAGE_SIZE, Page::PAGE_SIZE);
+    assert(pages.size() == 1 && pages[0].size() == 100);
+    assert(std::memcmp(pages[0].data(), &contents[3 * Page::PAGE_SIZE], 100) == 0);
+    assert(pages[0].data()[100] == 0 && pages[0].data()[Page::PAGE_SIZE - 1] == 0);
+
+    close(fd);
+    unlink(path);
+    std::cout << "✓ Direct I/O file test passed" << (inode->direct_io() ? "" : " (buffered fallback)")
+              << std::endl;
+}
+
+// Hands each read at most 1000 bytes, as a read may come back short
+// well before the end of the file.
+class ShortReadEngine : public IOEngine
+{
+public:
+    void queue_read(int fd, uint64_t offset, const struct iovec *iov, size_t iovcnt, Completion done) override
+    {
+        std::vector<struct iovec> head;
+        size_t left = 1000;
+        for (size_t i = 0; i < iovcnt && left > 0; ++i)
+        {
+            head.push_back({iov[i].iov_base, std::min(iov[i].iov_len, left)});
+            left -= head.back().iov_len;
+        }
+        reads++;
+        inner_.queue_read(fd, offset, head.data(), head.size(), std::move(done));
+    }
+    void queue_write(int fd, uint64_t offset, const struct iovec *iov, size_t iovcnt, Completion done) override
+    {
+        inner_.queue_write(fd, offset, iov, iovcnt, std::move(done));
+    }
+    void submit() override {}
+    const char *name() const override { return "short"; }
+    unsigned queue_depth() const override { return 1; }
+
+    size_t reads = 0;
+
+private:
+    SyncIOEngine inner_;
+};
+
+void test_short_reads()
+{
+    const char *path = "/tmp/pagecache_short_read_test.dat";
+    std::vector<uint8_t> contents(3 * Page::PAGE_SIZE + 100);
+    for (size_t i = 0; i < contents.size(); ++i)
+    {
+        contents[i] = (uint8_t)(i * 7 + 3);
+    }
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+    [[maybe_unused]] ssize_t seeded = pwrite(fd, contents.data(), contents.size(), 0);
+    assert(seeded == (ssize_t)contents.size());
+
+    // The file runs a page past what is on disk, and that part reads as
+    // a hole once a read returns nothing.
+    auto inode = std::make_shared<Inode>(82, path);
+    inode->set_file_descriptor(fd);
+    inode->set_size(contents.size() + Page::PAGE_SIZE);
+    auto cache = std::make_shared<PageCache>(256, 1);
+    auto engine = std::make_shared<ShortReadEngine>();
+    File file(inode, FileMode::ReadOnly, cache, engine);
+
+    std::vector<uint8_t> buffer(inode->size());
+    [[maybe_unused]] size_t read = file.read(buffer.data(), buffer.size());
+    assert(read == buffer.size());
+    assert(std::memcmp(buffer.data(), contents.data(), contents.size()) == 0);
+    for (size_t i = contents.size(); i < buffer.size(); ++i)
+    {
+        assert(buffer[i] == 0);
+    }
+    assert(engine->reads > 1);
+
+    close(fd);
+    unlink(path);
+    std::cout << "✓ Short read test passed" << std::endl;
+}
+
+void test_writeback()
+{
+    const char *path = "/tmp/pagecache_writeback_test.dat";
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+
+    auto inode = std::make_shared<Inode>(78, path);
+    inode->set_file_descriptor(fd);
+    auto cache = std::make_shared<PageCache>(256, 4);
+    WritebackEngine writeback(cache, IOEngine::create(8, cache->shared_frame_pool()), 2);
+    writeback.register_inode(inode);
+    File file(inode, FileMode::ReadWrite, cache);
+
+    // Pages 0-2 and 5, with a short tail page.
+    std::vector<uint8_t> first(3 * Page::PAGE_SIZE, 0xa1);
+    std::vector<uint8_t> tail(Page::PAGE_SIZE / 2, 0xb2);
+    [[maybe_unused]] size_t written = file.write(first.data(), first.size());
+    assert(written == first.size());
+    file.seek(5 * Page::PAGE_SIZE);
+    written = file.write(tail.data(), tail.size());
+    assert(written == tail.size());
+    assert(cache->dirty_pages() == 4 && cache->file_dirty_pages(78) == 4);
+
+    [[maybe_unused]] size_t flushed = writeback.flush_dirty_pages();
+    assert(flushed == 4);
+    assert(cache->dirty_pages() == 0);
+    assert(lseek(fd, 0, SEEK_END) == (off_t)(5 * Page::PAGE_SIZE + tail.size()));
+
+    std::vector<uint8_t> disk(3 * Page::PAGE_SIZE);
+    [[maybe_unused]] ssize_t read = pread(fd, disk.data(), disk.size(), 0);
+    assert(read == (ssize_t)disk.size());
+    assert(disk == first);
+    read = pread(fd, disk.data(), tail.size(), 5 * Page::PAGE_SIZE);
+    assert(read == (ssize_t)tail.size());
+    assert(std::memcmp(disk.data(), tail.data(), tail.size()) == 0);
+
+    // A write that lands during writeback leaves the page dirty.
+    auto page = cache->get_page(78, 1);
+    cache->mark_dirty(page);
+    [[maybe_unused]] bool began = cache->begin_writeback(page);
+    [[maybe_unused]] bool began_again = cache->begin_writeback(page);
+    assert(began && !began_again && page->state() == PageState::Writeback);
+    cache->mark_dirty(page);
+    cache->end_writeback(page, true);
+    assert(page->state() == PageState::Dirty && cache->dirty_pages() == 1);
+    writeback.fsync(78);
+    assert(page->state() == PageState::Clean && page->refcount() == 0);
+
+    close(fd);
+    unlink(path);
+    std::cout << "✓ Writeback test passed" << std::endl;
+}
+
+void test_append_during_sync()
+{
+    const char *path = "/tmp/pagecache_append_sync_test.dat";
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+
+    auto inode = std::make_shared<Inode>(81, path);
+    inode->set_file_descriptor(fd);
+    auto cache = std::make_shared<PageCache>(4096, 4);
+    WritebackEngine writeback(cache, IOEngine::create(8, cache->shared_frame_pool()), 2);
+    writeback.register_inode(inode);
+    File file(inode, FileMode::ReadWrite, cache);
+
+    // Appends that keep starting new pages while another thread
+    // writes back whatever is dirty.
+    std::vector<uint8_t> expected;
+    std::atomic<bool> appending(true);
+    std::thread flusher([&]()
+                        {
+        while (appending)
+        {
+            writeback.flush_dirty_pages();
+        } });
+    for (size_t i = 0; i < 400; ++i)
+    {
+        std::vector<uint8_t> data(3 * Page::PAGE_SIZE + 700, (uint8_t)(i + 1));
+        [[maybe_unused]] size_t written = file.write(data.data(), data.size());
+        assert(written == data.size());
+        expected.insert(expected.end(), data.begin(), data.end());
+    }
+    appending = false;
+    flusher.join();
+
+    writeback.fsync(81);
+    assert(cache->file_dirty_pages(81) == 0);
+    std::vector<uint8_t> disk(expected.size());
+    [[maybe_unused]] ssize_t read = pread(fd, disk.data(), disk.size(), 0);
+    assert(read == (ssize_t)disk.size() && disk == expected);
+
+    close(fd);
+    unlink(path);
+    std::cout << "✓ Append during sync test passed" << std::endl;
+}
+
+// Runs after each completed write, as another writer would between a
+// sync's writes.
+class RedirtyEngine : public SyncIOEngine
+{
+public:
+    void queue_write(int fd, uint64_t offset, const struct iovec *iov, size_t iovcnt, Completion done) override
+    {
+        SyncIOEngine::queue_write(fd, offset, iov, iovcnt, [this, done](ssize_t result)
+                                  {
+            done(result);
+            if (after_write)
+            {
+                after_write();
+            } });
+    }
+
+    std::function<void()> after_write;
+};
+
+void test_sync_under_writers()
+{
+    const char *path = "/tmp/pagecache_sync_writers_test.dat";
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+
+    auto inode = std::make_shared<Inode>(83, path);
+    inode->set_file_descriptor(fd);
+    auto cache = std::make_shared<PageCache>(4096, 4);
+    auto engine = std::make_shared<RedirtyEngine>();
+    WritebackEngine writeback(cache, engine, 2);
+    writeback.register_inode(inode);
+    File file(inode, FileMode::ReadWrite, cache);
+    File other(inode, FileMode::ReadWrite, cache);
+
+    std::vector<uint8_t> synced(8 * Page::PAGE_SIZE, 0x5a);
+    [[maybe_unused]] size_t written = file.write(synced.data(), synced.size());
+    assert(written == synced.size());
+
+    // Another handle redirties page 0 and appends after every write; the
+    // sync only owes what was dirty when it started. Capped so that a sync
+    // chasing the writer still ends.
+    size_t rewrites = 0;
+    engine->after_write = [&]()
+    {
+        if (++rewrites > 1000)
+        {
+            return;
+        }
+        std::array<uint8_t, 100> data;
+        data.fill(0xa5);
+        other.seek(0);
+        other.write(data.data(), data.size());
+        other.seek(inode->size());
+        other.write(data.data(), data.size());
+    };
+    writeback.sync_range(83, 0, 0);
+    engine->after_write = nullptr;
+    assert(rewrites < 10);
+
+    // Pages 1-7 were only ever written before the sync.
+    std::vector<uint8_t> disk(7 * Page::PAGE_SIZE);
+    [[maybe_unused]] ssize_t read = pread(fd, disk.data(), disk.size(), Page::PAGE_SIZE);
+    assert(read == (ssize_t)disk.size());
+    assert(std::memcmp(disk.data(), &synced[Page::PAGE_SIZE], disk.size()) == 0);
+
+    close(fd);
+    unlink(path);
+    std::cout << "✓ Sync under writers test passed" << std::endl;
+}
+
+void test_partial_page_writes()
+{
+    const char *path = "/tmp/pagecache_partial_write_test.dat";
+    std::vector<uint8_t> expected(2 * Page::PAGE_SIZE + 100, 0x3c);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+    [[maybe_unused]] ssize_t seeded = pwrite(fd, expected.data(), expected.size(), 0);
+    assert(seeded == (ssize_t)expected.size());
+
+    auto inode = std::make_shared<Inode>(79, path);
+    inode->set_file_descriptor(fd);
+    inode->set_size(expected.size());
+    auto cache = std::make_shared<PageCache>(256, 1);
+    WritebackEngine writeback(cache, IOEngine::create(8, cache->shared_frame_pool()), 2);
+    writeback.register_inode(inode);
+    File file(inode, FileMode::ReadWrite, cache);
+
+    // Leave stale bytes in the frames the writes are about to get.
+    for (uint64_t i = 0; i < 8; ++i)
+    {
+        cache->get_or_load(80, i, [](uint8_t *data)
+                           { std::memset(data, 0xee, Page::PAGE_SIZE); return true; });
+    }
+    cache->evict_to_target(0);
+    EpochDomain::global().synchronize();
+
+    auto write_at = [&](uint64_t offset, size_t length, uint8_t value)
+    {
+        std::vector<uint8_t> data(length, value);
+        file.seek(offset);
+        [[maybe_unused]] size_t written = file.write(data.data(), data.size());
+        assert(written == length);
+        if (expected.size() < offset + length)
+        {
+            expected.resize(offset + length, 0);
+        }
+        std::memset(&expected[offset], value, length);
+    };
+
+    // Inside page 0, across pages 1-2 and past EOF, then into a page well
+    // past EOF, and finally into the hole that left at page 3, which is
+    // inside the file but not on disk yet.
+    write_at(100, 10, 0x11);
+    write_at(2 * Page::PAGE_SIZE - 100, 300, 0x22);
+    write_at(4 * Page::PAGE_SIZE + 10, 50, 0x33);
+    write_at(3 * Page::PAGE_SIZE + 7, 5, 0x44);
+    assert(inode->size() == expected.size());
+
+    std::vector<uint8_t> cached(expected.size());
+    file.seek(0);
+    [[maybe_unused]] size_t read = file.read(cached.data(), cached.size());
+    assert(read == expected.size() && cached == expected);
+
+    writeback.fsync(79);
+    std::vector<uint8_t> disk(expected.size());
+    [[maybe_unused]] ssize_t on_disk = pread(fd, disk.data(), disk.size(), 0);
+    assert(on_disk == (ssize_t)disk.size() && disk == expected);
+
+    close(fd);
+    unlink(path);
+    std::cout << "✓ Partial page write test passed" << std::endl;
+}
+
+void test_file_sync()
+{
+    const char *paths[] = {"/tmp/pagecache_sync_a.dat", "/tmp/pagecache_sync_b.dat"};
+    auto cache = std::make_shared<PageCache>(256, 4);
+    auto writeback = std::make_shared<WritebackEngine>(cache, nullptr, 2);
+    std::vector<std::shared_ptr<File>> files;
+    for (uint64_t i = 0; i < 2; ++i)
+    {
+        int fd = open(paths[i], O_RDWR | O_CREAT | O_TRUNC, 0644);
+        assert(fd >= 0);
+        auto inode = std::make_shared<Inode>(80 + i, paths[i]);
+        inode->set_file_descriptor(fd);
+        writeback->register_inode(inode);
+        files.push_back(std::make_shared<File>(inode, FileMode::ReadWrite, cache, nullptr, writeback));
+
+        std::vector<uint8_t> data(8 * Page::PAGE_SIZE, 0x40 + i);
+        [[maybe_unused]] size_t written = files[i]->write(data.data(), data.size());
+        assert(written == data.size());
+    }
+    assert(cache->file_dirty_pages(80) == 8 && cache->file_dirty_pages(81) == 8);
+    assert(cache->dirty_pages_in_range(80, 2, 4) == 3);
+
+    // Pages 2-4 only, and nothing of the other file.
+    [[maybe_unused]] int synced = files[0]->sync_range(2 * Page::PAGE_SIZE + 100, 2 * Page::PAGE_SIZE);
+    assert(synced == 0);
+    assert(cache->file_dirty_pages(80) == 5 && cache->dirty_pages_in_range(80, 2, 4) == 0);
+    assert(cache->file_dirty_pages(81) == 8);
+
+    auto dirty = cache->collect_dirty(80, 0, UINT64_MAX, 16);
+    assert(dirty.size() == 5 && dirty[0]->index() == 0 && dirty[2]->index() == 5);
+
+    synced = files[0]->sync();
+    assert(synced == 0);
+    assert(cache->file_dirty_pages(80) == 0 && cache->file_dirty_pages(81) == 8);
+    [[maybe_unused]] uint8_t byte = 0;
+    [[maybe_unused]] ssize_t read = pread(files[0]->inode()->file_descriptor(), &byte, 1, 7 * Page::PAGE_SIZE);
+    assert(read == 1 && byte == 0x40);
+
+    synced = files[1]->sync();
+    assert(synced == 0 && cache->dirty_pages() == 0);
+
+    for (uint64_t i = 0; i < 2; ++i)
+    {
+        close(files[i]->inode()->file_descriptor());
+        unlink(paths[i]);
+    }
+    std::cout << "✓ File sync test passed" << std::endl;
+}
+
+// Fails every write while failing is set.
+class FailingWriteEngine : public SyncIOEngine
+{
+public:
+    void queue_write(int fd, uint64_t offset, const struct iovec *iov, size_t iovcnt, Completion done) override
+    {
+        if (failing)
+        {
+            done(-EIO);
+            return;
+        }
+        SyncIOEngine::queue_write(fd, offset, iov, iovcnt, std::move(done));
+    }
+
+    std::atomic<bool> failing{false};
+};
+
+void test_sync_errors()
+{
+    const char *path = "/tmp/pagecache_sync_errors_test.dat";
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+
+    auto inode = std::make_shared<Inode>(84, path);
+    inode->set_file_descriptor(fd);
+    auto cache = std::make_shared<PageCache>(256, 1);
+    auto engine = std::make_shared<FailingWriteEngine>();
+    auto writeback = std::make_shared<WritebackEngine>(cache, engine, 2);
+    writeback->register_inode(inode);
+    File file(inode, FileMode::ReadWrite, cache, nullptr, writeback);
+
+    std::vector<uint8_t> data(4 * Page::PAGE_SIZE, 0x61);
+    [[maybe_unused]] size_t written = file.write(data.data(), data.size());
+    assert(written == data.size());
+
+    // A failed sync reports the error at once and leaves the pages dirty.
+    engine->failing = true;
+    [[maybe_unused]] int synced = file.sync();
+    assert(synced == -EIO && cache->file_dirty_pages(84) == 4);
+
+    // A background failure is held for the next sync, which reports it
+    // even though its own writes succeed, and only once.
+    [[maybe_unused]] size_t flushed = writeback->flush_dirty_pages();
+    assert(flushed == 0 && cache->file_dirty_pages(84) == 4);
+    engine->failing = false;
+    synced = writeback->fsync(0);
+    assert(synced == -EIO && cache->file_dirty_pages(84) == 0);
+    synced = file.sync();
+    assert(synced == 0);
+
+    std::vector<uint8_t> disk(data.size());
+    [[maybe_unused]] ssize_t read = pread(fd, disk.data(), disk.size(), 0);
+    assert(read == (ssize_t)disk.size() && disk == data);
+
+    close(fd);
+    unlink(path);
+    std::cout << "✓ Sync error test passed" << std::endl;
+}
+
+void test_async_file()
+{
+    const char *path = "/tmp/pagecache_async_file_test.dat";
+    const size_t file_pages = 96;
+    std::vector<uint8_t> contents(file_pages * Page::PAGE_SIZE);
+    for (size_t i = 0; i < contents.size(); ++i)
+    {
+        contents[i] = (uint8_t)(i / Page::PAGE_SIZE * 7 + i % 251);
+    }
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+    [[maybe_unused]] ssize_t seeded = pwrite(fd, contents.data(), contents.size(), 0);
+    assert(seeded == (ssize_t)contents.size());
+    auto inode = std::make_shared<Inode>(90, path);
+    inode->set_file_descriptor(fd);
+    inode->set_size(contents.size());
+
+    auto cache = std::make_shared<PageCache>(256, 4);
+    auto io = IOEngine::create(32, cache->shared_frame_pool());
+    auto writeback = std::make_shared<WritebackEngine>(cache, io, 2);
+    writeback->register_inode(inode);
+    File file(inode, FileMode::ReadWrite, cache, io, writeback);
+
+    // 64 reads of one page each in flight at once, plus 8 of one more
+    // page that share a single load.
+    std::vector<std::vector<uint8_t>> buffers(72, std::vector<uint8_t>(Page::PAGE_SIZE));
+    std::vector<size_t> results(buffers.size(), 0);
+    EventLoop loop;
+    for (size_t i = 0; i < buffers.size(); ++i)
+    {
+        uint64_t page = i < 64 ? i : 80;
+        loop.spawn([](File &file, uint64_t offset, uint8_t *buffer, size_t &result) -> Async<void>
+                   { result = co_await file.read_async(offset, buffer, Page::PAGE_SIZE); }(
+                       file, page * Page::PAGE_SIZE, buffers[i].data(), results[i]));
+    }
+    loop.run();
+    for (size_t i = 0; i < buffers.size(); ++i)
+    {
+        [[maybe_unused]] uint64_t page = i < 64 ? i : 80;
+        assert(results[i] == Page::PAGE_SIZE);
+        assert(std::memcmp(buffers[i].data(), &contents[page * Page::PAGE_SIZE], Page::PAGE_SIZE) == 0);
+    }
+    assert(file.offset() == 0);
+
+    // All hits: the read completes without suspending, so the loop only
+    // starts the task.
+    std::vector<uint8_t> all(64 * Page::PAGE_SIZE + 1000);
+    size_t hit_result = 0;
+    EventLoop hit_loop;
+    hit_loop.spawn([](File &file, uint8_t *buffer, size_t count, size_t &result) -> Async<void>
+                   { result = co_await file.read_async(1000, buffer, count); }(
+                       file, all.data(), 63 * Page::PAGE_SIZE, hit_result));
+    hit_loop.run();
+    assert(hit_result == 63 * Page::PAGE_SIZE && hit_loop.resumptions() == 1);
+    assert(std::memcmp(all.data(), &contents[1000], hit_result) == 0);
+
+    // Write across a page boundary, past the pages read so far, then sync.
+    std::vector<uint8_t> data(Page::PAGE_SIZE + 200, 0x5A);
+    uint64_t write_offset = 70 * Page::PAGE_SIZE - 100;
+    size_t written = 0;
+    int synced = -1;
+    EventLoop write_loop;
+    write_loop.spawn([](File &file, uint64_t offset, const std::vector<uint8_t> &data, size_t &written,
+                        int &synced) -> Async<void>
+                     {
+        written = co_await file.write_async(offset, data.data(), data.size());
+        synced = co_await file.sync_async(); }(file, write_offset, data, written, synced));
+    write_loop.run();
+    assert(written == data.size() && synced == 0 && cache->file_dirty_pages(90) == 0);
+    std::vector<uint8_t> on_disk(data.size());
+    [[maybe_unused]] ssize_t read = pread(fd, on_disk.data(), on_disk.size(), write_offset);
+    assert(read == (ssize_t)on_disk.size() && on_disk == data);
+
+    close(fd);
+    unlink(path);
+    std::cout << "✓ Async file test passed" << std::endl;
+}
+
+void test_dirty_throttle()
+{
+    using std::chrono::milliseconds;
+    DirtyThrottle throttle(100, 200);
+    DirtyThrottle::Writer writer;
+
+    // Free below the midpoint of the limits, and for a writer within its
+    // rate above it.
+    auto pause = throttle.pause_for(writer, 256, 150);
+    assert(pause == DirtyThrottle::Clock::duration::zero());
+    pause = throttle.pause_for(writer, 1, 175);
+    assert(pause == DirtyThrottle::Clock::duration::zero());
+
+    // Halfway to the hard limit a writer gets half the bandwidth: 256
+    // pages at 12800 pages/s owe 20ms.
+    pause = throttle.pause_for(writer, 255, 175);
+    assert(pause > milliseconds(15) && pause <= milliseconds(20));
+    pause = throttle.pause_for(writer, 1, 200);
+    assert(pause == DirtyThrottle::MAX_PAUSE);
+
+    // At the hard limit a writer writes back itself when no background
+    // thread is running, so dirty pages stay bounded.
+    const char *path = "/tmp/pagecache_throttle_test.dat";
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+    auto inode = std::make_shared<Inode>(90, path);
+    inode->set_file_descriptor(fd);
+    auto cache = std::make_shared<PageCache>(256, 4);
+    auto writeback = std::make_shared<WritebackEngine>(cache, nullptr, 2);
+    writeback->set_dirty_limits(8, 16);
+    writeback->register_inode(inode);
+    File file(inode, FileMode::ReadWrite, cache, nullptr, writeback);
+
+    std::vector<uint8_t> data(4 * Page::PAGE_SIZE, 0x5a);
+    size_t max_dirty = 0;
+    for (int i = 0; i < 64; ++i)
+    {
+        [[maybe_unused]] size_t written = file.write(data.data(), data.size());
+        assert(written == data.size());
+        max_dirty = std::max(max_dirty, cache->dirty_pages());
+    }
+    assert(max_dirty < 16 + 4);
+    assert(throttle.write_bandwidth() == DirtyThrottle::INITIAL_BANDWIDTH);
+    assert(writeback->throttle().written_pages() >= 256 - 16 - 4);
+
+    close(fd);
+    unlink(path);
+    std::cout << "✓ Dirty throttle test passed" << std::endl;
+}
+
+void test_readahead()
+{
+    auto cache = std::make_shared<PageCache>(1024, 4);
+    Readahead readahead(cache, 128);
+
+    // Two streams read one page at a time: each ramps up on its own.
+    ReadaheadState a, b;
+    Readahead::Window w = readahead.on_read(a, 0, 1, false);
+    assert(w.start == 0 && w.size == 4 && !w.async && a.marker() == 1);
+    w = readahead.on_read(b, 5000, 1, false);
+    assert(w.size == 0);
+    w = readahead.on_read(b, 5001, 1, false);
+    assert(w.start == 5001 && w.size == 4);
+
+    w = readahead.on_read(a, 1, 1, true);
+    assert(w.start == 4 && w.size == 16 && w.async);
+    w = readahead.on_read(a, 2, 1, true);
+    assert(w.size == 0);
+    w = readahead.on_read(a, 3, 1, true);
+    assert(w.size == 0);
+    w = readahead.on_read(a, 4, 1, true);
+    assert(w.start == 20 && w.size == 32);
+    w = readahead.on_read(a, 20, 1, true);
+    assert(w.start == 52 && w.size == 64);
+    w = readahead.on_read(a, 52, 1, true);
+    assert(w.start == 116 && w.size == 128);
+    w = readahead.on_read(a, 116, 1, true);
+    assert(w.start == 244 && w.size == 128);
+
+    // A miss inside the window: its pages were evicted unread.
+    w = readahead.on_read(a, 300, 1, false);
+    assert(w.start == 300 && w.size == 64);
+
+    // A random miss gets nothing and forgets the window.
+    w = readahead.on_read(a, 9000, 1, false);
+    assert(w.size == 0 && a.size == 0);
+
+    // Through File: sequential page reads only miss on the first page.
+    const char *path = "/tmp/pagecache_readahead_test.dat";
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+    std::vector<uint8_t> data(256 * Page::PAGE_SIZE);
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        data[i] = (uint8_t)(i / Page::PAGE_SIZE);
+    }
+    [[maybe_unused]] ssize_t seeded = pwrite(fd, data.data(), data.size(), 0);
+    assert(seeded == (ssize_t)data.size());
+
+    auto inode = std::make_shared<Inode>(95, path);
+    inode->set_file_descriptor(fd);
+    inode->set_size(data.size());
+    File file(inode, FileMode::ReadOnly, cache, nullptr, nullptr,
+              std::make_shared<Readahead>(cache, 128));
+
+    std::vector<uint8_t> page(Page::PAGE_SIZE);
+    [[maybe_unused]] size_t read = file.read(page.data(), page.size());
+    assert(read == page.size() && page[0] == 0);
+    assert(cache->file_resident_pages(95) == 4);
+    for (size_t i = 1; i < 256; ++i)
+    {
+        [[maybe_unused]] size_t resident = cache->file_resident_pages(95);
+        read = file.read(page.data(), page.size());
+        assert(read == page.size() && page[0] == (uint8_t)i);
+        assert(resident > i);
+    }
+    assert(cache->file_resident_pages(95) == 256);
+
+    close(fd);
+    unlink(path);
+    std::cout << "✓ Readahead test passed" << std::endl;
+}
+
+void test_access_patterns()
+{
+    auto cache = std::make_shared<PageCache>(1024, 4);
+    Readahead readahead(cache, 128);
+
+    // Every 8th page: predicted once the stride repeats, four reads
+    // ahead, then eight when the reader is halfway there.
+    ReadaheadStreams strided;
+    std::vector<Readahead::Window> windows = readahead.on_read(strided, 1000, 1, false);
+    assert(windows.empty());
+    windows = readahead.on_read(strided, 1008, 1, false);
+    assert(windows.empty());
+    windows = readahead.on_read(strided, 1016, 1, false);
+    assert(windows.size() == 4 && windows[0].start == 1024 && windows[3].start == 1048);
+    assert(windows[0].size == 1 && windows[0].async);
+    windows = readahead.on_read(strided, 1024, 1, true);
+    assert(windows.empty());
+    windows = readahead.on_read(strided, 1032, 1, true);
+    assert(windows.size() == 6 && windows[0].start == 1056 && windows[5].start == 1096);
+
+    // Reading backwards, predictions merge into one window.
+    ReadaheadStreams reverse;
+    readahead.on_read(reverse, 500, 2, false);
+    readahead.on_read(reverse, 498, 2, false);
+    windows = readahead.on_read(reverse, 496, 2, false);
+    assert(windows.size() == 1 && windows[0].start == 488 && windows[0].size == 8);
+
+    // Two sequential scans of one file, interleaved, plus a random read.
+    ReadaheadStreams interleaved;
+    windows = readahead.on_read(interleaved, 0, 1, false);
+    assert(windows.size() == 1);
+    windows = readahead.on_read(interleaved, 5000, 1, false);
+    assert(windows.empty());
+    windows = readahead.on_read(interleaved, 1, 1, true);
+    assert(windows.size() == 1);
+    windows = readahead.on_read(interleaved, 77777, 1, false);
+    assert(windows.empty());
+    windows = readahead.on_read(interleaved, 5001, 1, false);
+    assert(windows.size() == 1 && windows[0].start == 5001 && windows[0].size == 4);
+    windows = readahead.on_read(interleaved, 2, 1, true);
+    assert(windows.empty());
+    windows = readahead.on_read(interleaved, 3, 1, true);
+    assert(windows.empty());
+    windows = readahead.on_read(interleaved, 4, 1, true);
+    assert(windows.size() == 1 && windows[0].start == 20);
+
+    std::cout << "✓ Access pattern test passed" << std::endl;
+}
+
+void test_async_readahead()
+{
+    auto cache = std::make_shared<PageCache>(1024, 4);
+    Readahead readahead(cache, 128, 1);
+
+    std::promise<void> gate;
+    std::shared_future<void> opened = gate.get_future().share();
+    auto slow_loader = [opened](std::vector<PageCache::LoadRun> &runs)
+    {
+        opened.wait();
+        for (PageCache::LoadRun &run : runs)
+        {
+            for (uint8_t *frame : run.frames)
+            {
+                std::memset(frame, 'r', Page::PAGE_SIZE);
+            }
+            run.complete(run.frames.size());
+        }
+    };
+
+    // The window returns at once with its pages indexed as loading, and a
+    // reader that gets there waits for the readahead I/O.
+    Readahead::Window first{0, 8, true};
+    readahead.submit(96, first, slow_loader);
+    assert(cache->contains(96, 7) && readahead.pages_in_flight() == 8);
+    auto reader = std::async(std::launch::async, [&cache]
+                             { return cache->get_page(96, 3); });
+
+    // Queued behind it, a window of a file whose queue gets cancelled.
+    auto queue = std::make_shared<Readahead::FileQueue>();
+    readahead.submit(96, {100, 8, true}, slow_loader, queue);
+    assert(cache->contains(96, 100));
+    queue->cancelled.store(true);
+
+    gate.set_value();
+    auto page = reader.get();
+    assert(page && page->data()[0] == 'r');
+    for (int i = 0; i < 1000 && readahead.pages_in_flight() > 0; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    assert(readahead.pages_in_flight() == 0);
+    assert(cache->get_page(96, 7) != nullptr);
+    assert(!cache->contains(96, 100) && cache->file_resident_pages(96) == 8);
+
+    // More than a quarter of the cache in flight is pressure.
+    assert(!readahead.under_pressure(256) && readahead.under_pressure(257));
+
+    std::cout << "✓ Async readahead test passed" << std::endl;
+}
+
+void test_io_thread_pool()
+{
+    // Small enough a slab that some submissions run inline.
+    IOThreadPool pool(4, 64);
+    std::atomic<size_t> ran(0);
+
+    // Tasks submitted from outside, each submitting another from its
+    // worker, and one too big to store inline.
+    std::vector<std::thread> submitters;
+    for (int t = 0; t < 2; ++t)
+    {
+        submitters.emplace_back([&]()
+                                {
+            for (int i = 0; i < 5000; ++i)
+            {
+                pool.submit([&pool, &ran]()
+                            {
+                    ran++;
+                    pool.submit([&ran]()
+                                { ran++; }); });
+            } });
+    }
+    for (auto &thread : submitters)
+    {
+        thread.join();
+    }
+    std::array<size_t, 16> big{};
+    big[15] = 1;
+    auto heavy = [big, &ran]()
+    { ran += big[15]; };
+    static_assert(!Task::fits_inline<decltype(heavy)>(), "expected a heap task");
+    pool.submit(heavy);
+
+    pool.wait_all();
+    assert(ran == 20001 && pool.pending() == 0);
+
+    // Workers sleep once idle, and wake for new work.
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    pool.submit([&ran]()
+                { ran++; });
+    pool.wait_all();
+    assert(ran == 20002);
+
+    // Queued tasks still run on shutdown.
+    IOThreadPool single(1);
+    std::atomic<int> drained(0);
+    for (int i = 0; i < 100; ++i)
+    {
+        single.submit([&drained]()
+                      { drained++; });
+    }
+    single.shutdown();
+    assert(drained == 100);
+
+    std::cout << "✓ IO thread pool test passed" << std::endl;
+}
+
+void test_io_priorities()
+{
+    IOThreadPool pool(1);
+    std::promise<void> gate, blocked;
+    std::shared_future<void> opened = gate.get_future().share();
+    pool.submit([opened, &blocked]()
+                {
+        blocked.set_value();
+        opened.wait(); },
+                IOPriority::Demand);
+    blocked.get_future().wait();
+
+    std::mutex order_lock;
+    std::vector<IOPriority> order;
+    auto record = [&](IOPriority priority)
+    {
+        return [&, priority]()
+        {
+            std::lock_guard<std::mutex> lock(order_lock);
+            order.push_back(priority);
+        };
+    };
+
+    // Queued least urgent first behind the blocked worker, the first
+    // background task with a deadline that passes while it waits. The
+    // rest get deadlines a slow run cannot reach.
+    const auto patient = std::chrono::seconds(10);
+    pool.submit(record(IOPriority::Sync), IOPriority::Background, std::chrono::microseconds(1));
+    for (int i = 0; i < 8; ++i)
+    {
+        pool.submit(record(IOPriority::Readahead), IOPriority::Readahead, patient);
+        pool.submit(record(IOPriority::Background), IOPriority::Background, patient);
+    }
+    for (int i = 0; i < 4; ++i)
+    {
+        pool.submit(record(IOPriority::Demand), IOPriority::Demand, patient);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    gate.set_value();
+    pool.wait_all();
+
+    // The overdue task, then demand, then readahead and background by
+    // weight, two to one.
+    assert(order.size() == 21 && pool.expired_runs() == 1);
+    assert(order[0] == IOPriority::Sync);
+    for (int i = 1; i <= 4; ++i)
+    {
+        assert(order[i] == IOPriority::Demand);
+    }
+    assert(order[5] == IOPriority::Readahead && order[6] == IOPriority::Readahead &&
+           order[7] == IOPriority::Background);
+
+    // A reader reaching a queued readahead window has it run first.
+    auto cache = std::make_shared<PageCache>(1024, 4);
+    auto shared = std::make_shared<IOThreadPool>(1);
+    Readahead readahead(cache, 128, 1, shared);
+    std::promise<void> held, busy;
+    std::shared_future<void> released = held.get_future().share();
+    shared->submit([released, &busy]()
+                   {
+        busy.set_value();
+        released.wait(); });
+    busy.get_future().wait();
+
+    std::vector<uint64_t> loaded;
+    auto loader = [&](std::vector<PageCache::LoadRun> &runs)
+    {
+        std::lock_guard<std::mutex> lock(order_lock);
+        for (PageCache::LoadRun &run : runs)
+        {
+            loaded.push_back(run.first_page);
+            run.complete(run.frames.size());
+        }
+    };
+    auto queue = std::make_shared<Readahead::FileQueue>();
+    readahead.submit(97, {0, 8, true}, loader, queue);
+    readahead.submit(97, {100, 8, true}, loader, queue);
+    assert(cache->loading(97, 104));
+    [[maybe_unused]] bool expedited = readahead.expedite(*queue, 104);
+    [[maybe_unused]] bool expedited_again = readahead.expedite(*queue, 104);
+    assert(expedited && !expedited_again);
+    held.set_value();
+    shared->wait_all();
+    assert(loaded.size() == 2 && loaded[0] == 100 && loaded[1] == 0);
+    assert(!cache->loading(97, 104) && cache->contains(97, 104));
+
+    std::cout << "✓ I/O priority test passed" << std::endl;
+}
+
+void test_epoch_reclamation()
+{
+    EpochDomain &domain = EpochDomain::global();
+    domain.synchronize();
+
+    static std::atomic<int> destroyed;
+    destroyed = 0;
+    auto deleter = [](void *)
+    { destroyed++; };
+
+    {
+        EpochDomain::Guard guard;
+        assert(guard);
+        domain.retire(nullptr, deleter);
+        for (size_t i = 0; i < 4 * EpochDomain::COLLECT_INTERVAL; ++i)
+        {
+            domain.retire(nullptr, [](void *) {});
+        }
+        // This thread could still be reading what it retired.
+        assert(destroyed == 0);
+    }
+
+    domain.synchronize();
+    assert(destroyed == 1);
+    assert(domain.pending() == 0);
+
+    // Another thread retiring without pause does not hold up a wait for
+    // what was retired before it.
+    domain.retire(nullptr, deleter);
+    std::atomic<bool> retiring(true);
+    std::thread retirer([&domain, &retiring]()
+                        {
+        while (retiring)
+        {
+            domain.retire(nullptr, [](void *) {});
+        } });
+    domain.synchronize();
+    assert(destroyed == 2);
+    retiring = false;
+    retirer.join();
+    domain.synchronize();
+
+    std::cout << "✓ Epoch reclamation test passed" << std::endl;
+}
+
+void test_lock_free_hits()
+{
+    PageCache cache(256, 4);
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> threads;
+
+    auto loader_for = [](uint64_t page_index)
+    {
+        return [page_index](uint8_t *data)
+        {
+            std::memcpy(data, &page_index, sizeof(page_index));
+            return true;
+        };
+    };
+
+    // Readers stay on a hot set while an evicter churns the rest of the
+    // cache, so hits race with evictions and index growth.
+    for (int t = 0; t < 3; ++t)
+    {
+        threads.emplace_back([&, t]()
+                             {
+            for (uint64_t i = 0; i < 20000; ++i)
+            {
+                uint64_t page_index = (i * 13 + t) % 64;
+                auto page = cache.get_or_load(11, page_index, loader_for(page_index));
+                uint64_t stored;
+                std::memcpy(&stored, page->data(), sizeof(stored));
+                assert(page->index() == page_index && stored == page_index);
+            } });
+    }
+    threads.emplace_back([&]()
+                         {
+        for (uint64_t i = 0; !stop.load(); ++i)
+        {
+            cache.get_or_load(12, i % 4096, loader_for(i % 4096));
+        } });
+
+    for (int t = 0; t < 3; ++t)
+    {
+        threads[t].join();
+    }
+    stop = true;
+    threads.back().join();
+
+    assert(cache.total_pages() <= 256);
+    std::cout << "✓ Lock-free hit test passed" << std::endl;
+}
+
+void test_latency_histogram()
+{
+    // Exact below 32, then 32 buckets per power of two.
+    assert(LatencyHistogram::bucket_of(31) == 31 && LatencyHistogram::bucket_of(32) == 32);
+    assert(LatencyHistogram::bucket_of(64) == LatencyHistogram::bucket_of(65));
+    assert(LatencyHistogram::bucket_of(LatencyHistogram::MAX_VALUE) == LatencyHistogram::BUCKETS - 1);
+    for (uint64_t value : {uint64_t(1), uint64_t(100), uint64_t(12345), uint64_t(987654321)})
+    {
+        [[maybe_unused]] uint64_t top = LatencyHistogram::bucket_top(LatencyHistogram::bucket_of(value));
+        assert(top >= value && top - value <= value / 32);
+        assert(LatencyHistogram::bucket_of(top + 1) == LatencyHistogram::bucket_of(value) + 1);
+    }
+
+    // 1..1000us from four threads at once.
+    LatencyHistogram histogram;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&histogram, t]()
+                             {
+            for (uint64_t us = 1 + t; us <= 1000; us += 4)
+            {
+                histogram.record(us * 1000);
+            } });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    LatencyHistogram::Snapshot first = histogram.snapshot();
+    assert(first.count() == 1000 && first.max() == 1000000);
+    assert(first.sum() == 500500 * 1000 && first.mean() == 500500.0);
+    [[maybe_unused]] auto near = [](uint64_t value, uint64_t expected)
+    { return value >= expected && value - expected <= expected / 32; };
+    assert(near(first.percentile(50), 500000));
+    assert(near(first.percentile(99), 990000));
+    assert(near(first.percentile(99.9), 999000));
+    assert(first.percentile(100) == 1000000);
+
+    // A burst of slow operations shows up in the interval's tail only.
+    for (int i = 0; i < 100; ++i)
+    {
+        histogram.record(50000000);
+    }
+    LatencyHistogram::Snapshot second = histogram.snapshot();
+    LatencyHistogram::Snapshot interval = second.since(first);
+    assert(interval.count() == 100 && near(interval.percentile(50), 50000000));
+    assert(interval.max() == 50000000 && second.percentile(99) == 50000000);
+
+    LatencyHistogram::Snapshot merged = first;
+    merged.merge(interval);
+    assert(merged.count() == second.count() && merged.percentile(99) == second.percentile(99));
+    histogram.reset();
+    assert(histogram.snapshot().count() == 0 && histogram.snapshot().percentile(99) == 0);
+
+    // The cache and the files and writeback using it record into its
+    // counters.
+    const char *path = "/tmp/pagecache_latency_test.dat";
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+    std::vector<uint8_t> data(8 * Page::PAGE_SIZE, 0x33);
+    [[maybe_unused]] ssize_t seeded = pwrite(fd, data.data(), data.size(), 0);
+    assert(seeded == (ssize_t)data.size());
+    auto inode = std::make_shared<Inode>(95, path);
+    inode->set_file_descriptor(fd);
+    inode->set_size(data.size());
+
+    auto cache = std::make_shared<PageCache>(64, 1);
+    auto counters = std::make_shared<Counters>();
+    cache->set_counters(counters);
+    auto writeback = std::make_shared<WritebackEngine>(cache, nullptr, 1);
+    writeback->register_inode(inode);
+    File file(inode, FileMode::ReadWrite, cache, nullptr, writeback);
+
+    Counters::Snapshot before = counters->snapshot();
+    std::vector<uint8_t> buffer(Page::PAGE_SIZE);
+    [[maybe_unused]] size_t missed = file.read(buffer.data(), buffer.size());
+    file.seek(0);
+    [[maybe_unused]] size_t hit = file.read(buffer.data(), buffer.size());
+    assert(missed == buffer.size() && hit == buffer.size());
+    file.seek(Page::PAGE_SIZE);
+    [[maybe_unused]] size_t written = file.write(data.data(), 2 * Page::PAGE_SIZE);
+    assert(written == 2 * Page::PAGE_SIZE);
+    file.sync();
+    for (uint64_t page = 100; page < 200; ++page)
+    {
+        cache->get_or_load(95, page, [](uint8_t *)
+                           { return true; });
+    }
+
+    Counters::Snapshot after = counters->snapshot().since(before);
+    assert(after.miss_latency.count() == 1 && after.read_hit_latency.count() == 1);
+    assert(after.writeback_latency.count() == 1 && after.fsync_latency.count() == 1);
+    assert(after.evictions > 0 && after.eviction_latency.count() == after.evictions);
+    assert(after.writebacks == 2);
+
+    close(fd);
+    unlink(path);
+    std::cout << "✓ Latency histogram test passed" << std::endl;
+}
+
 int main()
 {
     std::cout << "Running PageCache Tests\n"
@@ -173,6 +1899,35 @@ int main()
     test_cache_miss();
     test_eviction();
     test_dirty_tracking();
+    test_file_page_stats();
+    test_lru_order();
+    test_flat_page_map();
+    test_frame_pool();
+    test_sharded_capacity();
+    test_concurrent_get_or_load();
+    test_miss_deduplication();
+    test_pinned_page_refs();
+    test_range_load();
+    test_io_engine();
+    test_io_scheduler();
+    test_direct_io_file();
+    test_short_reads();
+    test_writeback();
+    test_append_during_sync();
+    test_sync_under_writers();
+    test_partial_page_writes();
+    test_file_sync();
+    test_sync_errors();
+    test_async_file();
+    test_dirty_throttle();
+    test_readahead();
+    test_access_patterns();
+    test_async_readahead();
+    test_io_thread_pool();
+    test_io_priorities();
+    test_epoch_reclamation();
+    test_lock_free_hits();
+    test_latency_histogram();
 
     std::cout << "\n✓ All tests passed!" << std::endl;
     return 0;